@@ -0,0 +1,781 @@
+/*
+ * diskindex.c - Build a directory index for a collection of disk images.
+ *
+ * Walks one or more directory trees looking for D64, D71 and D81 images
+ * and records the disk title, ID, free blocks and directory entries of
+ * each one in a compact binary index.  Only the BAM and the blocks of the
+ * directory chain are read from every image, so indexing a collection
+ * costs a handful of small reads per disk instead of loading the whole
+ * image the way di_load_image() does.  The images are read by a pool of
+ * worker threads.
+ *
+ * Re-running the indexer against an existing index only reads the images
+ * whose modification time or size changed since the last run.
+ *
+ * Usage:
+ *   diskindex [-j threads] [-H] [-v] index-file directory...
+ *   diskindex -l index-file
+ *
+ * Index file layout (all values little endian):
+ *
+ *   header   "C64IDX", u16 version, u8 flags, u32 record count
+ *   record   u16 path length, path, s64 mtime, s64 size, u64 hash,
+ *            u8 image type, u8 title[16], u8 id[5], u16 blocks free,
+ *            u16 entry count, entries
+ *   entry    u8 file type, u8 name[16], u8 track, u8 sector, u16 blocks
+ *
+ * Titles and file names are stored as raw PETSCII, padded with $a0.
+ * The hash is a 64 bit FNV-1a over the blocks read from the image, or
+ * over the whole file when -H is given (flag bit 0 in the header).
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "diskimage.h"
+
+
+#define INDEX_MAGIC         "C64IDX"
+#define INDEX_MAGIC_LEN     6
+#define INDEX_VERSION       1
+
+#define INDEX_FLAG_FULLHASH 0x01
+
+#define MAX_IMAGE_SIZE      819200
+#define MAX_THREADS         64
+
+#define FNV_OFFSET          0xcbf29ce484222325ULL
+#define FNV_PRIME           0x100000001b3ULL
+
+
+typedef struct indexentry {
+  unsigned char type;
+  unsigned char name[16];
+  TrackSector startts;
+  unsigned short blocks;
+} IndexEntry;
+
+typedef struct indexrecord {
+  char *path;
+  int64_t mtime;
+  int64_t size;
+  uint64_t hash;
+  unsigned char type;
+  unsigned char title[16];
+  unsigned char id[5];
+  unsigned short blocksfree;
+  unsigned short numentries;
+  IndexEntry *entries;
+  int valid;
+} IndexRecord;
+
+typedef struct recordlist {
+  IndexRecord *records;
+  int count;
+  int alloc;
+} RecordList;
+
+typedef struct indexjob {
+  RecordList *list;
+  RecordList *old;
+  int next;
+  int fullhash;
+  int reused;
+  int failed;
+  pthread_mutex_t lock;
+} IndexJob;
+
+
+static int verbose = 0;
+
+
+/* ------------------------------------------------------------------------- */
+/* helpers */
+
+static void *xmalloc(size_t size) {
+  void *p;
+
+  if ((p = malloc(size)) == NULL) {
+    fputs("diskindex: out of memory\n", stderr);
+    exit(1);
+  }
+  return(p);
+}
+
+
+static uint64_t fnv1a(uint64_t hash, const unsigned char *data, size_t len) {
+  size_t i;
+
+  for (i = 0; i < len; ++i) {
+    hash ^= data[i];
+    hash *= FNV_PRIME;
+  }
+  return(hash);
+}
+
+
+static IndexRecord *record_add(RecordList *list) {
+  IndexRecord *rec;
+
+  if (list->count == list->alloc) {
+    list->alloc = list->alloc ? list->alloc * 2 : 256;
+    list->records = realloc(list->records, list->alloc * sizeof(IndexRecord));
+    if (list->records == NULL) {
+      fputs("diskindex: out of memory\n", stderr);
+      exit(1);
+    }
+  }
+  rec = &list->records[list->count++];
+  memset(rec, 0, sizeof(*rec));
+  return(rec);
+}
+
+
+static void record_list_free(RecordList *list) {
+  int i;
+
+  for (i = 0; i < list->count; ++i) {
+    free(list->records[i].path);
+    free(list->records[i].entries);
+  }
+  free(list->records);
+  list->records = NULL;
+  list->count = list->alloc = 0;
+}
+
+
+static int record_cmp(const void *a, const void *b) {
+  return(strcmp(((const IndexRecord *)a)->path, ((const IndexRecord *)b)->path));
+}
+
+
+static IndexRecord *record_find(RecordList *list, const char *path) {
+  IndexRecord key;
+
+  if (list->count == 0) {
+    return(NULL);
+  }
+  key.path = (char *)path;
+  return(bsearch(&key, list->records, list->count, sizeof(IndexRecord), record_cmp));
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* reading images */
+
+/* Set up the geometry of an image the same way di_load_image() does, from
+   the file size alone.  Returns 0 for sizes that are not disk images. */
+static int image_geometry(DiskImage *di, int64_t size) {
+  switch (size) {
+  case 174848:
+  case 175531:
+    di->type = D64;
+    di->bam.track = 18;
+    di->bam.sector = 0;
+    di->dir = di->bam;
+    break;
+  case 349696:
+    di->type = D71;
+    di->bam.track = 18;
+    di->bam.sector = 0;
+    di->bam2.track = 53;
+    di->bam2.sector = 0;
+    di->dir = di->bam;
+    break;
+  case 819200:
+    di->type = D81;
+    di->bam.track = 40;
+    di->bam.sector = 1;
+    di->bam2.track = 40;
+    di->bam2.sector = 2;
+    di->dir.track = 40;
+    di->dir.sector = 0;
+    break;
+  default:
+    return(0);
+  }
+  di->size = (int)size;
+  return(1);
+}
+
+
+static int valid_ts(DiskImage *di, TrackSector ts) {
+  if (ts.track < 1 || ts.track > di_tracks(di->type)) {
+    return(0);
+  }
+  return(ts.sector < di_sectors_per_track(di->type, ts.track));
+}
+
+
+/* Read one block into its place in the image buffer, so that the
+   diskimage.c accessors see it where they expect it. */
+static unsigned char *read_block(DiskImage *di, int fd, TrackSector ts, uint64_t *hash) {
+  unsigned char *p;
+  off_t offset;
+
+  offset = (off_t)di_get_block_num(di->type, ts) * 256;
+  p = di->image + offset;
+  if (pread(fd, p, 256, offset) != 256) {
+    return(NULL);
+  }
+  if (hash) {
+    *hash = fnv1a(*hash, p, 256);
+  }
+  return(p);
+}
+
+
+static int hash_file(int fd, uint64_t *hash) {
+  unsigned char buffer[65536];
+  off_t offset = 0;
+  ssize_t l;
+
+  *hash = FNV_OFFSET;
+  while ((l = pread(fd, buffer, sizeof(buffer), offset)) > 0) {
+    *hash = fnv1a(*hash, buffer, l);
+    offset += l;
+  }
+  return(l == 0);
+}
+
+
+static int index_image(IndexRecord *rec, unsigned char *buffer, int fullhash) {
+  DiskImage di;
+  TrackSector ts;
+  unsigned char *p, *title;
+  unsigned char *visited;
+  uint64_t hash = FNV_OFFSET;
+  int fd, track, offset, blocks, maxblocks;
+  int ok = 0;
+
+  memset(&di, 0, sizeof(di));
+  if (!image_geometry(&di, rec->size)) {
+    return(0);
+  }
+  di.image = buffer;
+
+  if ((fd = open(rec->path, O_RDONLY)) < 0) {
+    return(0);
+  }
+
+  maxblocks = di.size / 256;
+  visited = calloc(maxblocks, 1);
+  if (visited == NULL) {
+    close(fd);
+    return(0);
+  }
+
+  /* header and BAM */
+  if (read_block(&di, fd, di.dir, &hash) == NULL) {
+    goto done;
+  }
+  if (di.type == D81) {
+    if (read_block(&di, fd, di.bam, &hash) == NULL ||
+        read_block(&di, fd, di.bam2, &hash) == NULL) {
+      goto done;
+    }
+  }
+
+  title = di_title(&di);
+  memcpy(rec->title, title, 16);
+  memcpy(rec->id, title + 18, 5);
+  rec->type = di.type;
+
+  blocks = 0;
+  for (track = 1; track <= di_tracks(di.type); ++track) {
+    if (track != di.dir.track) {
+      blocks += di_track_blocks_free(&di, track);
+    }
+  }
+  rec->blocksfree = blocks;
+
+  /* directory chain, stopping at bad links and loops */
+  p = di.image + di_get_block_num(di.type, di.dir) * 256;
+  ts.track = p[0];
+  ts.sector = p[1];
+  visited[di_get_block_num(di.type, di.dir)] = 1;
+  while (ts.track && valid_ts(&di, ts) && !visited[di_get_block_num(di.type, ts)]) {
+    visited[di_get_block_num(di.type, ts)] = 1;
+    if ((p = read_block(&di, fd, ts, &hash)) == NULL) {
+      break;
+    }
+    for (offset = 0; offset < 256; offset += 32) {
+      IndexEntry *e;
+
+      if (p[offset + 2] == 0) {
+        continue;
+      }
+      if ((rec->numentries & 63) == 0) {
+        rec->entries = realloc(rec->entries, (rec->numentries + 64) * sizeof(IndexEntry));
+        if (rec->entries == NULL) {
+          goto done;
+        }
+      }
+      e = &rec->entries[rec->numentries++];
+      e->type = p[offset + 2];
+      e->startts.track = p[offset + 3];
+      e->startts.sector = p[offset + 4];
+      memcpy(e->name, p + offset + 5, 16);
+      e->blocks = p[offset + 30] | p[offset + 31] << 8;
+    }
+    ts.track = p[0];
+    ts.sector = p[1];
+  }
+
+  if (fullhash) {
+    if (!hash_file(fd, &hash)) {
+      goto done;
+    }
+  }
+  rec->hash = hash;
+  ok = 1;
+
+done:
+  free(visited);
+  close(fd);
+  return(ok);
+}
+
+
+static void *index_worker(void *arg) {
+  IndexJob *job = arg;
+  IndexRecord *rec, *old;
+  unsigned char *buffer;
+  int i;
+
+  buffer = xmalloc(MAX_IMAGE_SIZE);
+  for (;;) {
+    pthread_mutex_lock(&job->lock);
+    i = job->next++;
+    pthread_mutex_unlock(&job->lock);
+    if (i >= job->list->count) {
+      break;
+    }
+    rec = &job->list->records[i];
+
+    old = job->old ? record_find(job->old, rec->path) : NULL;
+    if (old && old->mtime == rec->mtime && old->size == rec->size) {
+      /* unchanged since the last run, take over the old entries */
+      rec->hash = old->hash;
+      rec->type = old->type;
+      memcpy(rec->title, old->title, 16);
+      memcpy(rec->id, old->id, 5);
+      rec->blocksfree = old->blocksfree;
+      rec->numentries = old->numentries;
+      rec->entries = old->entries;
+      old->entries = NULL;
+      rec->valid = 1;
+      pthread_mutex_lock(&job->lock);
+      job->reused++;
+      pthread_mutex_unlock(&job->lock);
+      continue;
+    }
+
+    rec->valid = index_image(rec, buffer, job->fullhash);
+    if (!rec->valid) {
+      free(rec->entries);
+      rec->entries = NULL;
+      rec->numentries = 0;
+      pthread_mutex_lock(&job->lock);
+      job->failed++;
+      pthread_mutex_unlock(&job->lock);
+      fprintf(stderr, "diskindex: cannot read %s\n", rec->path);
+    } else if (verbose) {
+      fprintf(stderr, "%s\n", rec->path);
+    }
+  }
+  free(buffer);
+  return(NULL);
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* scanning */
+
+static int is_image_name(const char *name) {
+  const char *ext;
+
+  if ((ext = strrchr(name, '.')) == NULL) {
+    return(0);
+  }
+  return(strcasecmp(ext, ".d64") == 0 || strcasecmp(ext, ".d71") == 0 ||
+         strcasecmp(ext, ".d81") == 0);
+}
+
+
+static void scan_dir(RecordList *list, const char *path) {
+  DIR *dir;
+  struct dirent *de;
+  struct stat st;
+  char *name;
+  size_t len;
+
+  if ((dir = opendir(path)) == NULL) {
+    fprintf(stderr, "diskindex: cannot open %s: %s\n", path, strerror(errno));
+    return;
+  }
+  len = strlen(path);
+  while ((de = readdir(dir)) != NULL) {
+    if (de->d_name[0] == '.' &&
+        (de->d_name[1] == 0 || (de->d_name[1] == '.' && de->d_name[2] == 0))) {
+      continue;
+    }
+    name = xmalloc(len + strlen(de->d_name) + 2);
+    sprintf(name, "%s%s%s", path, (len && path[len - 1] == '/') ? "" : "/", de->d_name);
+    if (stat(name, &st) != 0) {
+      free(name);
+      continue;
+    }
+    if (S_ISDIR(st.st_mode)) {
+      scan_dir(list, name);
+      free(name);
+    } else if (S_ISREG(st.st_mode) && is_image_name(de->d_name)) {
+      IndexRecord *rec;
+      DiskImage di;
+
+      if (!image_geometry(&di, st.st_size)) {
+        if (verbose) {
+          fprintf(stderr, "diskindex: skipping %s (unknown size)\n", name);
+        }
+        free(name);
+        continue;
+      }
+      rec = record_add(list);
+      rec->path = name;
+      rec->mtime = st.st_mtime;
+      rec->size = st.st_size;
+    } else {
+      free(name);
+    }
+  }
+  closedir(dir);
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* index file */
+
+static void put_le(FILE *f, uint64_t value, int bytes) {
+  while (bytes--) {
+    fputc((int)(value & 0xff), f);
+    value >>= 8;
+  }
+}
+
+
+static int get_le(FILE *f, uint64_t *value, int bytes) {
+  int i, c;
+
+  *value = 0;
+  for (i = 0; i < bytes; ++i) {
+    if ((c = fgetc(f)) == EOF) {
+      return(0);
+    }
+    *value |= (uint64_t)c << (i * 8);
+  }
+  return(1);
+}
+
+
+static int write_index(const char *name, RecordList *list, int flags) {
+  FILE *f;
+  char *tmpname;
+  int i, j, count = 0;
+  int ok;
+
+  tmpname = xmalloc(strlen(name) + 5);
+  sprintf(tmpname, "%s.new", name);
+  if ((f = fopen(tmpname, "wb")) == NULL) {
+    fprintf(stderr, "diskindex: cannot create %s: %s\n", tmpname, strerror(errno));
+    free(tmpname);
+    return(0);
+  }
+
+  for (i = 0; i < list->count; ++i) {
+    count += list->records[i].valid;
+  }
+
+  fwrite(INDEX_MAGIC, 1, INDEX_MAGIC_LEN, f);
+  put_le(f, INDEX_VERSION, 2);
+  put_le(f, flags, 1);
+  put_le(f, count, 4);
+
+  for (i = 0; i < list->count; ++i) {
+    IndexRecord *rec = &list->records[i];
+    size_t len;
+
+    if (!rec->valid) {
+      continue;
+    }
+    len = strlen(rec->path);
+    put_le(f, len, 2);
+    fwrite(rec->path, 1, len, f);
+    put_le(f, rec->mtime, 8);
+    put_le(f, rec->size, 8);
+    put_le(f, rec->hash, 8);
+    put_le(f, rec->type, 1);
+    fwrite(rec->title, 1, 16, f);
+    fwrite(rec->id, 1, 5, f);
+    put_le(f, rec->blocksfree, 2);
+    put_le(f, rec->numentries, 2);
+    for (j = 0; j < rec->numentries; ++j) {
+      IndexEntry *e = &rec->entries[j];
+
+      put_le(f, e->type, 1);
+      fwrite(e->name, 1, 16, f);
+      put_le(f, e->startts.track, 1);
+      put_le(f, e->startts.sector, 1);
+      put_le(f, e->blocks, 2);
+    }
+  }
+
+  ok = !ferror(f);
+  if (fclose(f) != 0) {
+    ok = 0;
+  }
+  if (ok && rename(tmpname, name) != 0) {
+    ok = 0;
+  }
+  if (!ok) {
+    fprintf(stderr, "diskindex: cannot write %s: %s\n", name, strerror(errno));
+    unlink(tmpname);
+  }
+  free(tmpname);
+  return(ok);
+}
+
+
+/* Load an index written by write_index().  Returns -1 if the file is
+   missing or not an index, otherwise the header flags. */
+static int read_index(const char *name, RecordList *list) {
+  FILE *f;
+  char magic[INDEX_MAGIC_LEN];
+  uint64_t v, count, flags;
+  uint64_t i, j;
+
+  if ((f = fopen(name, "rb")) == NULL) {
+    return(-1);
+  }
+  if (fread(magic, 1, INDEX_MAGIC_LEN, f) != INDEX_MAGIC_LEN ||
+      memcmp(magic, INDEX_MAGIC, INDEX_MAGIC_LEN) != 0 ||
+      !get_le(f, &v, 2) || v != INDEX_VERSION ||
+      !get_le(f, &flags, 1) || !get_le(f, &count, 4)) {
+    fclose(f);
+    return(-1);
+  }
+
+  for (i = 0; i < count; ++i) {
+    IndexRecord *rec = record_add(list);
+
+    if (!get_le(f, &v, 2)) {
+      goto corrupt;
+    }
+    rec->path = xmalloc(v + 1);
+    if (fread(rec->path, 1, v, f) != v) {
+      goto corrupt;
+    }
+    rec->path[v] = 0;
+    if (!get_le(f, &v, 8)) goto corrupt;
+    rec->mtime = (int64_t)v;
+    if (!get_le(f, &v, 8)) goto corrupt;
+    rec->size = (int64_t)v;
+    if (!get_le(f, &rec->hash, 8)) goto corrupt;
+    if (!get_le(f, &v, 1)) goto corrupt;
+    rec->type = (unsigned char)v;
+    if (fread(rec->title, 1, 16, f) != 16 || fread(rec->id, 1, 5, f) != 5) {
+      goto corrupt;
+    }
+    if (!get_le(f, &v, 2)) goto corrupt;
+    rec->blocksfree = (unsigned short)v;
+    if (!get_le(f, &v, 2)) goto corrupt;
+    rec->numentries = (unsigned short)v;
+    rec->entries = xmalloc((rec->numentries + 1) * sizeof(IndexEntry));
+    for (j = 0; j < rec->numentries; ++j) {
+      IndexEntry *e = &rec->entries[j];
+
+      if (!get_le(f, &v, 1)) goto corrupt;
+      e->type = (unsigned char)v;
+      if (fread(e->name, 1, 16, f) != 16) goto corrupt;
+      if (!get_le(f, &v, 1)) goto corrupt;
+      e->startts.track = (unsigned char)v;
+      if (!get_le(f, &v, 1)) goto corrupt;
+      e->startts.sector = (unsigned char)v;
+      if (!get_le(f, &v, 2)) goto corrupt;
+      e->blocks = (unsigned short)v;
+    }
+    rec->valid = 1;
+  }
+  fclose(f);
+  qsort(list->records, list->count, sizeof(IndexRecord), record_cmp);
+  return((int)flags);
+
+corrupt:
+  fprintf(stderr, "diskindex: %s is truncated, rebuilding\n", name);
+  fclose(f);
+  record_list_free(list);
+  return(-1);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+static const char *ftype[] = {
+  "DEL", "SEQ", "PRG", "USR", "REL", "CBM", "DIR", "???"
+};
+
+
+static int list_index(const char *name) {
+  RecordList list = { NULL, 0, 0 };
+  char title[17], filename[17], quotename[19];
+  char id[6];
+  int i, j;
+
+  if (read_index(name, &list) < 0) {
+    fprintf(stderr, "diskindex: %s is not an index\n", name);
+    return(1);
+  }
+  for (i = 0; i < list.count; ++i) {
+    IndexRecord *rec = &list.records[i];
+
+    di_name_from_rawname(title, rec->title);
+    memcpy(id, rec->id, 5);
+    id[5] = 0;
+    printf("%s  %016llx\n", rec->path, (unsigned long long)rec->hash);
+    printf("0 \"%-16s\" %s\n", title, id);
+    for (j = 0; j < rec->numentries; ++j) {
+      IndexEntry *e = &rec->entries[j];
+
+      di_name_from_rawname(filename, e->name);
+      sprintf(quotename, "\"%s\"", filename);
+      printf("%-4d%-18s%c%s%c\n", e->blocks, quotename,
+             e->type & 0x80 ? ' ' : '*', ftype[e->type & 7],
+             e->type & 0x40 ? '<' : ' ');
+    }
+    printf("%d blocks free.\n\n", rec->blocksfree);
+  }
+  record_list_free(&list);
+  return(0);
+}
+
+
+static void usage(void) {
+  fputs("usage: diskindex [-j threads] [-H] [-v] index-file directory...\n"
+        "       diskindex -l index-file\n"
+        "\n"
+        "  -j n   number of worker threads (default: number of CPUs)\n"
+        "  -H     hash whole images instead of the directory blocks\n"
+        "  -v     print each image as it is read\n"
+        "  -l     list the contents of an index\n", stderr);
+  exit(1);
+}
+
+
+int main(int argc, char **argv) {
+  RecordList list = { NULL, 0, 0 };
+  RecordList old = { NULL, 0, 0 };
+  IndexJob job;
+  pthread_t threads[MAX_THREADS];
+  int nthreads = 0, fullhash = 0, listmode = 0;
+  int flags, oldflags;
+  int i, c;
+
+  while ((c = getopt(argc, argv, "j:Hvl")) != -1) {
+    switch (c) {
+    case 'j':
+      nthreads = atoi(optarg);
+      break;
+    case 'H':
+      fullhash = 1;
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    case 'l':
+      listmode = 1;
+      break;
+    default:
+      usage();
+    }
+  }
+  argc -= optind;
+  argv += optind;
+
+  if (listmode) {
+    if (argc != 1) {
+      usage();
+    }
+    return(list_index(argv[0]));
+  }
+  if (argc < 2) {
+    usage();
+  }
+
+  if (nthreads <= 0) {
+    nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if (nthreads < 1) {
+    nthreads = 1;
+  } else if (nthreads > MAX_THREADS) {
+    nthreads = MAX_THREADS;
+  }
+
+  for (i = 1; i < argc; ++i) {
+    scan_dir(&list, argv[i]);
+  }
+  qsort(list.records, list.count, sizeof(IndexRecord), record_cmp);
+
+  /* the same file can be reached through overlapping arguments */
+  for (i = 1; i < list.count; ++i) {
+    if (strcmp(list.records[i].path, list.records[i - 1].path) == 0) {
+      free(list.records[i].path);
+      memmove(&list.records[i], &list.records[i + 1], (list.count - i - 1) * sizeof(IndexRecord));
+      list.count--;
+      i--;
+    }
+  }
+
+  flags = fullhash ? INDEX_FLAG_FULLHASH : 0;
+  oldflags = read_index(argv[0], &old);
+
+  memset(&job, 0, sizeof(job));
+  job.list = &list;
+  job.old = (oldflags == flags) ? &old : NULL;
+  job.fullhash = fullhash;
+  pthread_mutex_init(&job.lock, NULL);
+
+  if (nthreads > list.count) {
+    nthreads = list.count ? list.count : 1;
+  }
+  for (i = 0; i < nthreads; ++i) {
+    if (pthread_create(&threads[i], NULL, index_worker, &job) != 0) {
+      break;
+    }
+  }
+  if (i == 0) {
+    index_worker(&job);
+  }
+  while (i--) {
+    pthread_join(threads[i], NULL);
+  }
+  pthread_mutex_destroy(&job.lock);
+
+  if (!write_index(argv[0], &list, flags)) {
+    return(1);
+  }
+  fprintf(stderr, "diskindex: %d images, %d unchanged, %d read, %d failed\n",
+          list.count, job.reused, list.count - job.reused - job.failed, job.failed);
+
+  record_list_free(&list);
+  record_list_free(&old);
+  return(job.failed ? 2 : 0);
+}
@@ -40,6 +40,16 @@
 
 #include "traps.h"
 
+/* Threaded opcode dispatch needs the GCC `labels as values' extension, and
+   is not used when anything else has to be done before each opcode (cycle
+   stretching, tracing, memmap).  The including CPU enables it by defining
+   CPU_LOOP_CONTINUE(), the condition of its emulation loop.  */
+#if defined USE_COMPUTED_GOTO && defined __GNUC__ && defined CPU_LOOP_CONTINUE \
+    && !defined CPU_DELAY_CLK && !defined CPU_REFRESH_CLK && !defined CPU_8502 \
+    && !defined C64DTV && !defined DEBUG && !defined FEATURE_CPUMEMHISTORY
+#define CPU_THREADED_DISPATCH
+#endif
+
 #ifndef C64DTV
 /* The C64DTV can use different shadow registers for accu read/write. */
 /* For standard 6510, this is not the case. */
@@ -117,6 +127,12 @@
 #define PROCESS_ALARMS
 #endif
 
+/* Hook called after a jump or a taken branch has set the PC, used by the
+   main CPU to fast-forward idle loops.  */
+#ifndef CPU_IDLE_LOOP
+#define CPU_IDLE_LOOP()
+#endif
+
 /* ------------------------------------------------------------------------- */
 
 #define LOCAL_SET_NZ(val)        (flag_z = flag_n = (val))
@@ -756,6 +772,7 @@ be found that works for both.
               OPCODE_DELAYS_INTERRUPT();                           \
           }                                                        \
           JUMP(dest_addr & 0xffff);                                \
+          CPU_IDLE_LOOP();                                         \
       }                                                            \
   } while (0)
 #endif
@@ -1932,6 +1949,51 @@ static const BYTE rewind_fetch_tab[] = {
 
 #endif /* !C64DTV */
 
+/* ------------------------------------------------------------------------ */
+/* Opcode dispatch.  */
+
+#ifndef CPU_OPCODE_DONE
+#define CPU_OPCODE_DONE()
+#endif
+
+#ifdef CPU_THREADED_DISPATCH
+
+/* Each opcode ends with its own copy of the opcode fetch and jumps directly
+   to the next one through `dispatch_tab', which is far easier on the host's
+   branch prediction than going back to the single `switch'.  This is only
+   done if the loop below would do nothing but fetch the next opcode: no
+   alarm is due and no interrupt (or trap, or monitor request) is pending.
+   Otherwise the opcode leaves the `switch' as usual.  */
+
+#ifndef CYCLE_EXACT_ALARM
+#define OPCODE_ALARM_PENDING() \
+    (CLK >= alarm_context_next_pending_clk(ALARM_CONTEXT))
+#else
+#define OPCODE_ALARM_PENDING() 0
+#endif
+
+#define OPCODE_CASE(op) case op: opcode_##op
+
+#define NEXT_OPCODE()                                          \
+    if (!OPCODE_ALARM_PENDING()                                \
+        && CPU_INT_STATUS->global_pending_int == IK_NONE       \
+        && CPU_LOOP_CONTINUE()) {                              \
+        CPU_OPCODE_DONE();                                     \
+        SET_LAST_ADDR(reg_pc);                                 \
+        FETCH_OPCODE(opcode);                                  \
+        SET_LAST_OPCODE(p0);                                   \
+        goto *dispatch_tab[p0];                                \
+    }                                                          \
+    break
+
+#else /* !CPU_THREADED_DISPATCH */
+
+#define OPCODE_CASE(op) case op
+
+#define NEXT_OPCODE() break
+
+#endif /* CPU_THREADED_DISPATCH */
+
 /* ------------------------------------------------------------------------ */
 
 /* Here, the CPU is emulated. */
@@ -1976,6 +2038,74 @@ static const BYTE rewind_fetch_tab[] = {
 
     {
         opcode_t opcode;
+#ifdef CPU_THREADED_DISPATCH
+        static const void *const dispatch_tab[256] = {
+            &&opcode_0x00, &&opcode_0x01, &&opcode_0x02, &&opcode_0x03,
+            &&opcode_0x04, &&opcode_0x05, &&opcode_0x06, &&opcode_0x07,
+            &&opcode_0x08, &&opcode_0x09, &&opcode_0x0a, &&opcode_0x0b,
+            &&opcode_0x0c, &&opcode_0x0d, &&opcode_0x0e, &&opcode_0x0f,
+            &&opcode_0x10, &&opcode_0x11, &&opcode_0x12, &&opcode_0x13,
+            &&opcode_0x14, &&opcode_0x15, &&opcode_0x16, &&opcode_0x17,
+            &&opcode_0x18, &&opcode_0x19, &&opcode_0x1a, &&opcode_0x1b,
+            &&opcode_0x1c, &&opcode_0x1d, &&opcode_0x1e, &&opcode_0x1f,
+            &&opcode_0x20, &&opcode_0x21, &&opcode_0x22, &&opcode_0x23,
+            &&opcode_0x24, &&opcode_0x25, &&opcode_0x26, &&opcode_0x27,
+            &&opcode_0x28, &&opcode_0x29, &&opcode_0x2a, &&opcode_0x2b,
+            &&opcode_0x2c, &&opcode_0x2d, &&opcode_0x2e, &&opcode_0x2f,
+            &&opcode_0x30, &&opcode_0x31, &&opcode_0x32, &&opcode_0x33,
+            &&opcode_0x34, &&opcode_0x35, &&opcode_0x36, &&opcode_0x37,
+            &&opcode_0x38, &&opcode_0x39, &&opcode_0x3a, &&opcode_0x3b,
+            &&opcode_0x3c, &&opcode_0x3d, &&opcode_0x3e, &&opcode_0x3f,
+            &&opcode_0x40, &&opcode_0x41, &&opcode_0x42, &&opcode_0x43,
+            &&opcode_0x44, &&opcode_0x45, &&opcode_0x46, &&opcode_0x47,
+            &&opcode_0x48, &&opcode_0x49, &&opcode_0x4a, &&opcode_0x4b,
+            &&opcode_0x4c, &&opcode_0x4d, &&opcode_0x4e, &&opcode_0x4f,
+            &&opcode_0x50, &&opcode_0x51, &&opcode_0x52, &&opcode_0x53,
+            &&opcode_0x54, &&opcode_0x55, &&opcode_0x56, &&opcode_0x57,
+            &&opcode_0x58, &&opcode_0x59, &&opcode_0x5a, &&opcode_0x5b,
+            &&opcode_0x5c, &&opcode_0x5d, &&opcode_0x5e, &&opcode_0x5f,
+            &&opcode_0x60, &&opcode_0x61, &&opcode_0x62, &&opcode_0x63,
+            &&opcode_0x64, &&opcode_0x65, &&opcode_0x66, &&opcode_0x67,
+            &&opcode_0x68, &&opcode_0x69, &&opcode_0x6a, &&opcode_0x6b,
+            &&opcode_0x6c, &&opcode_0x6d, &&opcode_0x6e, &&opcode_0x6f,
+            &&opcode_0x70, &&opcode_0x71, &&opcode_0x72, &&opcode_0x73,
+            &&opcode_0x74, &&opcode_0x75, &&opcode_0x76, &&opcode_0x77,
+            &&opcode_0x78, &&opcode_0x79, &&opcode_0x7a, &&opcode_0x7b,
+            &&opcode_0x7c, &&opcode_0x7d, &&opcode_0x7e, &&opcode_0x7f,
+            &&opcode_0x80, &&opcode_0x81, &&opcode_0x82, &&opcode_0x83,
+            &&opcode_0x84, &&opcode_0x85, &&opcode_0x86, &&opcode_0x87,
+            &&opcode_0x88, &&opcode_0x89, &&opcode_0x8a, &&opcode_0x8b,
+            &&opcode_0x8c, &&opcode_0x8d, &&opcode_0x8e, &&opcode_0x8f,
+            &&opcode_0x90, &&opcode_0x91, &&opcode_0x92, &&opcode_0x93,
+            &&opcode_0x94, &&opcode_0x95, &&opcode_0x96, &&opcode_0x97,
+            &&opcode_0x98, &&opcode_0x99, &&opcode_0x9a, &&opcode_0x9b,
+            &&opcode_0x9c, &&opcode_0x9d, &&opcode_0x9e, &&opcode_0x9f,
+            &&opcode_0xa0, &&opcode_0xa1, &&opcode_0xa2, &&opcode_0xa3,
+            &&opcode_0xa4, &&opcode_0xa5, &&opcode_0xa6, &&opcode_0xa7,
+            &&opcode_0xa8, &&opcode_0xa9, &&opcode_0xaa, &&opcode_0xab,
+            &&opcode_0xac, &&opcode_0xad, &&opcode_0xae, &&opcode_0xaf,
+            &&opcode_0xb0, &&opcode_0xb1, &&opcode_0xb2, &&opcode_0xb3,
+            &&opcode_0xb4, &&opcode_0xb5, &&opcode_0xb6, &&opcode_0xb7,
+            &&opcode_0xb8, &&opcode_0xb9, &&opcode_0xba, &&opcode_0xbb,
+            &&opcode_0xbc, &&opcode_0xbd, &&opcode_0xbe, &&opcode_0xbf,
+            &&opcode_0xc0, &&opcode_0xc1, &&opcode_0xc2, &&opcode_0xc3,
+            &&opcode_0xc4, &&opcode_0xc5, &&opcode_0xc6, &&opcode_0xc7,
+            &&opcode_0xc8, &&opcode_0xc9, &&opcode_0xca, &&opcode_0xcb,
+            &&opcode_0xcc, &&opcode_0xcd, &&opcode_0xce, &&opcode_0xcf,
+            &&opcode_0xd0, &&opcode_0xd1, &&opcode_0xd2, &&opcode_0xd3,
+            &&opcode_0xd4, &&opcode_0xd5, &&opcode_0xd6, &&opcode_0xd7,
+            &&opcode_0xd8, &&opcode_0xd9, &&opcode_0xda, &&opcode_0xdb,
+            &&opcode_0xdc, &&opcode_0xdd, &&opcode_0xde, &&opcode_0xdf,
+            &&opcode_0xe0, &&opcode_0xe1, &&opcode_0xe2, &&opcode_0xe3,
+            &&opcode_0xe4, &&opcode_0xe5, &&opcode_0xe6, &&opcode_0xe7,
+            &&opcode_0xe8, &&opcode_0xe9, &&opcode_0xea, &&opcode_0xeb,
+            &&opcode_0xec, &&opcode_0xed, &&opcode_0xee, &&opcode_0xef,
+            &&opcode_0xf0, &&opcode_0xf1, &&opcode_0xf2, &&opcode_0xf3,
+            &&opcode_0xf4, &&opcode_0xf5, &&opcode_0xf6, &&opcode_0xf7,
+            &&opcode_0xf8, &&opcode_0xf9, &&opcode_0xfa, &&opcode_0xfb,
+            &&opcode_0xfc, &&opcode_0xfd, &&opcode_0xfe, &&opcode_0xff
+        };
+#endif
 #ifdef DEBUG
         CLOCK debug_clk;
 #ifdef DRIVE_CPU
@@ -2052,349 +2182,350 @@ trap_skipped:
 
         switch (p0) {
 
-          case 0x00:            /* BRK */
+          OPCODE_CASE(0x00):            /* BRK */
             BRK();
-            break;
+            NEXT_OPCODE();
 
-          case 0x01:            /* ORA ($nn,X) */
+          OPCODE_CASE(0x01):            /* ORA ($nn,X) */
             ORA(LOAD_IND_X(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x02:            /* JAM - also used for traps */
+          OPCODE_CASE(0x02):            /* JAM - also used for traps */
             STATIC_ASSERT(TRAP_OPCODE == 0x02);
             JAM_02();
-            break;
-
-          case 0x22:            /* JAM */
-          case 0x52:            /* JAM */
-          case 0x62:            /* JAM */
-          case 0x72:            /* JAM */
-          case 0x92:            /* JAM */
-          case 0xb2:            /* JAM */
-          case 0xd2:            /* JAM */
-          case 0xf2:            /* JAM */
+            NEXT_OPCODE();
+
+          OPCODE_CASE(0x22):            /* JAM */
+          OPCODE_CASE(0x52):            /* JAM */
+          OPCODE_CASE(0x62):            /* JAM */
+          OPCODE_CASE(0x72):            /* JAM */
+          OPCODE_CASE(0x92):            /* JAM */
+          OPCODE_CASE(0xb2):            /* JAM */
+          OPCODE_CASE(0xd2):            /* JAM */
+          OPCODE_CASE(0xf2):            /* JAM */
 #ifndef C64DTV
-          case 0x12:            /* JAM */
-          case 0x32:            /* JAM */
-          case 0x42:            /* JAM */
+          OPCODE_CASE(0x12):            /* JAM */
+          OPCODE_CASE(0x32):            /* JAM */
+          OPCODE_CASE(0x42):            /* JAM */
 #endif
             REWIND_FETCH_OPCODE(CLK);
             JAM();
-            break;
+            NEXT_OPCODE();
 
 #ifdef C64DTV
           /* These opcodes are defined in c64/c64dtvcpu.c */
-          case 0x12:            /* BRA */
+          OPCODE_CASE(0x12):            /* BRA */
             BRANCH(1, p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0x32:            /* SAC */
+          OPCODE_CASE(0x32):            /* SAC */
             SAC(p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0x42:            /* SIR */
+          OPCODE_CASE(0x42):            /* SIR */
             SIR(p1);
-            break;
+            NEXT_OPCODE();
 #endif
 
-          case 0x03:            /* SLO ($nn,X) */
+          OPCODE_CASE(0x03):            /* SLO ($nn,X) */
             SLO(LOAD_ZERO_ADDR(p1 + reg_x), 3, CLK_IND_X_RMW, 2, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x04:            /* NOOP $nn */
-          case 0x44:            /* NOOP $nn */
-          case 0x64:            /* NOOP $nn */
+          OPCODE_CASE(0x04):            /* NOOP $nn */
+          OPCODE_CASE(0x44):            /* NOOP $nn */
+          OPCODE_CASE(0x64):            /* NOOP $nn */
             NOOP(1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x05:            /* ORA $nn */
+          OPCODE_CASE(0x05):            /* ORA $nn */
             ORA(LOAD_ZERO(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x06:            /* ASL $nn */
+          OPCODE_CASE(0x06):            /* ASL $nn */
             ASL(p1, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x07:            /* SLO $nn */
+          OPCODE_CASE(0x07):            /* SLO $nn */
             SLO(p1, 0, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x08:            /* PHP */
+          OPCODE_CASE(0x08):            /* PHP */
 #ifdef DRIVE_CPU
             if (drivecpu_byte_ready())
                 LOCAL_SET_OVERFLOW(1);
 #endif
             PHP();
-            break;
+            NEXT_OPCODE();
 
-          case 0x09:            /* ORA #$nn */
+          OPCODE_CASE(0x09):            /* ORA #$nn */
             ORA(p1, 0, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x0a:            /* ASL A */
+          OPCODE_CASE(0x0a):            /* ASL A */
             ASL_A();
-            break;
+            NEXT_OPCODE();
 
-          case 0x0b:            /* ANC #$nn */
+          OPCODE_CASE(0x0b):            /* ANC #$nn */
             ANC(p1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x0c:            /* NOOP $nnnn */
+          OPCODE_CASE(0x0c):            /* NOOP $nnnn */
             NOOP_ABS();
-            break;
+            NEXT_OPCODE();
 
-          case 0x0d:            /* ORA $nnnn */
+          OPCODE_CASE(0x0d):            /* ORA $nnnn */
             ORA(LOAD(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0x0e:            /* ASL $nnnn */
+          OPCODE_CASE(0x0e):            /* ASL $nnnn */
             ASL(p2, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x0f:            /* SLO $nnnn */
+          OPCODE_CASE(0x0f):            /* SLO $nnnn */
             SLO(p2, 0, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x10:            /* BPL $nnnn */
+          OPCODE_CASE(0x10):            /* BPL $nnnn */
             BRANCH(!LOCAL_SIGN(), p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0x11:            /* ORA ($nn),Y */
+          OPCODE_CASE(0x11):            /* ORA ($nn),Y */
             ORA(LOAD_IND_Y(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x13:            /* SLO ($nn),Y */
+          OPCODE_CASE(0x13):            /* SLO ($nn),Y */
             SLO_IND_Y(p1);
-            break;
-
-          case 0x14:            /* NOOP $nn,X */
-          case 0x34:            /* NOOP $nn,X */
-          case 0x54:            /* NOOP $nn,X */
-          case 0x74:            /* NOOP $nn,X */
-          case 0xd4:            /* NOOP $nn,X */
-          case 0xf4:            /* NOOP $nn,X */
+            NEXT_OPCODE();
+
+          OPCODE_CASE(0x14):            /* NOOP $nn,X */
+          OPCODE_CASE(0x34):            /* NOOP $nn,X */
+          OPCODE_CASE(0x54):            /* NOOP $nn,X */
+          OPCODE_CASE(0x74):            /* NOOP $nn,X */
+          OPCODE_CASE(0xd4):            /* NOOP $nn,X */
+          OPCODE_CASE(0xf4):            /* NOOP $nn,X */
             NOOP(CLK_NOOP_ZERO_X, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x15:            /* ORA $nn,X */
+          OPCODE_CASE(0x15):            /* ORA $nn,X */
             ORA(LOAD_ZERO_X(p1), CLK_ZERO_I2, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x16:            /* ASL $nn,X */
+          OPCODE_CASE(0x16):            /* ASL $nn,X */
             ASL((p1 + reg_x) & 0xff, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x17:            /* SLO $nn,X */
+          OPCODE_CASE(0x17):            /* SLO $nn,X */
             SLO((p1 + reg_x) & 0xff, 0, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x18:            /* CLC */
+          OPCODE_CASE(0x18):            /* CLC */
             CLC();
-            break;
+            NEXT_OPCODE();
 
-          case 0x19:            /* ORA $nnnn,Y */
+          OPCODE_CASE(0x19):            /* ORA $nnnn,Y */
             ORA(LOAD_ABS_Y(p2), 1, 3);
-            break;
-
-          case 0x1a:            /* NOOP */
-          case 0x3a:            /* NOOP */
-          case 0x5a:            /* NOOP */
-          case 0x7a:            /* NOOP */
-          case 0xda:            /* NOOP */
-          case 0xfa:            /* NOOP */
+            NEXT_OPCODE();
+
+          OPCODE_CASE(0x1a):            /* NOOP */
+          OPCODE_CASE(0x3a):            /* NOOP */
+          OPCODE_CASE(0x5a):            /* NOOP */
+          OPCODE_CASE(0x7a):            /* NOOP */
+          OPCODE_CASE(0xda):            /* NOOP */
+          OPCODE_CASE(0xfa):            /* NOOP */
             NOOP_IMM(1);
-            break;
+            NEXT_OPCODE();
 
-          case 0x1b:            /* SLO $nnnn,Y */
+          OPCODE_CASE(0x1b):            /* SLO $nnnn,Y */
             SLO(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_Y_RMW, STORE_ABS_Y_RMW);
-            break;
-
-          case 0x1c:            /* NOOP $nnnn,X */
-          case 0x3c:            /* NOOP $nnnn,X */
-          case 0x5c:            /* NOOP $nnnn,X */
-          case 0x7c:            /* NOOP $nnnn,X */
-          case 0xdc:            /* NOOP $nnnn,X */
-          case 0xfc:            /* NOOP $nnnn,X */
+            NEXT_OPCODE();
+
+          OPCODE_CASE(0x1c):            /* NOOP $nnnn,X */
+          OPCODE_CASE(0x3c):            /* NOOP $nnnn,X */
+          OPCODE_CASE(0x5c):            /* NOOP $nnnn,X */
+          OPCODE_CASE(0x7c):            /* NOOP $nnnn,X */
+          OPCODE_CASE(0xdc):            /* NOOP $nnnn,X */
+          OPCODE_CASE(0xfc):            /* NOOP $nnnn,X */
             NOOP_ABS_X();
-            break;
+            NEXT_OPCODE();
 
-          case 0x1d:            /* ORA $nnnn,X */
+          OPCODE_CASE(0x1d):            /* ORA $nnnn,X */
             ORA(LOAD_ABS_X(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0x1e:            /* ASL $nnnn,X */
+          OPCODE_CASE(0x1e):            /* ASL $nnnn,X */
             ASL(p2, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-            break;
+            NEXT_OPCODE();
 
-          case 0x1f:            /* SLO $nnnn,X */
+          OPCODE_CASE(0x1f):            /* SLO $nnnn,X */
             SLO(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-            break;
+            NEXT_OPCODE();
 
-          case 0x20:            /* JSR $nnnn */
+          OPCODE_CASE(0x20):            /* JSR $nnnn */
             JSR();
-            break;
+            NEXT_OPCODE();
 
-          case 0x21:            /* AND ($nn,X) */
+          OPCODE_CASE(0x21):            /* AND ($nn,X) */
             AND(LOAD_IND_X(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x23:            /* RLA ($nn,X) */
+          OPCODE_CASE(0x23):            /* RLA ($nn,X) */
             RLA(LOAD_ZERO_ADDR(p1 + reg_x), 3, CLK_IND_X_RMW, 2, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x24:            /* BIT $nn */
+          OPCODE_CASE(0x24):            /* BIT $nn */
             BIT(LOAD_ZERO(p1), 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x25:            /* AND $nn */
+          OPCODE_CASE(0x25):            /* AND $nn */
             AND(LOAD_ZERO(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x26:            /* ROL $nn */
+          OPCODE_CASE(0x26):            /* ROL $nn */
             ROL(p1, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x27:            /* RLA $nn */
+          OPCODE_CASE(0x27):            /* RLA $nn */
             RLA(p1, 0, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x28:            /* PLP */
+          OPCODE_CASE(0x28):            /* PLP */
             PLP();
-            break;
+            NEXT_OPCODE();
 
-          case 0x29:            /* AND #$nn */
+          OPCODE_CASE(0x29):            /* AND #$nn */
             AND(p1, 0, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x2a:            /* ROL A */
+          OPCODE_CASE(0x2a):            /* ROL A */
             ROL_A();
-            break;
+            NEXT_OPCODE();
 
-          case 0x2b:            /* ANC #$nn */
+          OPCODE_CASE(0x2b):            /* ANC #$nn */
             ANC(p1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x2c:            /* BIT $nnnn */
+          OPCODE_CASE(0x2c):            /* BIT $nnnn */
             BIT(LOAD(p2), 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0x2d:            /* AND $nnnn */
+          OPCODE_CASE(0x2d):            /* AND $nnnn */
             AND(LOAD(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0x2e:            /* ROL $nnnn */
+          OPCODE_CASE(0x2e):            /* ROL $nnnn */
             ROL(p2, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x2f:            /* RLA $nnnn */
+          OPCODE_CASE(0x2f):            /* RLA $nnnn */
             RLA(p2, 0, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x30:            /* BMI $nnnn */
+          OPCODE_CASE(0x30):            /* BMI $nnnn */
             BRANCH(LOCAL_SIGN(), p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0x31:            /* AND ($nn),Y */
+          OPCODE_CASE(0x31):            /* AND ($nn),Y */
             AND(LOAD_IND_Y(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x33:            /* RLA ($nn),Y */
+          OPCODE_CASE(0x33):            /* RLA ($nn),Y */
             RLA_IND_Y(p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0x35:            /* AND $nn,X */
+          OPCODE_CASE(0x35):            /* AND $nn,X */
             AND(LOAD_ZERO_X(p1), CLK_ZERO_I2, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x36:            /* ROL $nn,X */
+          OPCODE_CASE(0x36):            /* ROL $nn,X */
             ROL((p1 + reg_x) & 0xff, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x37:            /* RLA $nn,X */
+          OPCODE_CASE(0x37):            /* RLA $nn,X */
             RLA((p1 + reg_x) & 0xff, 0, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x38:            /* SEC */
+          OPCODE_CASE(0x38):            /* SEC */
             SEC();
-            break;
+            NEXT_OPCODE();
 
-          case 0x39:            /* AND $nnnn,Y */
+          OPCODE_CASE(0x39):            /* AND $nnnn,Y */
             AND(LOAD_ABS_Y(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0x3b:            /* RLA $nnnn,Y */
+          OPCODE_CASE(0x3b):            /* RLA $nnnn,Y */
             RLA(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_Y_RMW, STORE_ABS_Y_RMW);
-            break;
+            NEXT_OPCODE();
 
-          case 0x3d:            /* AND $nnnn,X */
+          OPCODE_CASE(0x3d):            /* AND $nnnn,X */
             AND(LOAD_ABS_X(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0x3e:            /* ROL $nnnn,X */
+          OPCODE_CASE(0x3e):            /* ROL $nnnn,X */
             ROL(p2, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-            break;
+            NEXT_OPCODE();
 
-          case 0x3f:            /* RLA $nnnn,X */
+          OPCODE_CASE(0x3f):            /* RLA $nnnn,X */
             RLA(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-            break;
+            NEXT_OPCODE();
 
-          case 0x40:            /* RTI */
+          OPCODE_CASE(0x40):            /* RTI */
             RTI();
-            break;
+            NEXT_OPCODE();
 
-          case 0x41:            /* EOR ($nn,X) */
+          OPCODE_CASE(0x41):            /* EOR ($nn,X) */
             EOR(LOAD_IND_X(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x43:            /* SRE ($nn,X) */
+          OPCODE_CASE(0x43):            /* SRE ($nn,X) */
             SRE(LOAD_ZERO_ADDR(p1 + reg_x), 3, CLK_IND_X_RMW, 2, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x45:            /* EOR $nn */
+          OPCODE_CASE(0x45):            /* EOR $nn */
             EOR(LOAD_ZERO(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x46:            /* LSR $nn */
+          OPCODE_CASE(0x46):            /* LSR $nn */
             LSR(p1, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x47:            /* SRE $nn */
+          OPCODE_CASE(0x47):            /* SRE $nn */
             SRE(p1, 0, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x48:            /* PHA */
+          OPCODE_CASE(0x48):            /* PHA */
             PHA();
-            break;
+            NEXT_OPCODE();
 
-          case 0x49:            /* EOR #$nn */
+          OPCODE_CASE(0x49):            /* EOR #$nn */
             EOR(p1, 0, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x4a:            /* LSR A */
+          OPCODE_CASE(0x4a):            /* LSR A */
             LSR_A();
-            break;
+            NEXT_OPCODE();
 
-          case 0x4b:            /* ASR #$nn */
+          OPCODE_CASE(0x4b):            /* ASR #$nn */
             ASR(p1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x4c:            /* JMP $nnnn */
+          OPCODE_CASE(0x4c):            /* JMP $nnnn */
             JMP(p2);
-            break;
+            CPU_IDLE_LOOP();
+            NEXT_OPCODE();
 
-          case 0x4d:            /* EOR $nnnn */
+          OPCODE_CASE(0x4d):            /* EOR $nnnn */
             EOR(LOAD(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0x4e:            /* LSR $nnnn */
+          OPCODE_CASE(0x4e):            /* LSR $nnnn */
             LSR(p2, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x4f:            /* SRE $nnnn */
+          OPCODE_CASE(0x4f):            /* SRE $nnnn */
             SRE(p2, 0, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x50:            /* BVC $nnnn */
+          OPCODE_CASE(0x50):            /* BVC $nnnn */
 #ifdef DRIVE_CPU
             CLK_ADD(CLK, -1);
             if (drivecpu_byte_ready())
@@ -2402,109 +2533,109 @@ trap_skipped:
             CLK_ADD(CLK, 1);
 #endif
             BRANCH(!LOCAL_OVERFLOW(), p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0x51:            /* EOR ($nn),Y */
+          OPCODE_CASE(0x51):            /* EOR ($nn),Y */
             EOR(LOAD_IND_Y(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x53:            /* SRE ($nn),Y */
+          OPCODE_CASE(0x53):            /* SRE ($nn),Y */
             SRE_IND_Y(p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0x55:            /* EOR $nn,X */
+          OPCODE_CASE(0x55):            /* EOR $nn,X */
             EOR(LOAD_ZERO_X(p1), CLK_ZERO_I2, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x56:            /* LSR $nn,X */
+          OPCODE_CASE(0x56):            /* LSR $nn,X */
             LSR((p1 + reg_x) & 0xff, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x57:            /* SRE $nn,X */
+          OPCODE_CASE(0x57):            /* SRE $nn,X */
             SRE((p1 + reg_x) & 0xff, 0, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x58:            /* CLI */
+          OPCODE_CASE(0x58):            /* CLI */
             CLI();
-            break;
+            NEXT_OPCODE();
 
-          case 0x59:            /* EOR $nnnn,Y */
+          OPCODE_CASE(0x59):            /* EOR $nnnn,Y */
             EOR(LOAD_ABS_Y(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0x5b:            /* SRE $nnnn,Y */
+          OPCODE_CASE(0x5b):            /* SRE $nnnn,Y */
             SRE(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_Y_RMW, STORE_ABS_Y_RMW);
-            break;
+            NEXT_OPCODE();
 
-          case 0x5d:            /* EOR $nnnn,X */
+          OPCODE_CASE(0x5d):            /* EOR $nnnn,X */
             EOR(LOAD_ABS_X(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0x5e:            /* LSR $nnnn,X */
+          OPCODE_CASE(0x5e):            /* LSR $nnnn,X */
             LSR(p2, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-            break;
+            NEXT_OPCODE();
 
-          case 0x5f:            /* SRE $nnnn,X */
+          OPCODE_CASE(0x5f):            /* SRE $nnnn,X */
             SRE(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-            break;
+            NEXT_OPCODE();
 
-          case 0x60:            /* RTS */
+          OPCODE_CASE(0x60):            /* RTS */
             RTS();
-            break;
+            NEXT_OPCODE();
 
-          case 0x61:            /* ADC ($nn,X) */
+          OPCODE_CASE(0x61):            /* ADC ($nn,X) */
             ADC(LOAD_IND_X(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x63:            /* RRA ($nn,X) */
+          OPCODE_CASE(0x63):            /* RRA ($nn,X) */
             RRA(LOAD_ZERO_ADDR(p1 + reg_x), 3, CLK_IND_X_RMW, 2, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x65:            /* ADC $nn */
+          OPCODE_CASE(0x65):            /* ADC $nn */
             ADC(LOAD_ZERO(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x66:            /* ROR $nn */
+          OPCODE_CASE(0x66):            /* ROR $nn */
             ROR(p1, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x67:            /* RRA $nn */
+          OPCODE_CASE(0x67):            /* RRA $nn */
             RRA(p1, 0, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x68:            /* PLA */
+          OPCODE_CASE(0x68):            /* PLA */
             PLA();
-            break;
+            NEXT_OPCODE();
 
-          case 0x69:            /* ADC #$nn */
+          OPCODE_CASE(0x69):            /* ADC #$nn */
             ADC(p1, 0, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x6a:            /* ROR A */
+          OPCODE_CASE(0x6a):            /* ROR A */
             ROR_A();
-            break;
+            NEXT_OPCODE();
 
-          case 0x6b:            /* ARR #$nn */
+          OPCODE_CASE(0x6b):            /* ARR #$nn */
             ARR(p1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x6c:            /* JMP ($nnnn) */
+          OPCODE_CASE(0x6c):            /* JMP ($nnnn) */
             JMP_IND();
-            break;
+            NEXT_OPCODE();
 
-          case 0x6d:            /* ADC $nnnn */
+          OPCODE_CASE(0x6d):            /* ADC $nnnn */
             ADC(LOAD(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0x6e:            /* ROR $nnnn */
+          OPCODE_CASE(0x6e):            /* ROR $nnnn */
             ROR(p2, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x6f:            /* RRA $nnnn */
+          OPCODE_CASE(0x6f):            /* RRA $nnnn */
             RRA(p2, 0, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x70:            /* BVS $nnnn */
+          OPCODE_CASE(0x70):            /* BVS $nnnn */
 #ifdef DRIVE_CPU
             CLK_ADD(CLK, -1);
             if (drivecpu_byte_ready())
@@ -2512,515 +2643,515 @@ trap_skipped:
             CLK_ADD(CLK, 1);
 #endif
             BRANCH(LOCAL_OVERFLOW(), p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0x71:            /* ADC ($nn),Y */
+          OPCODE_CASE(0x71):            /* ADC ($nn),Y */
             ADC(LOAD_IND_Y(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x73:            /* RRA ($nn),Y */
+          OPCODE_CASE(0x73):            /* RRA ($nn),Y */
             RRA_IND_Y(p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0x75:            /* ADC $nn,X */
+          OPCODE_CASE(0x75):            /* ADC $nn,X */
             ADC(LOAD_ZERO_X(p1), CLK_ZERO_I2, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x76:            /* ROR $nn,X */
+          OPCODE_CASE(0x76):            /* ROR $nn,X */
             ROR((p1 + reg_x) & 0xff, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x77:            /* RRA $nn,X */
+          OPCODE_CASE(0x77):            /* RRA $nn,X */
             RRA((p1 + reg_x) & 0xff, 0, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x78:            /* SEI */
+          OPCODE_CASE(0x78):            /* SEI */
             SEI();
-            break;
+            NEXT_OPCODE();
 
-          case 0x79:            /* ADC $nnnn,Y */
+          OPCODE_CASE(0x79):            /* ADC $nnnn,Y */
             ADC(LOAD_ABS_Y(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0x7b:            /* RRA $nnnn,Y */
+          OPCODE_CASE(0x7b):            /* RRA $nnnn,Y */
             RRA(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_Y_RMW, STORE_ABS_Y_RMW);
-            break;
+            NEXT_OPCODE();
 
-          case 0x7d:            /* ADC $nnnn,X */
+          OPCODE_CASE(0x7d):            /* ADC $nnnn,X */
             ADC(LOAD_ABS_X(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0x7e:            /* ROR $nnnn,X */
+          OPCODE_CASE(0x7e):            /* ROR $nnnn,X */
             ROR(p2, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-            break;
+            NEXT_OPCODE();
 
-          case 0x7f:            /* RRA $nnnn,X */
+          OPCODE_CASE(0x7f):            /* RRA $nnnn,X */
             RRA(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-            break;
+            NEXT_OPCODE();
 
-          case 0x80:            /* NOOP #$nn */
-          case 0x82:            /* NOOP #$nn */
-          case 0x89:            /* NOOP #$nn */
-          case 0xc2:            /* NOOP #$nn */
-          case 0xe2:            /* NOOP #$nn */
+          OPCODE_CASE(0x80):            /* NOOP #$nn */
+          OPCODE_CASE(0x82):            /* NOOP #$nn */
+          OPCODE_CASE(0x89):            /* NOOP #$nn */
+          OPCODE_CASE(0xc2):            /* NOOP #$nn */
+          OPCODE_CASE(0xe2):            /* NOOP #$nn */
             NOOP_IMM(2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x81:            /* STA ($nn,X) */
+          OPCODE_CASE(0x81):            /* STA ($nn,X) */
             STA(LOAD_ZERO_ADDR(p1 + reg_x), 3, 1, 2, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x83:            /* SAX ($nn,X) */
+          OPCODE_CASE(0x83):            /* SAX ($nn,X) */
             SAX(LOAD_ZERO_ADDR(p1 + reg_x), 3, 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x84:            /* STY $nn */
+          OPCODE_CASE(0x84):            /* STY $nn */
             STY_ZERO(p1, 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x85:            /* STA $nn */
+          OPCODE_CASE(0x85):            /* STA $nn */
             STA_ZERO(p1, 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x86:            /* STX $nn */
+          OPCODE_CASE(0x86):            /* STX $nn */
             STX_ZERO(p1, 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x87:            /* SAX $nn */
+          OPCODE_CASE(0x87):            /* SAX $nn */
             SAX_ZERO(p1, 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x88:            /* DEY */
+          OPCODE_CASE(0x88):            /* DEY */
             DEY();
-            break;
+            NEXT_OPCODE();
 
-          case 0x8a:            /* TXA */
+          OPCODE_CASE(0x8a):            /* TXA */
             TXA();
-            break;
+            NEXT_OPCODE();
 
-          case 0x8b:            /* ANE #$nn */
+          OPCODE_CASE(0x8b):            /* ANE #$nn */
             ANE(p1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x8c:            /* STY $nnnn */
+          OPCODE_CASE(0x8c):            /* STY $nnnn */
             STY(p2, 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0x8d:            /* STA $nnnn */
+          OPCODE_CASE(0x8d):            /* STA $nnnn */
             STA(p2, 0, 1, 3, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0x8e:            /* STX $nnnn */
+          OPCODE_CASE(0x8e):            /* STX $nnnn */
             STX(p2, 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0x8f:            /* SAX $nnnn */
+          OPCODE_CASE(0x8f):            /* SAX $nnnn */
             SAX(p2, 0, 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0x90:            /* BCC $nnnn */
+          OPCODE_CASE(0x90):            /* BCC $nnnn */
             BRANCH(!LOCAL_CARRY(), p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0x91:            /* STA ($nn),Y */
+          OPCODE_CASE(0x91):            /* STA ($nn),Y */
             STA_IND_Y(p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0x93:            /* SHA ($nn),Y */
+          OPCODE_CASE(0x93):            /* SHA ($nn),Y */
             SHA_IND_Y(p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0x94:            /* STY $nn,X */
+          OPCODE_CASE(0x94):            /* STY $nn,X */
             STY_ZERO(p1 + reg_x, CLK_ZERO_I_STORE, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x95:            /* STA $nn,X */
+          OPCODE_CASE(0x95):            /* STA $nn,X */
             STA_ZERO(p1 + reg_x, CLK_ZERO_I_STORE, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x96:            /* STX $nn,Y */
+          OPCODE_CASE(0x96):            /* STX $nn,Y */
             STX_ZERO(p1 + reg_y, CLK_ZERO_I_STORE, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x97:            /* SAX $nn,Y */
+          OPCODE_CASE(0x97):            /* SAX $nn,Y */
             SAX((p1 + reg_y) & 0xff, 0, CLK_ZERO_I_STORE, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x98:            /* TYA */
+          OPCODE_CASE(0x98):            /* TYA */
             TYA();
-            break;
+            NEXT_OPCODE();
 
-          case 0x99:            /* STA $nnnn,Y */
+          OPCODE_CASE(0x99):            /* STA $nnnn,Y */
             STA(p2, 0, CLK_ABS_I_STORE2, 3, STORE_ABS_Y);
-            break;
+            NEXT_OPCODE();
 
-          case 0x9a:            /* TXS */
+          OPCODE_CASE(0x9a):            /* TXS */
             TXS();
-            break;
+            NEXT_OPCODE();
 
-          case 0x9b:            /* SHS $nnnn,Y */
+          OPCODE_CASE(0x9b):            /* SHS $nnnn,Y */
 #ifdef C64DTV
             NOOP_ABS_Y();
 #else
             SHS_ABS_Y(p2);
 #endif
-            break;
+            NEXT_OPCODE();
 
-          case 0x9c:            /* SHY $nnnn,X */
+          OPCODE_CASE(0x9c):            /* SHY $nnnn,X */
             SHY_ABS_X(p2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x9d:            /* STA $nnnn,X */
+          OPCODE_CASE(0x9d):            /* STA $nnnn,X */
             STA(p2, 0, CLK_ABS_I_STORE2, 3, STORE_ABS_X);
-            break;
+            NEXT_OPCODE();
 
-          case 0x9e:            /* SHX $nnnn,Y */
+          OPCODE_CASE(0x9e):            /* SHX $nnnn,Y */
             SHX_ABS_Y(p2);
-            break;
+            NEXT_OPCODE();
 
-          case 0x9f:            /* SHA $nnnn,Y */
+          OPCODE_CASE(0x9f):            /* SHA $nnnn,Y */
             SHA_ABS_Y(p2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xa0:            /* LDY #$nn */
+          OPCODE_CASE(0xa0):            /* LDY #$nn */
             LDY(p1, 0, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xa1:            /* LDA ($nn,X) */
+          OPCODE_CASE(0xa1):            /* LDA ($nn,X) */
             LDA(LOAD_IND_X(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xa2:            /* LDX #$nn */
+          OPCODE_CASE(0xa2):            /* LDX #$nn */
             LDX(p1, 0, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xa3:            /* LAX ($nn,X) */
+          OPCODE_CASE(0xa3):            /* LAX ($nn,X) */
             LAX(LOAD_IND_X(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xa4:            /* LDY $nn */
+          OPCODE_CASE(0xa4):            /* LDY $nn */
             LDY(LOAD_ZERO(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xa5:            /* LDA $nn */
+          OPCODE_CASE(0xa5):            /* LDA $nn */
             LDA(LOAD_ZERO(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xa6:            /* LDX $nn */
+          OPCODE_CASE(0xa6):            /* LDX $nn */
             LDX(LOAD_ZERO(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xa7:            /* LAX $nn */
+          OPCODE_CASE(0xa7):            /* LAX $nn */
             LAX(LOAD_ZERO(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xa8:            /* TAY */
+          OPCODE_CASE(0xa8):            /* TAY */
             TAY();
-            break;
+            NEXT_OPCODE();
 
-          case 0xa9:            /* LDA #$nn */
+          OPCODE_CASE(0xa9):            /* LDA #$nn */
             LDA(p1, 0, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xaa:            /* TAX */
+          OPCODE_CASE(0xaa):            /* TAX */
             TAX();
-            break;
+            NEXT_OPCODE();
 
-          case 0xab:            /* LXA #$nn */
+          OPCODE_CASE(0xab):            /* LXA #$nn */
             LXA(p1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xac:            /* LDY $nnnn */
+          OPCODE_CASE(0xac):            /* LDY $nnnn */
             LDY(LOAD(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xad:            /* LDA $nnnn */
+          OPCODE_CASE(0xad):            /* LDA $nnnn */
             LDA(LOAD(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xae:            /* LDX $nnnn */
+          OPCODE_CASE(0xae):            /* LDX $nnnn */
             LDX(LOAD(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xaf:            /* LAX $nnnn */
+          OPCODE_CASE(0xaf):            /* LAX $nnnn */
             LAX(LOAD(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xb0:            /* BCS $nnnn */
+          OPCODE_CASE(0xb0):            /* BCS $nnnn */
             BRANCH(LOCAL_CARRY(), p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0xb1:            /* LDA ($nn),Y */
+          OPCODE_CASE(0xb1):            /* LDA ($nn),Y */
             LDA(LOAD_IND_Y_BANK(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xb3:            /* LAX ($nn),Y */
+          OPCODE_CASE(0xb3):            /* LAX ($nn),Y */
             LAX(LOAD_IND_Y(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xb4:            /* LDY $nn,X */
+          OPCODE_CASE(0xb4):            /* LDY $nn,X */
             LDY(LOAD_ZERO_X(p1), CLK_ZERO_I2, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xb5:            /* LDA $nn,X */
+          OPCODE_CASE(0xb5):            /* LDA $nn,X */
             LDA(LOAD_ZERO_X(p1), CLK_ZERO_I2, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xb6:            /* LDX $nn,Y */
+          OPCODE_CASE(0xb6):            /* LDX $nn,Y */
             LDX(LOAD_ZERO_Y(p1), CLK_ZERO_I2, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xb7:            /* LAX $nn,Y */
+          OPCODE_CASE(0xb7):            /* LAX $nn,Y */
             LAX(LOAD_ZERO_Y(p1), CLK_ZERO_I2, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xb8:            /* CLV */
+          OPCODE_CASE(0xb8):            /* CLV */
             CLV();
-            break;
+            NEXT_OPCODE();
 
-          case 0xb9:            /* LDA $nnnn,Y */
+          OPCODE_CASE(0xb9):            /* LDA $nnnn,Y */
             LDA(LOAD_ABS_Y(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xba:            /* TSX */
+          OPCODE_CASE(0xba):            /* TSX */
             TSX();
-            break;
+            NEXT_OPCODE();
 
-          case 0xbb:            /* LAS $nnnn,Y */
+          OPCODE_CASE(0xbb):            /* LAS $nnnn,Y */
             LAS(LOAD_ABS_Y(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xbc:            /* LDY $nnnn,X */
+          OPCODE_CASE(0xbc):            /* LDY $nnnn,X */
             LDY(LOAD_ABS_X(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xbd:            /* LDA $nnnn,X */
+          OPCODE_CASE(0xbd):            /* LDA $nnnn,X */
             LDA(LOAD_ABS_X(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xbe:            /* LDX $nnnn,Y */
+          OPCODE_CASE(0xbe):            /* LDX $nnnn,Y */
             LDX(LOAD_ABS_Y(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xbf:            /* LAX $nnnn,Y */
+          OPCODE_CASE(0xbf):            /* LAX $nnnn,Y */
             LAX(LOAD_ABS_Y(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xc0:            /* CPY #$nn */
+          OPCODE_CASE(0xc0):            /* CPY #$nn */
             CPY(p1, 0, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xc1:            /* CMP ($nn,X) */
+          OPCODE_CASE(0xc1):            /* CMP ($nn,X) */
             CMP(LOAD_IND_X(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xc3:            /* DCP ($nn,X) */
+          OPCODE_CASE(0xc3):            /* DCP ($nn,X) */
             DCP(LOAD_ZERO_ADDR(p1 + reg_x), 3, CLK_IND_X_RMW, 2, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0xc4:            /* CPY $nn */
+          OPCODE_CASE(0xc4):            /* CPY $nn */
             CPY(LOAD_ZERO(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xc5:            /* CMP $nn */
+          OPCODE_CASE(0xc5):            /* CMP $nn */
             CMP(LOAD_ZERO(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xc6:            /* DEC $nn */
+          OPCODE_CASE(0xc6):            /* DEC $nn */
             DEC(p1, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0xc7:            /* DCP $nn */
+          OPCODE_CASE(0xc7):            /* DCP $nn */
             DCP(p1, 0, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0xc8:            /* INY */
+          OPCODE_CASE(0xc8):            /* INY */
             INY();
-            break;
+            NEXT_OPCODE();
 
-          case 0xc9:            /* CMP #$nn */
+          OPCODE_CASE(0xc9):            /* CMP #$nn */
             CMP(p1, 0, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xca:            /* DEX */
+          OPCODE_CASE(0xca):            /* DEX */
             DEX();
-            break;
+            NEXT_OPCODE();
 
-          case 0xcb:            /* SBX #$nn */
+          OPCODE_CASE(0xcb):            /* SBX #$nn */
             SBX(p1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xcc:            /* CPY $nnnn */
+          OPCODE_CASE(0xcc):            /* CPY $nnnn */
             CPY(LOAD(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xcd:            /* CMP $nnnn */
+          OPCODE_CASE(0xcd):            /* CMP $nnnn */
             CMP(LOAD(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xce:            /* DEC $nnnn */
+          OPCODE_CASE(0xce):            /* DEC $nnnn */
             DEC(p2, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0xcf:            /* DCP $nnnn */
+          OPCODE_CASE(0xcf):            /* DCP $nnnn */
             DCP(p2, 0, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0xd0:            /* BNE $nnnn */
+          OPCODE_CASE(0xd0):            /* BNE $nnnn */
             BRANCH(!LOCAL_ZERO(), p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0xd1:            /* CMP ($nn),Y */
+          OPCODE_CASE(0xd1):            /* CMP ($nn),Y */
             CMP(LOAD_IND_Y(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xd3:            /* DCP ($nn),Y */
+          OPCODE_CASE(0xd3):            /* DCP ($nn),Y */
             DCP_IND_Y(p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0xd5:            /* CMP $nn,X */
+          OPCODE_CASE(0xd5):            /* CMP $nn,X */
             CMP(LOAD_ZERO_X(p1), CLK_ZERO_I2, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xd6:            /* DEC $nn,X */
+          OPCODE_CASE(0xd6):            /* DEC $nn,X */
             DEC((p1 + reg_x) & 0xff, CLK_ZERO_I_RMW, 2, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0xd7:            /* DCP $nn,X */
+          OPCODE_CASE(0xd7):            /* DCP $nn,X */
             DCP((p1 + reg_x) & 0xff, 0, CLK_ZERO_I_RMW, 2, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0xd8:            /* CLD */
+          OPCODE_CASE(0xd8):            /* CLD */
             CLD();
-            break;
+            NEXT_OPCODE();
 
-          case 0xd9:            /* CMP $nnnn,Y */
+          OPCODE_CASE(0xd9):            /* CMP $nnnn,Y */
             CMP(LOAD_ABS_Y(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xdb:            /* DCP $nnnn,Y */
+          OPCODE_CASE(0xdb):            /* DCP $nnnn,Y */
             DCP(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_Y_RMW, STORE_ABS_Y_RMW);
-            break;
+            NEXT_OPCODE();
 
-          case 0xdd:            /* CMP $nnnn,X */
+          OPCODE_CASE(0xdd):            /* CMP $nnnn,X */
             CMP(LOAD_ABS_X(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xde:            /* DEC $nnnn,X */
+          OPCODE_CASE(0xde):            /* DEC $nnnn,X */
             DEC(p2, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-            break;
+            NEXT_OPCODE();
 
-          case 0xdf:            /* DCP $nnnn,X */
+          OPCODE_CASE(0xdf):            /* DCP $nnnn,X */
             DCP(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-            break;
+            NEXT_OPCODE();
 
-          case 0xe0:            /* CPX #$nn */
+          OPCODE_CASE(0xe0):            /* CPX #$nn */
             CPX(p1, 0, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xe1:            /* SBC ($nn,X) */
+          OPCODE_CASE(0xe1):            /* SBC ($nn,X) */
             SBC(LOAD_IND_X(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xe3:            /* ISB ($nn,X) */
+          OPCODE_CASE(0xe3):            /* ISB ($nn,X) */
             ISB(LOAD_ZERO_ADDR(p1 + reg_x), 3, CLK_IND_X_RMW, 2, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0xe4:            /* CPX $nn */
+          OPCODE_CASE(0xe4):            /* CPX $nn */
             CPX(LOAD_ZERO(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xe5:            /* SBC $nn */
+          OPCODE_CASE(0xe5):            /* SBC $nn */
             SBC(LOAD_ZERO(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xe6:            /* INC $nn */
+          OPCODE_CASE(0xe6):            /* INC $nn */
             INC(p1, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0xe7:            /* ISB $nn */
+          OPCODE_CASE(0xe7):            /* ISB $nn */
             ISB(p1, 0, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0xe8:            /* INX */
+          OPCODE_CASE(0xe8):            /* INX */
             INX();
-            break;
+            NEXT_OPCODE();
 
-          case 0xe9:            /* SBC #$nn */
+          OPCODE_CASE(0xe9):            /* SBC #$nn */
             SBC(p1, 0, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xea:            /* NOP */
+          OPCODE_CASE(0xea):            /* NOP */
             NOP();
-            break;
+            NEXT_OPCODE();
 
-          case 0xeb:            /* USBC #$nn (same as SBC) */
+          OPCODE_CASE(0xeb):            /* USBC #$nn (same as SBC) */
             SBC(p1, 0, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xec:            /* CPX $nnnn */
+          OPCODE_CASE(0xec):            /* CPX $nnnn */
             CPX(LOAD(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xed:            /* SBC $nnnn */
+          OPCODE_CASE(0xed):            /* SBC $nnnn */
             SBC(LOAD(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xee:            /* INC $nnnn */
+          OPCODE_CASE(0xee):            /* INC $nnnn */
             INC(p2, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0xef:            /* ISB $nnnn */
+          OPCODE_CASE(0xef):            /* ISB $nnnn */
             ISB(p2, 0, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0xf0:            /* BEQ $nnnn */
+          OPCODE_CASE(0xf0):            /* BEQ $nnnn */
             BRANCH(LOCAL_ZERO(), p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0xf1:            /* SBC ($nn),Y */
+          OPCODE_CASE(0xf1):            /* SBC ($nn),Y */
             SBC(LOAD_IND_Y(p1), 1, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xf3:            /* ISB ($nn),Y */
+          OPCODE_CASE(0xf3):            /* ISB ($nn),Y */
             ISB_IND_Y(p1);
-            break;
+            NEXT_OPCODE();
 
-          case 0xf5:            /* SBC $nn,X */
+          OPCODE_CASE(0xf5):            /* SBC $nn,X */
             SBC(LOAD_ZERO_X(p1), CLK_ZERO_I2, 2);
-            break;
+            NEXT_OPCODE();
 
-          case 0xf6:            /* INC $nn,X */
+          OPCODE_CASE(0xf6):            /* INC $nn,X */
             INC((p1 + reg_x) & 0xff, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0xf7:            /* ISB $nn,X */
+          OPCODE_CASE(0xf7):            /* ISB $nn,X */
             ISB((p1 + reg_x) & 0xff, 0, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-            break;
+            NEXT_OPCODE();
 
-          case 0xf8:            /* SED */
+          OPCODE_CASE(0xf8):            /* SED */
             SED();
-            break;
+            NEXT_OPCODE();
 
-          case 0xf9:            /* SBC $nnnn,Y */
+          OPCODE_CASE(0xf9):            /* SBC $nnnn,Y */
             SBC(LOAD_ABS_Y(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xfb:            /* ISB $nnnn,Y */
+          OPCODE_CASE(0xfb):            /* ISB $nnnn,Y */
             ISB(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_Y_RMW, STORE_ABS_Y_RMW);
-            break;
+            NEXT_OPCODE();
 
-          case 0xfd:            /* SBC $nnnn,X */
+          OPCODE_CASE(0xfd):            /* SBC $nnnn,X */
             SBC(LOAD_ABS_X(p2), 1, 3);
-            break;
+            NEXT_OPCODE();
 
-          case 0xfe:            /* INC $nnnn,X */
+          OPCODE_CASE(0xfe):            /* INC $nnnn,X */
             INC(p2, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-            break;
+            NEXT_OPCODE();
 
-          case 0xff:            /* ISB $nnnn,X */
+          OPCODE_CASE(0xff):            /* ISB $nnnn,X */
             ISB(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-            break;
+            NEXT_OPCODE();
         }
     }
 }
@@ -36,6 +36,10 @@
 #include "types.h"
 
 
+/* File the operations of the traced alarm context go to.  Only one
+   context is traced at a time.  */
+static FILE *alarm_trace_file = NULL;
+
 alarm_context_t *alarm_context_new(const char *name)
 {
     alarm_context_t *new_alarm_context;
@@ -54,10 +58,16 @@ void alarm_context_init(alarm_context_t *context, const char *name)
 
     context->num_pending_alarms = 0;
     context->next_pending_alarm_clk = (CLOCK)~0L;
+    context->next_pending_alarm_idx = -1;
+
+    context->num_alarms = 0;
+    context->trace = 0;
 }
 
 void alarm_context_destroy(alarm_context_t *context)
 {
+    alarm_context_trace_stop(context);
+
     lib_free(context->name);
 
     /* Destroy all the alarms.  */
@@ -84,6 +94,11 @@ void alarm_context_time_warp(alarm_context_t *context, CLOCK warp_amount,
     if (warp_direction == 0)
         return;
 
+    if (context->trace)
+        fprintf(alarm_trace_file, "W %u %d\n", warp_amount, warp_direction);
+
+    /* All the pending alarms are moved by the same amount, so the heap
+       order is preserved.  */
     for (i = 0; i < context->num_pending_alarms; i++) {
         if (warp_direction > 0)
             context->pending_alarms[i].clk += warp_amount;
@@ -91,10 +106,7 @@ void alarm_context_time_warp(alarm_context_t *context, CLOCK warp_amount,
             context->pending_alarms[i].clk -= warp_amount;
     }
 
-    if (warp_direction > 0)
-        context->next_pending_alarm_clk += warp_amount;
-    else
-        context->next_pending_alarm_clk -= warp_amount;
+    alarm_context_update_next_pending(context);
 }
 
 /* ------------------------------------------------------------------------ */
@@ -109,6 +121,8 @@ static void alarm_init(alarm_t *alarm, alarm_context_t *context,
 
     alarm->pending_idx = -1;      /* Not pending.  */
 
+    alarm->id = context->num_alarms++;
+
     /* Add to the head of the alarm list of the alarm context.  */
     if (context->alarms == NULL) {
         context->alarms = alarm;
@@ -160,6 +174,7 @@ void alarm_destroy(alarm_t *alarm)
 void alarm_unset(alarm_t *alarm)
 {
     alarm_context_t *context;
+    unsigned int last;
     int idx;
 
     idx = alarm->pending_idx;
@@ -169,32 +184,34 @@ void alarm_unset(alarm_t *alarm)
 
     context = alarm->context;
 
-    if (context->num_pending_alarms > 1) {
-        int last;
+    if (context->trace)
+        fprintf(alarm_trace_file, "U %u\n", alarm->id);
 
-        last = --context->num_pending_alarms;
+    last = --context->num_pending_alarms;
 
-        if (last != idx) {
-            /* Let's copy the struct by hand to make sure stupid compilers
-               don't do stupid things.  */
-            context->pending_alarms[idx].alarm
-                = context->pending_alarms[last].alarm;
-            context->pending_alarms[idx].clk
-                = context->pending_alarms[last].clk;
+    if (last != (unsigned int)idx) {
+        CLOCK clk;
 
-            context->pending_alarms[idx].alarm->pending_idx = idx;
-        }
+        /* Fill the hole with the last heap entry and restore the heap
+           property around it.  Let's copy the struct by hand to make sure
+           stupid compilers don't do stupid things.  */
+        clk = context->pending_alarms[idx].clk;
 
-        if (context->next_pending_alarm_idx == idx)
-            alarm_context_update_next_pending(context);
-        else if (context->next_pending_alarm_idx == last)
-            context->next_pending_alarm_idx = idx;
-    } else {
-        context->num_pending_alarms = 0;
-        context->next_pending_alarm_clk = (CLOCK) ~0L;
-        context->next_pending_alarm_idx = -1;
+        context->pending_alarms[idx].alarm
+            = context->pending_alarms[last].alarm;
+        context->pending_alarms[idx].clk
+            = context->pending_alarms[last].clk;
+
+        context->pending_alarms[idx].alarm->pending_idx = idx;
+
+        if (context->pending_alarms[idx].clk < clk)
+            alarm_context_sift_up(context, (unsigned int)idx);
+        else
+            alarm_context_sift_down(context, (unsigned int)idx);
     }
 
+    alarm_context_update_next_pending(context);
+
     alarm->pending_idx = -1;
 }
 
@@ -203,3 +220,61 @@ void alarm_log_too_many_alarms(void)
     log_error(LOG_DEFAULT, "alarm_set(): Too many alarms set!");
 }
 
+/* ------------------------------------------------------------------------ */
+
+/* Traces are workloads of alarmbench (see there for the format): every
+   set, unset, dispatch and time warp of the context.  They start with
+   the alarms that are pending already.  */
+
+int alarm_context_trace_start(alarm_context_t *context, const char *filename)
+{
+    alarm_t *alarm;
+    unsigned int i;
+
+    if (alarm_trace_file != NULL) {
+        log_error(LOG_DEFAULT, "Alarms are already being traced.");
+        return -1;
+    }
+
+    alarm_trace_file = fopen(filename, "w");
+    if (alarm_trace_file == NULL) {
+        log_error(LOG_DEFAULT, "Cannot create alarm trace `%s'.", filename);
+        return -1;
+    }
+
+    fprintf(alarm_trace_file, "# alarm trace of %s\n", context->name);
+    for (alarm = context->alarms; alarm != NULL; alarm = alarm->next)
+        fprintf(alarm_trace_file, "# %u %s\n", alarm->id, alarm->name);
+
+    for (i = 0; i < context->num_pending_alarms; i++)
+        fprintf(alarm_trace_file, "S %u %u\n",
+                context->pending_alarms[i].alarm->id,
+                context->pending_alarms[i].clk);
+
+    context->trace = 1;
+
+    return 0;
+}
+
+void alarm_context_trace_stop(alarm_context_t *context)
+{
+    if (!context->trace)
+        return;
+
+    fclose(alarm_trace_file);
+    alarm_trace_file = NULL;
+
+    context->trace = 0;
+}
+
+void alarm_trace_set(alarm_t *alarm, CLOCK cpu_clk)
+{
+    fprintf(alarm_trace_file, "S %u %u\n", alarm->id, cpu_clk);
+}
+
+void alarm_trace_dispatch(alarm_context_t *context, CLOCK cpu_clk)
+{
+    fprintf(alarm_trace_file, "D %u %u\n", cpu_clk,
+            context->next_pending_alarm_clk);
+}
+
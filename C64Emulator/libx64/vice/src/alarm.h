@@ -45,13 +45,16 @@ struct alarm_s {
     /* Callback to be called when the alarm is dispatched.  */
     alarm_callback_t callback;
 
-    /* Index into the pending alarm list.  If < 0, the alarm is not
+    /* Position in the pending alarm heap.  If < 0, the alarm is not
        pending.  */
     int pending_idx;
 
     /* Call data */
     void *data;
 
+    /* Number of the alarm within its context, used in traces.  */
+    unsigned int id;
+
     /* Link to the next and previous alarms in the list.  */
     struct alarm_s *next, *prev;
 };
@@ -74,16 +77,24 @@ struct alarm_context_s {
     /* Alarm list.  */
     struct alarm_s *alarms;
 
-    /* Pending alarm array.  Statically allocated because it's slightly
-       faster this way.  */
+    /* Pending alarms, kept as a binary min-heap ordered by `clk', so the
+       next alarm to be dispatched is always `pending_alarms[0]'.
+       Statically allocated because it's slightly faster this way.  */
     pending_alarms_t pending_alarms[ALARM_CONTEXT_MAX_PENDING_ALARMS];
     unsigned int num_pending_alarms;
 
-    /* Clock tick for the next pending alarm.  */
+    /* Clock tick for the next pending alarm (copy of the heap root, so the
+       CPU loop only has to look at a single value).  */
     CLOCK next_pending_alarm_clk;
 
-    /* Pending alarm number.  */
+    /* Pending alarm number (0 if any alarm is pending, -1 otherwise).  */
     int next_pending_alarm_idx;
+
+    /* Number of alarms created in this context so far.  */
+    unsigned int num_alarms;
+
+    /* Non-zero while the alarm operations are written to a trace.  */
+    int trace;
 };
 typedef struct alarm_context_s alarm_context_t;
 
@@ -100,6 +111,12 @@ extern void alarm_destroy(alarm_t *alarm);
 extern void alarm_unset(alarm_t *alarm);
 extern void alarm_log_too_many_alarms(void);
 
+extern int alarm_context_trace_start(alarm_context_t *context,
+                                     const char *filename);
+extern void alarm_context_trace_stop(alarm_context_t *context);
+extern void alarm_trace_set(alarm_t *alarm, CLOCK cpu_clk);
+extern void alarm_trace_dispatch(alarm_context_t *context, CLOCK cpu_clk);
+
 /* ------------------------------------------------------------------------- */
 
 /* Inline functions.  */
@@ -111,36 +128,86 @@ inline static CLOCK alarm_context_next_pending_clk(alarm_context_t *context)
 
 inline static void alarm_context_update_next_pending(alarm_context_t *context)
 {
-    CLOCK next_pending_alarm_clk = (CLOCK)~0L;
-    unsigned int next_pending_alarm_idx;
-    unsigned int i;
+    if (context->num_pending_alarms > 0) {
+        context->next_pending_alarm_clk = context->pending_alarms[0].clk;
+        context->next_pending_alarm_idx = 0;
+    } else {
+        context->next_pending_alarm_clk = (CLOCK)~0L;
+        context->next_pending_alarm_idx = -1;
+    }
+}
+
+/* Move the heap entry at `idx' towards the root until its parent is not
+   later than it.  */
+inline static void alarm_context_sift_up(alarm_context_t *context,
+                                         unsigned int idx)
+{
+    pending_alarms_t *heap = context->pending_alarms;
+    alarm_t *alarm = heap[idx].alarm;
+    CLOCK clk = heap[idx].clk;
 
-    next_pending_alarm_idx = context->next_pending_alarm_idx;
+    while (idx > 0) {
+        unsigned int parent = (idx - 1) >> 1;
 
-    for (i = 0; i < context->num_pending_alarms; i++) {
-        CLOCK pending_clk = context->pending_alarms[i].clk;
+        if (heap[parent].clk <= clk)
+            break;
 
-        if (pending_clk <= next_pending_alarm_clk) {
-            next_pending_alarm_clk = pending_clk;
-            next_pending_alarm_idx = i;
-        }
+        heap[idx].alarm = heap[parent].alarm;
+        heap[idx].clk = heap[parent].clk;
+        heap[idx].alarm->pending_idx = idx;
+        idx = parent;
     }
 
-    context->next_pending_alarm_clk = next_pending_alarm_clk;
-    context->next_pending_alarm_idx = next_pending_alarm_idx;
+    heap[idx].alarm = alarm;
+    heap[idx].clk = clk;
+    alarm->pending_idx = idx;
+}
+
+/* Move the heap entry at `idx' away from the root until none of its
+   children is earlier than it.  */
+inline static void alarm_context_sift_down(alarm_context_t *context,
+                                           unsigned int idx)
+{
+    pending_alarms_t *heap = context->pending_alarms;
+    unsigned int num = context->num_pending_alarms;
+    alarm_t *alarm = heap[idx].alarm;
+    CLOCK clk = heap[idx].clk;
+
+    for (;;) {
+        unsigned int child = (idx << 1) + 1;
+
+        if (child >= num)
+            break;
+
+        if (child + 1 < num && heap[child + 1].clk < heap[child].clk)
+            child++;
+
+        if (clk <= heap[child].clk)
+            break;
+
+        heap[idx].alarm = heap[child].alarm;
+        heap[idx].clk = heap[child].clk;
+        heap[idx].alarm->pending_idx = idx;
+        idx = child;
+    }
+
+    heap[idx].alarm = alarm;
+    heap[idx].clk = clk;
+    alarm->pending_idx = idx;
 }
 
 inline static void alarm_context_dispatch(alarm_context_t *context,
                                           CLOCK cpu_clk)
 {
     CLOCK offset;
-    unsigned int idx;
     alarm_t *alarm;
 
+    if (context->trace)
+        alarm_trace_dispatch(context, cpu_clk);
+
     offset = (CLOCK)(cpu_clk - context->next_pending_alarm_clk);
 
-    idx = context->next_pending_alarm_idx;
-    alarm = context->pending_alarms[idx].alarm;
+    alarm = context->pending_alarms[0].alarm;
 
     (alarm->callback)(offset, alarm->data);
 }
@@ -153,6 +220,9 @@ inline static void alarm_set(alarm_t *alarm, CLOCK cpu_clk)
     context = alarm->context;
     idx = alarm->pending_idx;
 
+    if (context->trace)
+        alarm_trace_set(alarm, cpu_clk);
+
     if (idx < 0) {
         unsigned int new_idx;
 
@@ -169,20 +239,22 @@ inline static void alarm_set(alarm_t *alarm, CLOCK cpu_clk)
 
         context->num_pending_alarms++;
 
-        if (cpu_clk < context->next_pending_alarm_clk) {
-            context->next_pending_alarm_clk = cpu_clk;
-            context->next_pending_alarm_idx = new_idx;
-        }
-
-        alarm->pending_idx = new_idx;
+        alarm_context_sift_up(context, new_idx);
     } else {
+        CLOCK old_clk;
+
         /* Already pending: modify.  */
 
+        old_clk = context->pending_alarms[idx].clk;
         context->pending_alarms[idx].clk = cpu_clk;
-        if (context->next_pending_alarm_clk > cpu_clk
-            || idx == context->next_pending_alarm_idx)
-            alarm_context_update_next_pending(context);
+
+        if (cpu_clk < old_clk)
+            alarm_context_sift_up(context, (unsigned int)idx);
+        else if (cpu_clk > old_clk)
+            alarm_context_sift_down(context, (unsigned int)idx);
     }
+
+    alarm_context_update_next_pending(context);
 }
 
 #endif
@@ -0,0 +1,440 @@
+/*
+ * alarmbench.c - Alarm scheduler microbenchmark.
+ *
+ * Written by
+ *  VICE Project
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The benchmark works on an alarm workload, i.e. the sequence of
+   `alarm_set()', `alarm_unset()' and dispatch operations the CPU core
+   issues on its alarm context.  A workload modelled on the main C64
+   context (CIA timers and TOD, VIC-II raster, datasette, REU, cartridge
+   NMI, event and sound alarms) can be recorded to a file with `-record',
+   and a recorded workload is replayed with `-replay'.  The real workload
+   of the main CPU is recorded by x64-bench with `-alarmtrace <file>'
+   (see `alarm_context_trace_start()'), and is replayed the same way.
+   During the replay every dispatch is checked against the clock recorded
+   for it, so the benchmark doubles as a consistency check of the
+   scheduler.
+
+   Workload file format, one operation per line:
+
+     S <alarm> <clk>      alarm_set(alarm, clk)
+     U <alarm>            alarm_unset(alarm)
+     P <clk>              poll alarm_context_next_pending_clk()
+     D <clk> <next_clk>   dispatch at `clk', the next alarm is at `next_clk'
+     W <amount> <dir>     alarm_context_time_warp(amount, dir)
+     # <text>             comment
+
+   Traces have no polls, as the CPU does not tell the alarm code when it
+   looks at the next alarm clock.
+*/
+
+#include "vice.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+#include "alarm.h"
+#include "lib.h"
+#include "log.h"
+#include "types.h"
+
+#define BENCH_MAX_ALARMS ALARM_CONTEXT_MAX_PENDING_ALARMS
+
+enum {
+    OP_SET = 'S',
+    OP_UNSET = 'U',
+    OP_POLL = 'P',
+    OP_DISPATCH = 'D',
+    OP_WARP = 'W'
+};
+
+typedef struct bench_op_s {
+    BYTE op;
+    BYTE alarm;
+    CLOCK clk;
+    CLOCK next_clk;     /* the warp direction for OP_WARP */
+} bench_op_t;
+
+static bench_op_t *ops = NULL;
+static unsigned int num_ops = 0;
+static unsigned int max_ops = 0;
+
+static alarm_context_t *context;
+static alarm_t *alarms[BENCH_MAX_ALARMS];
+
+/* ------------------------------------------------------------------------- */
+
+/* The alarm code only logs when it runs out of pending alarm slots; this
+   saves linking the whole logging machinery.  */
+int log_error(log_t log, const char *format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    vfprintf(stderr, format, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void op_add(BYTE op, BYTE alarm, CLOCK clk, CLOCK next_clk)
+{
+    if (num_ops == max_ops) {
+        max_ops = max_ops ? max_ops * 2 : 0x10000;
+        ops = lib_realloc(ops, max_ops * sizeof(bench_op_t));
+    }
+
+    ops[num_ops].op = op;
+    ops[num_ops].alarm = alarm;
+    ops[num_ops].clk = clk;
+    ops[num_ops].next_clk = next_clk;
+    num_ops++;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Synthetic C64 main CPU context.  Each alarm re-arms itself with its
+   period plus some jitter; some of them are occasionally stopped and
+   restarted the way CIA timer writes do.  */
+
+typedef struct bench_source_s {
+    const char *name;
+    CLOCK period;
+    CLOCK jitter;
+    unsigned int restart_chance;
+} bench_source_t;
+
+static const bench_source_t c64_sources[] = {
+    { "CIA1TimerA", 0x4025, 0, 16 },
+    { "CIA1TimerB", 0x0100, 0x40, 4 },
+    { "CIA1TOD", 98525, 0, 0 },
+    { "CIA2TimerA", 0x0200, 0x80, 4 },
+    { "CIA2TimerB", 0x0800, 0x100, 8 },
+    { "CIA2TOD", 98525, 0, 0 },
+    { "VicIIRaster", 63, 0, 0 },
+    { "Datasette", 400, 300, 32 },
+    { "REU", 1000, 2000, 2 },
+    { "CartNMI", 20000, 0, 64 },
+    { "Event", 19656, 0, 0 },
+    { "Sound", 985, 30, 0 },
+    { NULL, 0, 0, 0 }
+};
+
+static unsigned int num_sources;
+static CLOCK record_clk;
+static DWORD rnd_state = 0x1234567;
+
+static DWORD bench_random(void)
+{
+    rnd_state = rnd_state * 1103515245 + 12345;
+    return (rnd_state >> 8) & 0xffffff;
+}
+
+static void record_set(unsigned int n, CLOCK clk)
+{
+    alarm_set(alarms[n], clk);
+    op_add(OP_SET, (BYTE)n, clk, 0);
+}
+
+static void record_alarm_handler(CLOCK offset, void *data)
+{
+    unsigned int n = vice_ptr_to_uint(data);
+    const bench_source_t *src = &c64_sources[n];
+    CLOCK clk;
+
+    clk = record_clk - offset + src->period;
+    if (src->jitter > 0)
+        clk += bench_random() % src->jitter;
+
+    record_set(n, clk);
+
+    /* Stop another timer now and then; it is restarted from the CPU loop. */
+    if (src->restart_chance > 0 && bench_random() % src->restart_chance == 0) {
+        unsigned int victim = bench_random() % num_sources;
+
+        alarm_unset(alarms[victim]);
+        op_add(OP_UNSET, (BYTE)victim, 0, 0);
+    }
+}
+
+static void record_workload(unsigned int cycles)
+{
+    unsigned int i;
+
+    for (i = 0; c64_sources[i].name != NULL; i++) {
+        alarms[i] = alarm_new(context, c64_sources[i].name,
+                              record_alarm_handler,
+                              uint_to_void_ptr(i));
+        record_set(i, c64_sources[i].period);
+    }
+    num_sources = i;
+
+    record_clk = 0;
+    while (record_clk < cycles) {
+        /* One instruction.  */
+        record_clk += 2 + bench_random() % 6;
+        op_add(OP_POLL, 0, record_clk, 0);
+
+        while (record_clk >= alarm_context_next_pending_clk(context)) {
+            op_add(OP_DISPATCH, 0, record_clk,
+                   alarm_context_next_pending_clk(context));
+            alarm_context_dispatch(context, record_clk);
+        }
+
+        /* Restart stopped timers once in a while.  */
+        if (bench_random() % 64 == 0) {
+            unsigned int n = bench_random() % num_sources;
+
+            if (alarms[n]->pending_idx < 0)
+                record_set(n, record_clk + c64_sources[n].period);
+        }
+    }
+}
+
+static int save_workload(const char *filename)
+{
+    FILE *f;
+    unsigned int i;
+
+    f = fopen(filename, "w");
+    if (f == NULL) {
+        fprintf(stderr, "Cannot create `%s'.\n", filename);
+        return -1;
+    }
+
+    for (i = 0; i < num_ops; i++) {
+        switch (ops[i].op) {
+            case OP_SET:
+                fprintf(f, "S %u %u\n", ops[i].alarm, ops[i].clk);
+                break;
+            case OP_UNSET:
+                fprintf(f, "U %u\n", ops[i].alarm);
+                break;
+            case OP_POLL:
+                fprintf(f, "P %u\n", ops[i].clk);
+                break;
+            case OP_DISPATCH:
+                fprintf(f, "D %u %u\n", ops[i].clk, ops[i].next_clk);
+                break;
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int load_workload(const char *filename)
+{
+    FILE *f;
+    char line[80];
+    unsigned int a, b;
+    int d;
+
+    f = fopen(filename, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Cannot open `%s'.\n", filename);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        switch (line[0]) {
+            case OP_SET:
+                if (sscanf(line + 1, "%u %u", &a, &b) == 2
+                    && a < BENCH_MAX_ALARMS) {
+                    op_add(OP_SET, (BYTE)a, (CLOCK)b, 0);
+                    continue;
+                }
+                break;
+            case OP_UNSET:
+                if (sscanf(line + 1, "%u", &a) == 1 && a < BENCH_MAX_ALARMS) {
+                    op_add(OP_UNSET, (BYTE)a, 0, 0);
+                    continue;
+                }
+                break;
+            case OP_POLL:
+                if (sscanf(line + 1, "%u", &a) == 1) {
+                    op_add(OP_POLL, 0, (CLOCK)a, 0);
+                    continue;
+                }
+                break;
+            case OP_DISPATCH:
+                if (sscanf(line + 1, "%u %u", &a, &b) == 2) {
+                    op_add(OP_DISPATCH, 0, (CLOCK)a, (CLOCK)b);
+                    continue;
+                }
+                break;
+            case OP_WARP:
+                if (sscanf(line + 1, "%u %d", &a, &d) == 2) {
+                    op_add(OP_WARP, 0, (CLOCK)a, (CLOCK)d);
+                    continue;
+                }
+                break;
+            case '#':
+                continue;
+        }
+        fprintf(stderr, "Invalid workload line `%s'.\n", line);
+        fclose(f);
+        return -1;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+/* During the replay the handlers do nothing; the re-arming the real
+   handlers did is part of the recorded workload.  */
+static void replay_alarm_handler(CLOCK offset, void *data)
+{
+}
+
+static int replay_workload(unsigned int *mismatches)
+{
+    unsigned int i;
+    CLOCK polled = 0;
+
+    for (i = 0; i < num_ops; i++) {
+        switch (ops[i].op) {
+            case OP_SET:
+                alarm_set(alarms[ops[i].alarm], ops[i].clk);
+                break;
+            case OP_UNSET:
+                alarm_unset(alarms[ops[i].alarm]);
+                break;
+            case OP_POLL:
+                polled += (ops[i].clk >= alarm_context_next_pending_clk(context));
+                break;
+            case OP_DISPATCH:
+                if (alarm_context_next_pending_clk(context) != ops[i].next_clk)
+                    (*mismatches)++;
+                alarm_context_dispatch(context, ops[i].clk);
+                break;
+            case OP_WARP:
+                alarm_context_time_warp(context, ops[i].clk,
+                                        (int)ops[i].next_clk);
+                break;
+        }
+    }
+
+    return (int)polled;
+}
+
+static double bench_time(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static void replay(unsigned int rounds)
+{
+    unsigned int i, round, mismatches = 0;
+    double start, elapsed;
+
+    for (i = 0; i < BENCH_MAX_ALARMS; i++) {
+        char name[16];
+
+        sprintf(name, "Alarm%u", i);
+        alarms[i] = alarm_new(context, name, replay_alarm_handler, NULL);
+    }
+
+    start = bench_time();
+    for (round = 0; round < rounds; round++) {
+        replay_workload(&mismatches);
+        for (i = 0; i < BENCH_MAX_ALARMS; i++)
+            alarm_unset(alarms[i]);
+    }
+    elapsed = bench_time() - start;
+
+    printf("%u operations x %u rounds in %.3f s (%.1f ns/op)\n",
+           num_ops, rounds, elapsed,
+           elapsed * 1e9 / ((double)num_ops * (double)rounds));
+
+    if (mismatches > 0)
+        printf("%u dispatches did not match the recorded alarm clock!\n",
+               mismatches);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void usage(void)
+{
+    printf("Usage: alarmbench -record <file> [cycles]\n"
+           "       alarmbench -replay <file> [rounds]\n"
+           "       alarmbench [cycles [rounds]]\n");
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int cycles = 10000000, rounds = 10;
+
+    context = alarm_context_new("AlarmBench");
+
+    if (argc >= 3 && !strcmp(argv[1], "-record")) {
+        if (argc > 3)
+            cycles = (unsigned int)strtoul(argv[3], NULL, 0);
+        record_workload(cycles);
+        return save_workload(argv[2]) < 0 ? 1 : 0;
+    }
+
+    if (argc >= 3 && !strcmp(argv[1], "-replay")) {
+        if (argc > 3)
+            rounds = (unsigned int)strtoul(argv[3], NULL, 0);
+        if (load_workload(argv[2]) < 0)
+            return 1;
+        alarm_context_destroy(context);
+        context = alarm_context_new("AlarmBench");
+        replay(rounds);
+        return 0;
+    }
+
+    if (argc > 1 && argv[1][0] == '-') {
+        usage();
+        return 1;
+    }
+
+    /* No file: record a workload in memory and replay it right away.  */
+    if (argc > 1)
+        cycles = (unsigned int)strtoul(argv[1], NULL, 0);
+    if (argc > 2)
+        rounds = (unsigned int)strtoul(argv[2], NULL, 0);
+
+    record_workload(cycles);
+    alarm_context_destroy(context);
+    context = alarm_context_new("AlarmBench");
+    replay(rounds);
+
+    return 0;
+}
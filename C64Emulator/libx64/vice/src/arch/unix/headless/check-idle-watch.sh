@@ -0,0 +1,48 @@
+#!/bin/sh
+#
+# check-idle-watch.sh - Check that a watchpoint sees every read of an idle
+# loop, i.e. that the idle loop fast-forward of the main CPU (maincpu.c)
+# is off while the monitor watches memory.
+#
+# check-idle-watch.sh [x64-bench]
+#
+# A small program polls $FB in `LDA $FB / BEQ *-2', which the fast-forward
+# would otherwise skip, with a load watchpoint on $FB.  One pass takes 6
+# cycles, so 100 more frames must hit the watchpoint about 250000 times
+# (less the badlines and the interrupt handler); the check asks for 2000
+# hits per frame.
+#
+
+X64BENCH=${1:-./x64-bench}
+FRAMES=200
+EXTRA=100
+MIN_HITS=`expr $EXTRA \* 2000`
+
+tmp=`mktemp -d /tmp/idlewatch.XXXXXX` || exit 1
+trap 'rm -rf "$tmp"' 0
+
+# 10 SYS2061, then LDA #0 / STA $FB / loop: LDA $FB / BEQ loop
+printf '\001\010\013\010\012\000\236\062\060\066\061\000\000\000' > "$tmp/idle.prg"
+printf '\251\000\205\373\245\373\360\374' >> "$tmp/idle.prg"
+
+echo "watch load fb" > "$tmp/watch.mon"
+
+hits()
+{
+    "$X64BENCH" -frames $1 -moncommands "$tmp/watch.mon" "$tmp/idle.prg" \
+        2>/dev/null | grep -c "Stop on  load 00fb"
+}
+
+before=`hits $FRAMES`
+after=`hits \`expr $FRAMES + $EXTRA\``
+hits=`expr $after - $before`
+
+echo "$hits watchpoint hits in $EXTRA frames"
+
+if [ $hits -lt $MIN_HITS ]; then
+    echo "FAIL: expected at least $MIN_HITS"
+    exit 1
+fi
+
+echo "OK"
+exit 0
@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+# check-sid-queue.sh - Check that the SID register writes queued for the
+# parallel calculation of several SIDs (sid.c) do not pile up when no
+# samples are calculated, as with the dummy sound device of x64-bench.
+#
+# check-sid-queue.sh [x64-bench]
+#
+# A small program writes to both SIDs of a stereo setup with reSID in a
+# loop, about 20000 writes per frame.  Every write that stayed queued
+# would take 16 bytes, so 2000 more frames would add about 600 MB; the
+# check allows the peak resident size to grow by 8 MB.
+#
+
+X64BENCH=${1:-./x64-bench}
+FRAMES=200
+EXTRA=2000
+MAX_GROWTH=8192
+
+tmp=`mktemp -d /tmp/sidqueue.XXXXXX` || exit 1
+trap 'rm -rf "$tmp"' 0
+
+# 10 SYS2061, then LDA #0 / loop: STA $D418 / STA $D438 / JMP loop
+printf '\001\010\013\010\012\000\236\062\060\066\061\000\000\000' > "$tmp/sid.prg"
+printf '\251\000\215\030\324\215\070\324\114\017\010' >> "$tmp/sid.prg"
+
+maxrss()
+{
+    "$X64BENCH" -frames $1 -sidenginemodel 256 -sidstereo 1 \
+        -sidstereoaddress 0xd420 "$tmp/sid.prg" 2>/dev/null \
+        | sed -n 's/^max resident: *\([0-9]*\) kB$/\1/p'
+}
+
+before=`maxrss $FRAMES`
+after=`maxrss \`expr $FRAMES + $EXTRA\``
+
+if [ -z "$before" ] || [ -z "$after" ]; then
+    echo "FAIL: no report from $X64BENCH"
+    exit 1
+fi
+
+growth=`expr $after - $before`
+
+echo "peak resident size $before kB after $FRAMES frames, $after kB after `expr $FRAMES + $EXTRA`"
+
+if [ $growth -gt $MAX_GROWTH ]; then
+    echo "FAIL: grew by $growth kB, expected at most $MAX_GROWTH kB"
+    exit 1
+fi
+
+echo "OK"
+exit 0
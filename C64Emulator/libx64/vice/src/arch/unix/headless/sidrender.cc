@@ -0,0 +1,758 @@
+/*
+ * sidrender.cc - Render a SID register log to a WAV file with reSID.
+ *
+ * Written by
+ *  VICE Project
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* sidrender replays a log of SID register writes (see sid/sid-log.h and
+   the `-sidlog' option) through reSID, as fast as the host allows, and
+   writes the sound to a WAV file.
+
+   Usage: sidrender [-rate <Hz>] [-sampling <0-3>] [-model <0-2>]
+                    [-stereo] [-nofilter] [-tail <seconds>]
+                    [-jobs <n>] [-chunk <seconds>] [-preroll <seconds>]
+                    <log> <wav>
+
+   `-sampling' and `-model' take the values of the SidResidSampling and
+   SidModel resources; the model defaults to the one in the log.  The
+   SIDs are mixed like VICE does: with `-stereo' the first SID goes left,
+   the second (or else the first again) right and a third one to both
+   sides.
+
+   The log is cut into chunks of `-chunk' seconds that are rendered by
+   `-jobs' threads, each SID of each chunk on its own.  A quick first pass
+   over the log, without filters and sampling, saves the state of every
+   SID at the start of each chunk, minus `-preroll' seconds.  A chunk
+   restores that state and renders the preroll to bring the filters and
+   the resampling buffer up to date, then throws the preroll away.  The
+   first pass clocks reSID in steps, which skips the pipeline delays of
+   the noise register, so after a chunk boundary the noise can take
+   another (equally random) course.  `-chunk 0' renders the whole log in
+   one piece per SID, exactly.
+   All lengths are rounded to a whole number of sampling periods, so every
+   chunk starts on a sample.  */
+
+#include "vice.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern "C" {
+#include "sid-log.h"
+#include "sound.h"
+#include "types.h"
+} // extern "C"
+
+#include "resid/sid.h"
+
+using namespace reSID;
+
+#define RENDER_MAX_SIDS 3
+
+/* reSID clocks at most this many cycles at a time.  */
+#define RENDER_MAX_DELTA 0x100000
+
+typedef unsigned long long render_clock_t;
+
+typedef struct render_record_s {
+    render_clock_t clk;
+    BYTE tag;
+    BYTE value;
+} render_record_t;
+
+/* One SID of one chunk.  */
+typedef struct render_job_s {
+    SID *sid;
+    int chipno;
+    render_clock_t from;   /* start of the preroll */
+    render_clock_t start;  /* first cycle of the chunk */
+    render_clock_t end;    /* first cycle after the chunk */
+    const SID::State *state;
+    short *buf;
+    int nr;
+    int result;
+} render_job_t;
+
+static int render_rate = 44100;
+static int render_sampling = 2;
+static int render_model = -1;
+static int render_stereo = 0;
+static int render_filters = 1;
+static double render_tail = 1.0;
+static int render_jobs = 0;
+static double render_chunk = 60.0;
+static double render_preroll = 1.0;
+
+static render_record_t *records = NULL;
+static int num_records = 0;
+static int num_chips = 1;
+static double cycles_per_sec = 985248.0;
+
+static render_job_t *jobs;
+static int num_jobs;
+static int next_job;
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* ------------------------------------------------------------------------- */
+
+static int load_log(const char *filename)
+{
+    FILE *f;
+    BYTE header[SID_LOG_HEADER_SIZE];
+    render_clock_t clk = 0;
+    int size = 0;
+    int c, chipno;
+
+    f = fopen(filename, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "Cannot open `%s'.\n", filename);
+        return -1;
+    }
+
+    if (fread(header, 1, sizeof(header), f) != sizeof(header)
+        || memcmp(header, SID_LOG_MAGIC, SID_LOG_MAGIC_LEN) != 0
+        || header[8] < 1 || header[8] > SID_LOG_VERSION) {
+        fprintf(stderr, "`%s' is not a SID log.\n", filename);
+        fclose(f);
+        return -1;
+    }
+
+    num_chips = header[9];
+    if (render_model < 0) {
+        render_model = header[10];
+    }
+    cycles_per_sec = (double)(header[12] | (header[13] << 8)
+                              | (header[14] << 16)
+                              | ((DWORD)header[15] << 24));
+
+    while ((c = fgetc(f)) != EOF) {
+        render_record_t *r;
+        int shift = 0;
+
+        clk += (render_clock_t)(c & 0x7f);
+        while (c & 0x80) {
+            shift += 7;
+            if ((c = fgetc(f)) == EOF) {
+                break;
+            }
+            clk += (render_clock_t)(c & 0x7f) << shift;
+        }
+
+        if (num_records == size) {
+            size = size ? size * 2 : 0x10000;
+            records = (render_record_t *)realloc(records,
+                                                 size * sizeof(*records));
+            if (records == NULL) {
+                fprintf(stderr, "Out of memory.\n");
+                exit(1);
+            }
+        }
+
+        r = &records[num_records];
+        r->clk = clk;
+        if ((c = fgetc(f)) == EOF) {
+            break;
+        }
+        r->tag = (BYTE)c;
+        r->value = 0;
+        chipno = c >> 5;
+        if (r->tag < SID_LOG_EVENT || r->tag == SID_LOG_EVENT_SEGMENT) {
+            if ((c = fgetc(f)) == EOF) {
+                break;
+            }
+            r->value = (BYTE)c;
+            if (r->tag == SID_LOG_EVENT_SEGMENT) {
+                chipno = r->value - 1;
+            }
+            if (chipno >= num_chips) {
+                num_chips = chipno + 1;
+            }
+        }
+        num_records++;
+    }
+
+    fclose(f);
+
+    if (num_chips < 1) {
+        num_chips = 1;
+    }
+    if (num_chips > RENDER_MAX_SIDS) {
+        num_chips = RENDER_MAX_SIDS;
+    }
+
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Set up a SID like `resid_init()' does for the SidModel resource.  */
+static SID *render_sid_new(sampling_method method, bool filters)
+{
+    SID *sid = new SID;
+
+    switch (render_model) {
+      default:
+      case 0:
+        sid->set_chip_model(MOS6581);
+        sid->set_voice_mask(0x07);
+        sid->input(0);
+        break;
+      case 1:
+        sid->set_chip_model(MOS8580);
+        sid->set_voice_mask(0x07);
+        sid->input(0);
+        break;
+      case 2:
+        sid->set_chip_model(MOS8580);
+        sid->set_voice_mask(0x0f);
+        sid->input(-32768);
+        break;
+    }
+    sid->enable_filter(filters);
+    sid->enable_external_filter(filters);
+
+    if (!sid->set_sampling_parameters(cycles_per_sec, method, render_rate,
+                                      render_rate * 90 / 200.0, 0.97)) {
+        fprintf(stderr, "Sampling rate %d Hz is out of spec.\n",
+                render_rate);
+        exit(1);
+    }
+
+    return sid;
+}
+
+/* A new segment resets the SIDs it does not have.  */
+static inline int record_applies(const render_record_t *r, int chipno)
+{
+    if (r->tag == SID_LOG_EVENT_SEGMENT) {
+        return chipno >= r->value;
+    }
+    return r->tag == SID_LOG_EVENT_RESET || (r->tag >> 5) == chipno;
+}
+
+static inline void record_apply(SID *sid, const render_record_t *r)
+{
+    if (r->tag == SID_LOG_EVENT_RESET || r->tag == SID_LOG_EVENT_SEGMENT) {
+        sid->reset();
+    } else if (r->tag < SID_LOG_EVENT) {
+        sid->write(r->tag & 0x1f, r->value);
+    }
+}
+
+static int find_record(render_clock_t clk)
+{
+    int lo = 0, hi = num_records;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (records[mid].clk < clk) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Render the cycles from `*clk' up to `end' of one SID into `buf',
+   applying its writes on the way.  Returns the number of samples, or -1
+   if `buf' is too small.  */
+static int render_span(SID *sid, int chipno, int *rec, render_clock_t *clk,
+                       render_clock_t end, short *buf, int n)
+{
+    int result = 0;
+
+    while (*clk < end) {
+        render_clock_t next = end;
+        cycle_count delta_t;
+
+        while (*rec < num_records && records[*rec].clk < end
+               && !record_applies(&records[*rec], chipno)) {
+            (*rec)++;
+        }
+        if (*rec < num_records && records[*rec].clk < end) {
+            next = records[*rec].clk;
+        }
+        if (next - *clk > RENDER_MAX_DELTA) {
+            next = *clk + RENDER_MAX_DELTA;
+        }
+
+        delta_t = (cycle_count)(next - *clk);
+        while (delta_t > 0) {
+            if (result == n) {
+                return -1;
+            }
+            result += sid->clock(delta_t, buf + result, n - result);
+        }
+        *clk = next;
+
+        while (*rec < num_records && records[*rec].clk == *clk) {
+            if (record_applies(&records[*rec], chipno)) {
+                record_apply(sid, &records[*rec]);
+            }
+            (*rec)++;
+        }
+    }
+
+    return result;
+}
+
+static int samples_in(render_clock_t cycles)
+{
+    return (int)((double)cycles * render_rate / cycles_per_sec) + 16;
+}
+
+static void render_job(render_job_t *job)
+{
+    render_clock_t clk = job->from;
+    int rec = find_record(clk);
+
+    if (job->state != NULL) {
+        job->sid->write_state(*job->state);
+    }
+
+    if (job->from < job->start) {
+        int n = samples_in(job->start - job->from);
+        short *preroll = new short[n];
+
+        render_span(job->sid, job->chipno, &rec, &clk, job->start,
+                    preroll, n);
+        delete[] preroll;
+    }
+
+    job->result = render_span(job->sid, job->chipno, &rec, &clk, job->end,
+                              job->buf, job->nr);
+}
+
+static void *render_thread(void *arg)
+{
+    for (;;) {
+        int i;
+
+        pthread_mutex_lock(&job_lock);
+        i = next_job++;
+        pthread_mutex_unlock(&job_lock);
+
+        if (i >= num_jobs) {
+            return NULL;
+        }
+        render_job(&jobs[i]);
+    }
+}
+
+static void render_all(int threads)
+{
+    pthread_t *thread;
+    int i;
+
+    next_job = 0;
+
+    if (threads > num_jobs) {
+        threads = num_jobs;
+    }
+    if (threads <= 1) {
+        render_thread(NULL);
+        return;
+    }
+
+    thread = new pthread_t[threads];
+    for (i = 0; i < threads; i++) {
+        pthread_create(&thread[i], NULL, render_thread, NULL);
+    }
+    for (i = 0; i < threads; i++) {
+        pthread_join(thread[i], NULL);
+    }
+    delete[] thread;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Clock the SIDs through the log without filters and sampling and save
+   their state at each of the `num' cycles in `at' (ascending).  */
+static void save_states(const render_clock_t *at, int num,
+                        SID::State (*states)[RENDER_MAX_SIDS])
+{
+    SID *sid[RENDER_MAX_SIDS];
+    render_clock_t clk[RENDER_MAX_SIDS];
+    int rec = 0;
+    int i, k;
+
+    for (i = 0; i < num_chips; i++) {
+        sid[i] = render_sid_new(SAMPLE_FAST, false);
+        clk[i] = records[0].clk;
+    }
+
+    for (k = 0; k < num; k++) {
+        for (; rec < num_records && records[rec].clk < at[k]; rec++) {
+            const render_record_t *r = &records[rec];
+
+            for (i = 0; i < num_chips; i++) {
+                if (record_applies(r, i)) {
+                    while (clk[i] < r->clk) {
+                        render_clock_t delta_t = r->clk - clk[i];
+
+                        if (delta_t > RENDER_MAX_DELTA) {
+                            delta_t = RENDER_MAX_DELTA;
+                        }
+                        sid[i]->clock((cycle_count)delta_t);
+                        clk[i] += delta_t;
+                    }
+                    record_apply(sid[i], r);
+                }
+            }
+        }
+
+        for (i = 0; i < num_chips; i++) {
+            while (clk[i] < at[k]) {
+                render_clock_t delta_t = at[k] - clk[i];
+
+                if (delta_t > RENDER_MAX_DELTA) {
+                    delta_t = RENDER_MAX_DELTA;
+                }
+                sid[i]->clock((cycle_count)delta_t);
+                clk[i] += delta_t;
+            }
+            states[k][i] = sid[i]->read_state();
+        }
+    }
+
+    for (i = 0; i < num_chips; i++) {
+        delete sid[i];
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+
+static FILE *wav_file;
+static DWORD wav_samples;
+
+/* Store number as little endian. */
+static void le_store(BYTE *buf, DWORD val, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++) {
+        buf[i] = (BYTE)(val & 0xff);
+        val >>= 8;
+    }
+}
+
+static int wav_open(const char *filename, int channels)
+{
+    /* RIFF/WAV header. */
+    BYTE header[45] =
+      "RIFFllllWAVEfmt \020\0\0\0\001\0ccrrrrbbbb88\020\0datallll";
+
+    wav_file = fopen(filename, "wb");
+    if (wav_file == NULL) {
+        fprintf(stderr, "Cannot create `%s'.\n", filename);
+        return -1;
+    }
+
+    wav_samples = 0;
+
+    le_store(header + 22, (DWORD)channels, 2);
+    le_store(header + 24, (DWORD)render_rate, 4);
+    le_store(header + 28, (DWORD)(render_rate * channels * 2), 4);
+    le_store(header + 32, (DWORD)(channels * 2), 2);
+
+    return (fwrite(header, 1, 44, wav_file) != 44) ? -1 : 0;
+}
+
+static int wav_write(const SWORD *pbuf, int nr)
+{
+    BYTE *out = new BYTE[nr * 2];
+    int i, res;
+
+    for (i = 0; i < nr; i++) {
+        le_store(out + i * 2, (DWORD)(WORD)pbuf[i], 2);
+    }
+    res = ((int)fwrite(out, 2, nr, wav_file) != nr) ? -1 : 0;
+    delete[] out;
+
+    wav_samples += nr;
+    return res;
+}
+
+static int wav_close(void)
+{
+    BYTE len[4];
+    int res = 0;
+
+    le_store(len, wav_samples * 2 + 36, 4);
+    fseek(wav_file, 4, SEEK_SET);
+    res |= (fwrite(len, 1, 4, wav_file) != 4);
+    le_store(len, wav_samples * 2, 4);
+    fseek(wav_file, 40, SEEK_SET);
+    res |= (fwrite(len, 1, 4, wav_file) != 4);
+    res |= (fclose(wav_file) != 0);
+
+    return res ? -1 : 0;
+}
+
+/* Mix the SIDs of one chunk like `sid_sound_machine_calculate_samples()'
+   and write them out.  */
+static int write_chunk(render_job_t *chunk, int channels)
+{
+    SWORD *pbuf;
+    int nr = chunk[0].result;
+    int i, c, res;
+
+    for (c = 1; c < num_chips; c++) {
+        if (chunk[c].result < nr) {
+            nr = chunk[c].result;
+        }
+    }
+
+    pbuf = new SWORD[nr * channels];
+    for (i = 0; i < nr; i++) {
+        if (channels == 1) {
+            pbuf[i] = chunk[0].buf[i];
+            for (c = 1; c < num_chips; c++) {
+                pbuf[i] = sound_audio_mix(pbuf[i], chunk[c].buf[i]);
+            }
+        } else {
+            pbuf[i * 2] = chunk[0].buf[i];
+            pbuf[i * 2 + 1] = chunk[num_chips > 1 ? 1 : 0].buf[i];
+            if (num_chips > 2) {
+                pbuf[i * 2] = sound_audio_mix(pbuf[i * 2], chunk[2].buf[i]);
+                pbuf[i * 2 + 1] = sound_audio_mix(pbuf[i * 2 + 1],
+                                                  chunk[2].buf[i]);
+            }
+        }
+    }
+
+    res = wav_write(pbuf, nr * channels);
+    delete[] pbuf;
+
+    return res;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static render_clock_t gcd(render_clock_t a, render_clock_t b)
+{
+    while (b != 0) {
+        render_clock_t t = a % b;
+
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: sidrender [-rate <Hz>] [-sampling <0-3>] [-model <0-2>]\n"
+            "                 [-stereo] [-nofilter] [-tail <seconds>]\n"
+            "                 [-jobs <n>] [-chunk <seconds>]"
+            " [-preroll <seconds>]\n"
+            "                 <log> <wav>\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    static const sampling_method methods[] = {
+        SAMPLE_FAST, SAMPLE_INTERPOLATE, SAMPLE_RESAMPLE,
+        SAMPLE_RESAMPLE_FASTMEM
+    };
+    const char *log_name = NULL, *wav_name = NULL;
+    render_clock_t first, last, period, chunk_cycles, preroll_cycles;
+    render_clock_t *from;
+    SID::State (*states)[RENDER_MAX_SIDS];
+    render_clock_t sample_cycles;
+    int num_chunks, chunks_per_round, channels;
+    int i, k, c;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-rate") && i + 1 < argc) {
+            render_rate = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-sampling") && i + 1 < argc) {
+            render_sampling = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-model") && i + 1 < argc) {
+            render_model = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-stereo")) {
+            render_stereo = 1;
+        } else if (!strcmp(argv[i], "-nofilter")) {
+            render_filters = 0;
+        } else if (!strcmp(argv[i], "-tail") && i + 1 < argc) {
+            render_tail = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "-jobs") && i + 1 < argc) {
+            render_jobs = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-chunk") && i + 1 < argc) {
+            render_chunk = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "-preroll") && i + 1 < argc) {
+            render_preroll = atof(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            usage();
+        } else if (log_name == NULL) {
+            log_name = argv[i];
+        } else if (wav_name == NULL) {
+            wav_name = argv[i];
+        } else {
+            usage();
+        }
+    }
+
+    if (wav_name == NULL || render_rate <= 0 || render_sampling < 0
+        || render_sampling > 3) {
+        usage();
+    }
+    if (render_jobs <= 0) {
+        render_jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (render_jobs <= 0) {
+            render_jobs = 1;
+        }
+    }
+
+    if (load_log(log_name) < 0) {
+        return 1;
+    }
+    if (num_records == 0) {
+        fprintf(stderr, "`%s' is empty.\n", log_name);
+        return 1;
+    }
+
+    first = records[0].clk;
+    last = records[num_records - 1].clk
+           + (render_clock_t)(render_tail * cycles_per_sec);
+
+    /* reSID takes a new sample every `sample_cycles' / 65536 cycles, so
+       the samples fall on the same cycles again after `period' cycles.  */
+    sample_cycles = (render_clock_t)(cycles_per_sec / render_rate * 65536.0
+                                     + 0.5);
+    period = sample_cycles / gcd(sample_cycles, 65536);
+
+    if (render_chunk > 0.0) {
+        chunk_cycles = (render_clock_t)(render_chunk * cycles_per_sec
+                                        / period + 0.5) * period;
+        if (chunk_cycles < period) {
+            chunk_cycles = period;
+        }
+        num_chunks = (int)((last - first + chunk_cycles - 1) / chunk_cycles);
+    } else {
+        chunk_cycles = last - first;
+        num_chunks = 1;
+    }
+    preroll_cycles = (render_clock_t)(render_preroll * cycles_per_sec
+                                      / period + 0.999) * period;
+
+    /* State of all SIDs at the start of each chunk's preroll.  */
+    from = new render_clock_t[num_chunks];
+    states = new SID::State[num_chunks][RENDER_MAX_SIDS];
+    for (k = 0; k < num_chunks; k++) {
+        render_clock_t start = first + k * chunk_cycles;
+
+        from[k] = (start - first > preroll_cycles) ? start - preroll_cycles
+                                                    : first;
+    }
+    if (num_chunks > 1) {
+        save_states(from, num_chunks, states);
+    }
+
+    channels = render_stereo ? 2 : 1;
+    if (wav_open(wav_name, channels) < 0) {
+        return 1;
+    }
+
+    /* Render as many chunks at once as there are threads, to keep the
+       buffers small.  The SIDs are set up here, as reSID shares the
+       tables of the resampling filter between them.  */
+    chunks_per_round = render_jobs;
+    jobs = new render_job_t[chunks_per_round * num_chips];
+
+    for (k = 0; k < num_chunks; k += chunks_per_round) {
+        int chunks = num_chunks - k;
+
+        if (chunks > chunks_per_round) {
+            chunks = chunks_per_round;
+        }
+
+        num_jobs = chunks * num_chips;
+        for (i = 0; i < chunks; i++) {
+            render_clock_t start = first + (k + i) * chunk_cycles;
+            render_clock_t end = start + chunk_cycles;
+
+            if (end > last) {
+                end = last;
+            }
+            for (c = 0; c < num_chips; c++) {
+                render_job_t *job = &jobs[i * num_chips + c];
+
+                job->sid = render_sid_new(methods[render_sampling],
+                                          render_filters != 0);
+                job->chipno = c;
+                job->from = from[k + i];
+                job->start = start;
+                job->end = end;
+                job->state = (from[k + i] > first) ? &states[k + i][c]
+                                                   : NULL;
+                job->nr = samples_in(end - start);
+                job->buf = new short[job->nr];
+                job->result = 0;
+            }
+        }
+
+        render_all(render_jobs);
+
+        for (i = 0; i < chunks; i++) {
+            for (c = 0; c < num_chips; c++) {
+                if (jobs[i * num_chips + c].result < 0) {
+                    fprintf(stderr, "Sample buffer overflow.\n");
+                    return 1;
+                }
+            }
+            if (write_chunk(&jobs[i * num_chips], channels) < 0) {
+                fprintf(stderr, "Cannot write `%s'.\n", wav_name);
+                return 1;
+            }
+        }
+
+        for (i = 0; i < num_jobs; i++) {
+            delete jobs[i].sid;
+            delete[] jobs[i].buf;
+        }
+    }
+
+    if (wav_close() < 0) {
+        fprintf(stderr, "Cannot write `%s'.\n", wav_name);
+        return 1;
+    }
+
+    printf("%d SID%s, %.1f s, %d chunk%s\n", num_chips,
+           (num_chips > 1) ? "s" : "", (double)wav_samples / channels
+           / render_rate, num_chunks, (num_chunks > 1) ? "s" : "");
+
+    delete[] jobs;
+    delete[] states;
+    delete[] from;
+    free(records);
+
+    return 0;
+}
@@ -0,0 +1,333 @@
+/*
+ * ui.c - User interface stubs for the headless build.
+ *
+ * Written by
+ *  VICE Project
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "c64ui.h"
+#include "console.h"
+#include "fullscreen.h"
+#include "kbd.h"
+#include "lib.h"
+#include "monitor.h"
+#include "types.h"
+#include "ui.h"
+#include "uiapi.h"
+#include "uimon.h"
+#include "video.h"
+#include "vsidui.h"
+
+/* There is nobody to answer questions: messages go to stderr, and CPU
+   JAMs and other dialogs take the non-interactive choice.  */
+
+void archdep_ui_init(int argc, char *argv[])
+{
+}
+
+int ui_init(int *argc, char **argv)
+{
+    return 0;
+}
+
+int ui_init_finish(void)
+{
+    return 0;
+}
+
+int ui_init_finalize(void)
+{
+    return 0;
+}
+
+void ui_shutdown(void)
+{
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void ui_vprint(const char *prefix, const char *format, va_list args)
+{
+    fprintf(stderr, "%s", prefix);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+}
+
+void ui_message(const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    ui_vprint("", format, args);
+    va_end(args);
+}
+
+void ui_error(const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    ui_vprint("Error: ", format, args);
+    va_end(args);
+}
+
+ui_jam_action_t ui_jam_dialog(const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    ui_vprint("", format, args);
+    va_end(args);
+
+    return UI_JAM_HARD_RESET;
+}
+
+int ui_extend_image_dialog(void)
+{
+    return 0;
+}
+
+char *ui_get_file(const char *format, ...)
+{
+    return NULL;
+}
+
+void ui_display_statustext(const char *text, int fade_out)
+{
+}
+
+void ui_display_speed(float speed, float frame_rate, int warp_enabled)
+{
+}
+
+void ui_display_paused(int flag)
+{
+}
+
+void ui_update_menus(void)
+{
+}
+
+void ui_check_mouse_cursor(void)
+{
+}
+
+/* ------------------------------------------------------------------------- */
+
+void ui_enable_drive_status(ui_drive_enable_t enable, int *color)
+{
+}
+
+void ui_display_drive_track(unsigned int drive_number, unsigned int drive_base,
+                            unsigned int half_track_number)
+{
+}
+
+void ui_display_drive_led(int drive_number, unsigned int pwm1, unsigned int pwm2)
+{
+}
+
+void ui_display_drive_current_image(unsigned int drive_number,
+                                    const char *image)
+{
+}
+
+void ui_set_tape_status(int enable)
+{
+}
+
+void ui_display_tape_current_image(const char *image)
+{
+}
+
+void ui_display_tape_control_status(int control)
+{
+}
+
+void ui_display_tape_motor_status(int motor)
+{
+}
+
+void ui_display_tape_counter(int counter)
+{
+}
+
+void ui_display_recording(int recording_status)
+{
+}
+
+void ui_display_playback(int playback_status, char *version)
+{
+}
+
+void ui_display_event_time(unsigned int current, unsigned int total)
+{
+}
+
+void ui_display_joyport(BYTE *joyport)
+{
+}
+
+void ui_display_volume(int vol)
+{
+}
+
+/* ------------------------------------------------------------------------- */
+
+int c64ui_init(void)
+{
+    return 0;
+}
+
+void c64ui_shutdown(void)
+{
+}
+
+int vsid_ui_init(void)
+{
+    return 0;
+}
+
+void vsid_ui_display_name(const char *name)
+{
+}
+
+void vsid_ui_display_author(const char *author)
+{
+}
+
+void vsid_ui_display_copyright(const char *copyright)
+{
+}
+
+void vsid_ui_display_sync(int sync)
+{
+}
+
+void vsid_ui_display_sid_model(int model)
+{
+}
+
+void vsid_ui_display_irqtype(const char *irq)
+{
+}
+
+void vsid_ui_set_default_tune(int nr)
+{
+}
+
+void vsid_ui_display_tune_nr(int nr)
+{
+}
+
+void vsid_ui_display_nr_of_tunes(int count)
+{
+}
+
+void vsid_ui_display_time(unsigned int sec)
+{
+}
+
+void vsid_ui_close(void)
+{
+}
+
+void vsid_ui_setdrv(char *driver_info_text)
+{
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* The monitor has no input; it is left again right away.  */
+static console_t monitor_console = { 80, 25, 0, 0, NULL };
+
+console_t *uimon_window_open(void)
+{
+    return &monitor_console;
+}
+
+void uimon_window_close(void)
+{
+}
+
+void uimon_window_suspend(void)
+{
+}
+
+console_t *uimon_window_resume(void)
+{
+    return &monitor_console;
+}
+
+int uimon_out(const char *buffer)
+{
+    fputs(buffer, stdout);
+    return 0;
+}
+
+char *uimon_get_in(char **ppchCommandLine, const char *prompt)
+{
+    return lib_stralloc("x");
+}
+
+void uimon_notify_change(void)
+{
+}
+
+void uimon_set_interface(monitor_interface_t **monitor_interface_init,
+                         int count)
+{
+}
+
+/* ------------------------------------------------------------------------- */
+
+void fullscreen_capability(cap_fullscreen_t *cap_fullscreen)
+{
+    cap_fullscreen->device_num = 0;
+}
+
+void kbd_arch_init(void)
+{
+}
+
+signed long kbd_arch_keyname_to_keynum(char *keyname)
+{
+    return (signed long)atoi(keyname);
+}
+
+const char *kbd_arch_keynum_to_keyname(signed long keynum)
+{
+    static char keyname[20];
+
+    sprintf(keyname, "%li", keynum);
+    return keyname;
+}
+
+void kbd_initialize_numpad_joykeys(int *joykeys)
+{
+}
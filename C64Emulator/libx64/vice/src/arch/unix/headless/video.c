@@ -0,0 +1,139 @@
+/*
+ * video.c - Null video canvas for the headless build.
+ *
+ * Written by
+ *  VICE Project
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include "lib.h"
+#include "log.h"
+#include "palette.h"
+#include "types.h"
+#include "videoarch.h"
+#include "video.h"
+
+static log_t video_log = LOG_ERR;
+
+/* ------------------------------------------------------------------------- */
+
+int video_arch_resources_init(void)
+{
+    return 0;
+}
+
+void video_arch_resources_shutdown(void)
+{
+}
+
+int video_init_cmdline_options(void)
+{
+    return 0;
+}
+
+int video_init(void)
+{
+    if (video_log == LOG_ERR) {
+        video_log = log_open("HeadlessVideo");
+    }
+
+    return 0;
+}
+
+void video_shutdown(void)
+{
+    if (video_log != LOG_ERR) {
+        log_close(video_log);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+
+void video_arch_canvas_init(struct video_canvas_s *canvas)
+{
+    canvas->video_draw_buffer_callback = NULL;
+    canvas->refresh_count = 0;
+}
+
+video_canvas_t *video_canvas_create(video_canvas_t *canvas,
+                                    unsigned int *width, unsigned int *height,
+                                    int mapped)
+{
+    canvas->width = *width;
+    canvas->height = *height;
+    canvas->depth = 32;
+
+    video_canvas_set_palette(canvas, canvas->palette);
+
+    return canvas;
+}
+
+void video_canvas_destroy(video_canvas_t *canvas)
+{
+}
+
+char video_canvas_can_resize(video_canvas_t *canvas)
+{
+    return 1;
+}
+
+void video_canvas_resize(video_canvas_t *canvas, char resize_canvas)
+{
+    canvas->width = canvas->draw_buffer->visible_width;
+    canvas->height = canvas->draw_buffer->visible_height;
+}
+
+/* Nothing is displayed, so the frame is not converted to host pixels.  */
+void video_canvas_refresh(video_canvas_t *canvas,
+                          unsigned int xs, unsigned int ys,
+                          unsigned int xi, unsigned int yi,
+                          unsigned int w, unsigned int h)
+{
+    canvas->refresh_count++;
+}
+
+int video_canvas_set_palette(video_canvas_t *canvas, palette_t *palette)
+{
+    canvas->palette = palette;
+
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+int uicolor_alloc_color(unsigned int red, unsigned int green,
+                        unsigned int blue, unsigned long *color_pixel,
+                        BYTE *pixel_return)
+{
+    return 0;
+}
+
+void uicolor_convert_color_table(unsigned int colnr, BYTE *data,
+                                 long color_pixel, void *c)
+{
+}
+
+void uicolor_free_color(unsigned int red, unsigned int green,
+                        unsigned int blue, unsigned long color_pixel)
+{
+}
@@ -0,0 +1,188 @@
+/*
+ * x64bench.c - Headless benchmark driver for the x64 core.
+ *
+ * Written by
+ *  VICE Project
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* x64-bench runs the C64 emulation without any user interface, as fast as
+   the host allows: no throttling, no frame skipping, a null video canvas
+   and the dummy sound device (the SID is still emulated).  After the
+   requested number of frames it prints the emulation speed and exits.
+
+   Usage: x64-bench [-frames <n>] [-skip <n>] [-snapshot <file>]
+                    [-alarmtrace <file>]
+                    [VICE options] [image]
+
+   `image' (PRG, T64, D64, snapshot...) is autostarted like with x64.  The
+   first `-skip' frames (boot and autostart) are run before the measurement
+   starts.  With `-snapshot', the machine state at the end of the run is
+   saved to `file', so that the results of two builds can be compared.
+   With `-alarmtrace', the alarm operations of the main CPU during the
+   measured frames are written to `file', which alarmbench can replay.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "alarm.h"
+#include "interrupt.h"
+#include "lib.h"
+#include "machine.h"
+#include "main.h"
+#include "maincpu.h"
+#include "types.h"
+#include "ui.h"
+#include "uiapi.h"
+#include "vsyncapi.h"
+
+#define BENCH_DEFAULT_FRAMES 3000
+
+static unsigned long bench_frames = BENCH_DEFAULT_FRAMES;
+static unsigned long bench_skip_frames = 0;
+static char *bench_snapshot_name = NULL;
+static char *bench_alarm_trace_name = NULL;
+
+static unsigned long frame_count = 0;
+static unsigned long start_time;
+static CLOCK start_clk;
+
+static void bench_report(void)
+{
+    unsigned long frames = frame_count - bench_skip_frames;
+    double seconds, cycles;
+    struct rusage usage;
+
+    seconds = (double)(vsyncarch_gettime() - start_time)
+              / (double)vsyncarch_frequency();
+    cycles = (double)(CLOCK)(maincpu_clk - start_clk);
+
+    if (seconds <= 0.0) {
+        seconds = 1e-9;
+    }
+
+    printf("frames:           %lu\n", frames);
+    printf("emulated cycles:  %.0f\n", cycles);
+    printf("host time:        %.3f s\n", seconds);
+    printf("cycles/sec:       %.0f\n", cycles / seconds);
+    printf("frames/sec:       %.2f\n", (double)frames / seconds);
+    printf("host time/frame:  %.1f us\n", seconds * 1e6 / (double)frames);
+    printf("speed:            %.1f%% of a PAL C64\n",
+           cycles / seconds * 100.0 / (double)machine_get_cycles_per_second());
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        printf("max resident:     %ld kB\n", (long)usage.ru_maxrss);
+    }
+}
+
+static void bench_exit(void)
+{
+    fflush(stdout);
+    machine_shutdown();
+    exit(0);
+}
+
+/* Snapshots have to be taken between two opcodes.  */
+static void bench_snapshot_trap(WORD addr, void *data)
+{
+    if (machine_write_snapshot(bench_snapshot_name, 0, 0, 0) < 0) {
+        fprintf(stderr, "Cannot write snapshot `%s'.\n", bench_snapshot_name);
+    }
+    bench_exit();
+}
+
+/* Called by `vsync_do_vsync()' once per emulated frame.  */
+void ui_dispatch_events(void)
+{
+    if (frame_count == bench_skip_frames) {
+        if (bench_alarm_trace_name != NULL) {
+            alarm_context_trace_start(maincpu_alarm_context,
+                                      bench_alarm_trace_name);
+        }
+        start_time = vsyncarch_gettime();
+        start_clk = maincpu_clk;
+    }
+
+    if (frame_count == bench_skip_frames + bench_frames) {
+        alarm_context_trace_stop(maincpu_alarm_context);
+        bench_report();
+        if (bench_snapshot_name == NULL) {
+            bench_exit();
+        }
+        interrupt_maincpu_trigger_trap(bench_snapshot_trap, NULL);
+    }
+
+    frame_count++;
+}
+
+void ui_dispatch_next_event(void)
+{
+}
+
+int main(int argc, char **argv)
+{
+    char **vice_argv;
+    int vice_argc = 0;
+    int i;
+
+    vice_argv = lib_malloc(sizeof(char *) * (argc + 16));
+    vice_argv[vice_argc++] = argv[0];
+
+    /* Start from the factory defaults and run unthrottled, drawing every
+       frame, so runs are comparable.  */
+    vice_argv[vice_argc++] = "-default";
+    vice_argv[vice_argc++] = "-speed";
+    vice_argv[vice_argc++] = "0";
+    vice_argv[vice_argc++] = "-refresh";
+    vice_argv[vice_argc++] = "1";
+    vice_argv[vice_argc++] = "-sounddev";
+    vice_argv[vice_argc++] = "dummy";
+#ifdef HEADLESS_ROMDIR
+    vice_argv[vice_argc++] = "-directory";
+    vice_argv[vice_argc++] = HEADLESS_ROMDIR "/C64:" HEADLESS_ROMDIR "/DRIVES:"
+                             HEADLESS_ROMDIR "/PRINTER";
+#endif
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-frames") && i + 1 < argc) {
+            bench_frames = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-skip") && i + 1 < argc) {
+            bench_skip_frames = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-snapshot") && i + 1 < argc) {
+            bench_snapshot_name = argv[++i];
+        } else if (!strcmp(argv[i], "-alarmtrace") && i + 1 < argc) {
+            bench_alarm_trace_name = argv[++i];
+        } else {
+            vice_argv[vice_argc++] = argv[i];
+        }
+    }
+
+    if (bench_frames == 0) {
+        bench_frames = 1;
+    }
+
+    vice_argv[vice_argc] = NULL;
+
+    return main_program(vice_argc, vice_argv);
+}
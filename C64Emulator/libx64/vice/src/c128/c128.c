@@ -467,6 +467,7 @@ void machine_resources_shutdown(void)
     video_resources_shutdown();
     c128_resources_shutdown();
     sound_resources_shutdown();
+    sid_resources_shutdown();
     rs232drv_resources_shutdown();
     printer_resources_shutdown();
     drive_resources_shutdown();
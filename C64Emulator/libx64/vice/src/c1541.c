@@ -47,6 +47,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #ifdef HAVE_ERRNO_H
 #include <errno.h>
@@ -59,6 +60,18 @@
 #include <strings.h>
 #endif
 
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+
 #include "archdep.h"
 #include "cbmdos.h"
 #include "cbmimage.h"
@@ -95,6 +108,11 @@
 #define C1541_VERSION_MAJOR     4
 #define C1541_VERSION_MINOR     0
 
+/* Batch jobs run in child processes, so every job gets its own drives.  */
+#if defined(HAVE_FORK) && defined(HAVE_SYS_WAIT_H)
+#define BATCH_FORK
+#endif
+
 const char machine_name[] = "C1541";
 
 /* Global clock counter.  */
@@ -109,6 +127,7 @@ static int interactive_mode = 0;
 
 /* Local functions.  */
 static int attach_cmd(int nargs, char **args);
+static int batch_cmd(int nargs, char **args);
 static int block_cmd(int nargs, char **args);
 static int check_drive(int dev, int mode);
 static int copy_cmd(int nargs, char **args);
@@ -222,6 +241,14 @@ const command_t command_list[] = {
       "Attach <diskimage> to <unit> (default unit is 8).",
       1, 2,
       attach_cmd },
+    { "batch",
+      "batch [<jobs> [<jobfile>]]",
+      "Run the jobs listed in <jobfile> (default is standard input), <jobs> of\n"
+      "them at a time (default is 1).  Each line of <jobfile> holds the\n"
+      "arguments of one c1541 command line: the disk images to attach followed\n"
+      "by `-<command>' options.  Every job starts with its own empty drives;\n"
+      "jobs running at the same time must not depend on each other.",
+      0, 2, batch_cmd },
     { "block",
       "block <track> <sector> <disp> [<drive>]",
       "Show specified disk block in hex form.",
@@ -753,6 +780,42 @@ static int check_drive(int dev, int flags)
     return FD_OK;
 }
 
+/* Attach the disk images at the start of a command line, up to the first
+   argument with a leading `-'.  Returns the index of that argument.  */
+static int attach_disk_images(int first, int argc, char **argv)
+{
+    int i;
+
+    for (i = first; i < argc && *argv[i] != '-'; i++) {
+        if (i - first > MAXDRIVE)
+            fprintf(stderr, "Ignoring disk image `%s'.\n", argv[i]);
+        else
+            open_disk_image(drives[i - first], argv[i], i - first + 8);
+    }
+    return i;
+}
+
+/* Execute the `-<command> <args>' options of a command line, starting at
+   `argv[i]'.  Stops at the first command that fails.  */
+static int execute_command_options(int i, int argc, char **argv)
+{
+    char *args[MAXARG];
+    int nargs;
+
+    while (i < argc) {
+        args[0] = argv[i] + 1;
+        nargs = 1;
+        i++;
+        for (; i < argc && *argv[i] != '-'; i++) {
+            args[nargs++] = argv[i];
+        }
+        if (lookup_and_execute_command(nargs, args) < 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 /* ------------------------------------------------------------------------- */
 
 /* Here are the commands.  */
@@ -786,6 +849,236 @@ static int attach_cmd(int nargs, char **args)
     return FD_OK;
 }
 
+static double batch_time(void)
+{
+#ifdef HAVE_GETTIMEOFDAY
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+#else
+    return (double)time(NULL);
+#endif
+}
+
+/* Run the command line of one batch job with fresh drives.  Returns 0 if
+   all of its commands succeeded.  */
+static int batch_run_job(const char *line)
+{
+    char *args[MAXARG];
+    vdrive_t *saved_drives[MAXDRIVE + 1];
+    int saved_drive_number;
+    int nargs, retval;
+    int i;
+
+    for (i = 0; i < MAXARG; i++)
+        args[i] = NULL;
+
+    for (i = 0; i <= MAXDRIVE; i++) {
+        saved_drives[i] = drives[i];
+        drives[i] = lib_calloc(1, sizeof(vdrive_t));
+    }
+    saved_drive_number = drive_number;
+    drive_number = 0;
+
+    if (split_args(line, &nargs, args) < 0) {
+        retval = 1;
+    } else {
+        i = attach_disk_images(0, nargs, args);
+        retval = execute_command_options(i, nargs, args);
+    }
+
+    for (i = 0; i <= MAXDRIVE; i++) {
+        close_disk_image(drives[i], i + 8);
+        lib_free(drives[i]);
+        drives[i] = saved_drives[i];
+    }
+    drive_number = saved_drive_number;
+
+    for (i = 0; i < MAXARG; i++)
+        lib_free(args[i]);
+
+    return retval;
+}
+
+static void batch_report(int number, const char *line, int failed,
+                         double seconds)
+{
+    printf("Job %d %s in %.3f s: %s\n",
+           number, failed ? "FAILED" : "done", seconds, line);
+    fflush(stdout);
+}
+
+#ifdef BATCH_FORK
+typedef struct batch_job_s {
+    pid_t pid;
+    int number;
+    char *line;
+    double start;
+} batch_job_t;
+
+/* Wait for one of the running jobs to finish and report it.  */
+static int batch_wait(batch_job_t *running, unsigned int *num_running,
+                      int *failed, double *busy)
+{
+    unsigned int i;
+    double seconds;
+    int status;
+    pid_t pid;
+
+    pid = wait(&status);
+    if (pid < 0)
+        return -1;
+
+    for (i = 0; i < *num_running; i++) {
+        if (running[i].pid == pid)
+            break;
+    }
+    if (i == *num_running)
+        return 0;
+
+    seconds = batch_time() - running[i].start;
+    *busy += seconds;
+    status = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    *failed += status;
+    batch_report(running[i].number, running[i].line, status, seconds);
+
+    lib_free(running[i].line);
+    running[i] = running[--(*num_running)];
+    return 0;
+}
+#endif
+
+static int batch_cmd(int nargs, char **args)
+{
+    FILE *f;
+    char line[1024];
+    int jobs = 1;
+    int number = 0, failed = 0;
+    double start, busy = 0.0;
+#ifdef BATCH_FORK
+    batch_job_t *running;
+    unsigned int num_running = 0;
+#endif
+
+    if (nargs >= 2) {
+        if (arg_to_int(args[1], &jobs) < 0 || jobs < 1)
+            return FD_BADVAL;
+    }
+
+    if (nargs < 3) {
+        f = stdin;
+    } else {
+        f = fopen(args[2], MODE_READ_TEXT);
+        if (f == NULL) {
+            fprintf(stderr, "Cannot read job file `%s'.\n", args[2]);
+            return FD_NOTRD;
+        }
+    }
+
+#ifdef BATCH_FORK
+    running = lib_malloc(jobs * sizeof(batch_job_t));
+#endif
+
+    start = batch_time();
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char *p;
+        size_t len;
+
+        /* A line that does not fit is rejected as a whole; running the
+           two parts as separate jobs would do something else.  */
+        len = strlen(line);
+        if (len == sizeof(line) - 1 && line[len - 1] != '\n') {
+            int c = getc(f);
+
+            if (c != EOF && c != '\n') {
+                while (c != EOF && c != '\n')
+                    c = getc(f);
+                number++;
+                fprintf(stderr, "Job %d: line longer than %d characters.\n",
+                        number, (int)sizeof(line) - 2);
+                batch_report(number, "(line too long)", 1, 0.0);
+                failed++;
+                continue;
+            }
+        }
+
+        for (p = line; *p == ' ' || *p == '\t'; p++);
+        len = strlen(p);
+        while (len > 0 && isspace((int)p[len - 1]))
+            p[--len] = 0;
+        if (*p == 0 || *p == '#')
+            continue;
+
+        number++;
+
+#ifdef BATCH_FORK
+        {
+            pid_t pid;
+
+            if (num_running == (unsigned int)jobs)
+                batch_wait(running, &num_running, &failed, &busy);
+
+            fflush(stdout);
+            fflush(stderr);
+
+            pid = fork();
+            if (pid == 0) {
+                int retval;
+
+                /* Keep the output of each job in one piece.  */
+                setvbuf(stdout, NULL, _IOFBF, BUFSIZ);
+                setvbuf(stderr, NULL, _IOFBF, BUFSIZ);
+                retval = batch_run_job(p);
+                fflush(stdout);
+                fflush(stderr);
+                _exit(retval);
+            }
+            if (pid < 0) {
+                perror("fork");
+                batch_report(number, p, 1, 0.0);
+                failed++;
+                continue;
+            }
+            running[num_running].pid = pid;
+            running[num_running].number = number;
+            running[num_running].line = lib_stralloc(p);
+            running[num_running].start = batch_time();
+            num_running++;
+        }
+#else
+        {
+            double seconds = batch_time();
+            int retval;
+
+            retval = batch_run_job(p);
+            seconds = batch_time() - seconds;
+            busy += seconds;
+            failed += retval;
+            batch_report(number, p, retval, seconds);
+        }
+#endif
+    }
+
+#ifdef BATCH_FORK
+    while (num_running > 0) {
+        if (batch_wait(running, &num_running, &failed, &busy) < 0)
+            break;
+    }
+    lib_free(running);
+#endif
+
+    if (f != stdin)
+        fclose(f);
+
+    printf("%d jobs, %d failed, %.3f s elapsed, %.3f s spent in jobs.\n",
+           number, failed, batch_time() - start, busy);
+
+    /* A failed job is reported above; just make c1541 exit with an error.  */
+    return failed ? FD_EXIT : FD_OK;
+}
+
 static int block_cmd(int nargs, char **args)
 {
     int drive, disp;
@@ -3022,12 +3315,7 @@ int main(int argc, char **argv)
 
     /* The first arguments without leading `-' are interpreted as disk images
        to attach.  */
-    for (i = 1; i < argc && *argv[i] != '-'; i++) {
-        if (i - 1 > MAXDRIVE)
-            fprintf(stderr, "Ignoring disk image `%s'.\n", argv[i]);
-        else
-            open_disk_image(drives[i - 1], argv[i], i - 1 + 8);
-    }
+    i = attach_disk_images(1, argc, argv);
 
     if (i == argc) {
         char *line;
@@ -3067,18 +3355,7 @@ int main(int argc, char **argv)
             }
         }
     } else {
-        while (i < argc) {
-            args[0] = argv[i] + 1;
-            nargs = 1;
-            i++;
-            for (; i < argc && *argv[i] != '-'; i++) {
-                args[nargs++] = argv[i];
-            }
-            if (lookup_and_execute_command(nargs, args) < 0) {
-                retval = 1;
-                break;
-            }
-        }
+        retval = execute_command_options(i, argc, argv);
     }
 
     for (i = 0; i <= MAXDRIVE; i++) {
@@ -409,6 +409,7 @@ void machine_resources_shutdown(void)
     plus256k_resources_shutdown();
     c64_256k_resources_shutdown();
     sound_resources_shutdown();
+    sid_resources_shutdown();
     rs232drv_resources_shutdown();
     printer_resources_shutdown();
     drive_resources_shutdown();
@@ -107,8 +107,15 @@ static read_func_ptr_t mem_read_tab[NUM_CONFIGS][0x101];
 static BYTE *mem_read_base_tab[NUM_CONFIGS][0x101];
 static int mem_read_limit_tab[NUM_CONFIGS][0x101];
 
+/* Plain RAM and ROM behind each page, for the CPU to load and store
+   directly (see `mem_ptr_tab_init()').  */
+static BYTE *mem_read_ptr_tab[NUM_CONFIGS][0x101];
+static BYTE *mem_write_ptr_tab[NUM_VBANKS][NUM_CONFIGS][0x101];
+static int mem_plain_zero_page;
+
 static store_func_ptr_t mem_write_tab_watch[0x101];
 static read_func_ptr_t mem_read_tab_watch[0x101];
+static BYTE *mem_ptr_tab_watch[0x101];
 
 /* Current video bank (0, 1, 2 or 3).  */
 static int vbank;
@@ -136,6 +143,23 @@ static void store_watch(WORD addr, BYTE value)
     mem_write_tab[vbank][mem_config][addr >> 8](addr, value);
 }
 
+/* Point the CPU to the direct access tables of the current configuration;
+   with watchpoints, every access has to go through the handlers.  */
+static void mem_update_ptr_tabs(void)
+{
+    if (watchpoints_active) {
+        _mem_read_ptr_tab_ptr = mem_ptr_tab_watch;
+        _mem_write_ptr_tab_ptr = mem_ptr_tab_watch;
+        _mem_read_zero_ptr = NULL;
+        _mem_write_zero_ptr = NULL;
+    } else {
+        _mem_read_ptr_tab_ptr = mem_read_ptr_tab[mem_config];
+        _mem_write_ptr_tab_ptr = mem_write_ptr_tab[vbank][mem_config];
+        _mem_read_zero_ptr = mem_plain_zero_page ? mem_ram : NULL;
+        _mem_write_zero_ptr = (mem_plain_zero_page && vbank != 0) ? mem_ram : NULL;
+    }
+}
+
 void mem_toggle_watchpoints(int flag, void *context)
 {
     if (flag) {
@@ -146,6 +170,7 @@ void mem_toggle_watchpoints(int flag, void *context)
         _mem_write_tab_ptr = mem_write_tab[vbank][mem_config];
     }
     watchpoints_active = flag;
+    mem_update_ptr_tabs();
 }
 
 /* ------------------------------------------------------------------------- */
@@ -204,6 +229,7 @@ void mem_pla_config_changed(void)
         _mem_read_tab_ptr = mem_read_tab[mem_config];
         _mem_write_tab_ptr = mem_write_tab[vbank][mem_config];
     }
+    mem_update_ptr_tabs();
 
     _mem_read_base_tab_ptr = mem_read_base_tab[mem_config];
     mem_read_limit_tab_ptr = mem_read_limit_tab[mem_config];
@@ -571,6 +597,51 @@ void mem_read_base_set(unsigned int base, unsigned int index, BYTE *mem_ptr)
     mem_read_base_tab[base][index] = mem_ptr;
 }
 
+/* Find the pages whose read and write handlers only access plain RAM or
+   ROM, so that the CPU can skip calling them.  This has to run after the
+   cartridges and RAM expansions have installed their handlers.  Stores to
+   the current VIC-II bank always go through the handlers, as the VIC-II
+   needs to see them.  The zero page is left out of the tables because of
+   the processor port; it has its own pointers for $02-$FF.  */
+static void mem_ptr_tab_init(void)
+{
+    int i, j, k;
+
+    for (i = 0; i < NUM_CONFIGS; i++) {
+        mem_read_ptr_tab[i][0] = NULL;
+        for (j = 1; j <= 0xff; j++) {
+            read_func_ptr_t read_func = mem_read_tab[i][j];
+            BYTE *p = NULL;
+
+            if (read_func == ram_read) {
+                p = mem_ram + (j << 8);
+            } else if (read_func == c64memrom_basic64_read) {
+                p = c64memrom_basic64_rom + ((j & 0x1f) << 8);
+            } else if (read_func == c64memrom_kernal64_read) {
+                p = c64memrom_kernal64_rom + ((j & 0x1f) << 8);
+            } else if (read_func == chargen_read) {
+                p = mem_chargen_rom + ((j & 0x0f) << 8);
+            }
+            mem_read_ptr_tab[i][j] = p;
+        }
+        mem_read_ptr_tab[i][0x100] = NULL;
+
+        for (k = 0; k < NUM_VBANKS; k++) {
+            mem_write_ptr_tab[k][i][0] = NULL;
+            for (j = 1; j <= 0xff; j++) {
+                if (mem_write_tab[k][i][j] == ram_store) {
+                    mem_write_ptr_tab[k][i][j] = mem_ram + (j << 8);
+                } else {
+                    mem_write_ptr_tab[k][i][j] = NULL;
+                }
+            }
+            mem_write_ptr_tab[k][i][0x100] = NULL;
+        }
+    }
+
+    mem_plain_zero_page = !c64_256k_enabled && !plus256k_enabled;
+}
+
 void mem_initialize_memory(void)
 {
     int i, j, k;
@@ -670,6 +741,9 @@ void mem_initialize_memory(void)
     plus60k_init_config();
     plus256k_init_config();
     c64_256k_init_config();
+
+    mem_ptr_tab_init();
+    mem_update_ptr_tabs();
 }
 
 /* ------------------------------------------------------------------------- */
@@ -693,6 +767,7 @@ void mem_set_vbank(int new_vbank)
     if (_mem_write_tab_ptr != mem_write_tab_watch) {
         _mem_write_tab_ptr = mem_write_tab[new_vbank][mem_config];
     }
+    mem_update_ptr_tabs();
 
     vicii_set_vbank(new_vbank);
 }
@@ -118,9 +118,14 @@ static sound_chip_t digimax_sound_chip = {
 
 static WORD digimax_sound_chip_offset = 0;
 
+/* gain in percent and balance in the mix */
+static int digimax_gain;
+static int digimax_pan;
+
 void digimax_sound_chip_init(void)
 {
     digimax_sound_chip_offset = sound_chip_register(&digimax_sound_chip);
+    sound_chip_set_mix(digimax_sound_chip_offset, digimax_gain, digimax_pan);
 }
 
 /* ---------------------------------------------------------------------*/
@@ -266,6 +271,32 @@ static int set_digimax_base(int val, void *param)
 	return 0;
 }
 
+/* The resources are set before the chip is registered, which then takes
+   them over.  */
+static int set_digimax_gain(int val, void *param)
+{
+    if (val < 0 || val > 200) {
+        return -1;
+    }
+    digimax_gain = val;
+    if (digimax_sound_chip_offset) {
+        sound_chip_set_mix(digimax_sound_chip_offset, digimax_gain, digimax_pan);
+    }
+    return 0;
+}
+
+static int set_digimax_pan(int val, void *param)
+{
+    if (val < -100 || val > 100) {
+        return -1;
+    }
+    digimax_pan = val;
+    if (digimax_sound_chip_offset) {
+        sound_chip_set_mix(digimax_sound_chip_offset, digimax_gain, digimax_pan);
+    }
+    return 0;
+}
+
 void digimax_reset(void)
 {
 }
@@ -287,6 +318,10 @@ static const resource_int_t resources_int[] = {
     &digimax_sound_chip.chip_enabled, set_digimax_enabled, NULL },
   { "DIGIMAXbase", 0xffff, RES_EVENT_NO, NULL,
     &digimax_address, set_digimax_base, NULL },
+  { "DIGIMAXGain", 100, RES_EVENT_NO, NULL,
+    &digimax_gain, set_digimax_gain, NULL },
+  { "DIGIMAXPan", 0, RES_EVENT_NO, NULL,
+    &digimax_pan, set_digimax_pan, NULL },
   { NULL }
 };
 
@@ -318,6 +353,16 @@ static const cmdline_option_t cmdline_options[] =
       USE_PARAM_ID, USE_DESCRIPTION_ID,
       IDCLS_P_BASE_ADDRESS, IDCLS_DIGIMAX_BASE,
       NULL, NULL },
+    { "-digimaxgain", SET_RESOURCE, 1,
+      NULL, NULL, "DIGIMAXGain", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<percent>"), T_("Set the volume of the DigiMAX in the mix (0-200)") },
+    { "-digimaxpan", SET_RESOURCE, 1,
+      NULL, NULL, "DIGIMAXPan", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<balance>"), T_("Set the balance of the DigiMAX (-100 left to 100 right)") },
     { NULL }
 };
 
@@ -59,6 +59,7 @@
 #include "translate.h"
 #include "types.h"
 #include "util.h"
+#include "vicii.h"
 
 #define CARTRIDGE_INCLUDE_PRIVATE_API
 #include "reu.h"
@@ -1089,6 +1090,120 @@ inline static BYTE read_from_reu(unsigned int reu_addr)
 
 /* ------------------------------------------------------------------------- */
 
+/*! \brief find out how many bytes of a DMA operation can be done at once
+
+  \param host_addr
+    The host (computer) address of the next byte
+
+  \param reu_addr
+    The REU address of the next byte
+
+  \param host_step
+    The increment to use for the host address; must be either 0 or 1
+
+  \param reu_step
+    The increment to use for the REU address; must be either 0 or 1
+
+  \param len
+    The remaining transfer length of the operation
+
+  \param cycles
+    The number of cycles the operation takes per byte
+
+  \param host_read
+    If not NULL, set to the host memory the bytes are read from
+
+  \param host_write
+    If not NULL, set to the host memory the bytes are written to
+
+  \param reu_ptr
+    Set to the REU memory of the bytes
+
+  \return
+    The number of bytes that can be moved with plain memory accesses; 0 if
+    the next byte has to be transferred on its own.
+
+  \remark
+    A span only covers host memory that is accessed directly by the CPU
+    as well (see mem.h), REU addresses backed up by DRAM without wrap
+    around, and cycles in which no VIC-II event is due.  As the pending
+    alarms are served only for the VIC-II, its fetches and stolen cycles
+    happen exactly as if the bytes were moved one by one.  The x64sc CPU
+    steals cycles for every byte, so nothing is batched there.
+*/
+static int reu_dma_bulk_length(WORD host_addr, unsigned int reu_addr, int host_step, int reu_step, int len, int cycles,
+                               BYTE **host_read, BYTE **host_write, BYTE **reu_ptr)
+{
+    CLOCK next_clk;
+    unsigned int dram_addr;
+    unsigned int page = host_addr >> 8;
+    int n = len;
+
+    if (reu_ba.enabled) {
+        return 0;
+    }
+
+    next_clk = vicii_pending_alarms_clk();
+    if (next_clk <= maincpu_clk + cycles) {
+        return 0;
+    }
+    if ((CLOCK)(next_clk - maincpu_clk - 1) / cycles < (CLOCK)n) {
+        n = (int)((next_clk - maincpu_clk - 1) / cycles);
+    }
+
+    if (host_read != NULL) {
+        if (_mem_read_ptr_tab_ptr[page] == NULL) {
+            return 0;
+        }
+        *host_read = _mem_read_ptr_tab_ptr[page] + (host_addr & 0xff);
+    }
+    if (host_write != NULL) {
+        if (_mem_write_ptr_tab_ptr[page] == NULL) {
+            return 0;
+        }
+        *host_write = _mem_write_ptr_tab_ptr[page] + (host_addr & 0xff);
+    }
+    if (host_step && n > 0x100 - (host_addr & 0xff)) {
+        n = 0x100 - (host_addr & 0xff);
+    }
+
+    dram_addr = reu_addr & (rec_options.dram_wrap_around - 1);
+    if (dram_addr >= rec_options.not_backedup_addresses) {
+        return 0;
+    }
+    if (reu_step) {
+        unsigned int offset = reu_addr & 0x0007ffff;
+
+        if (offset >= rec_options.wrap_around) {
+            return 0;
+        }
+        if ((unsigned int)n > rec_options.wrap_around - 1 - offset) {
+            n = rec_options.wrap_around - 1 - offset;
+        }
+        if ((unsigned int)n > rec_options.not_backedup_addresses - dram_addr) {
+            n = rec_options.not_backedup_addresses - dram_addr;
+        }
+    }
+    assert(dram_addr < reu_size);
+    *reu_ptr = reu_ram + dram_addr;
+
+    return n;
+}
+
+/*! \brief copy a span found by reu_dma_bulk_length() */
+static void reu_dma_bulk_copy(BYTE *dst, int dst_step, const BYTE *src, int src_step, int n)
+{
+    if (dst_step) {
+        if (src_step) {
+            memcpy(dst, src, n);
+        } else {
+            memset(dst, *src, n);
+        }
+    } else {
+        *dst = src[src_step ? n - 1 : 0];
+    }
+}
+
 /*! \brief update the REU registers after a DMA operation
 
   \param host_addr
@@ -1179,6 +1294,8 @@ static void reu_dma_update_regs(WORD host_addr, unsigned int reu_addr, int len,
 static void reu_dma_host_to_reu(WORD host_addr, unsigned int reu_addr, int host_step, int reu_step, int len)
 {
     BYTE value;
+    BYTE *host_ptr, *reu_ptr;
+    int n;
     DEBUG_LOG(DEBUG_LEVEL_TRANSFER_HIGH_LEVEL, (reu_log, "copy ext $%05X %s<= main $%04X%s, $%04X (%d) bytes.",
               reu_addr, reu_step ? "" : "(fixed) ", host_addr, host_step ? "" : " (fixed)", len, len));
 
@@ -1187,6 +1304,16 @@ static void reu_dma_host_to_reu(WORD host_addr, unsigned int reu_addr, int host_
     assert(len >= 1);
 
     while (len) {
+        n = reu_dma_bulk_length(host_addr, reu_addr, host_step, reu_step, len, 1, &host_ptr, NULL, &reu_ptr);
+        if (n > 0) {
+            reu_dma_bulk_copy(reu_ptr, reu_step, host_ptr, host_step, n);
+            maincpu_clk += n;
+            host_addr = (host_addr + host_step * n) & 0xffff;
+            reu_addr += reu_step * n;
+            len -= n;
+            continue;
+        }
+
         reu_clk_inc_pre();
         machine_handle_pending_alarms(0);
         value = mem_read(host_addr);
@@ -1222,6 +1349,8 @@ static void reu_dma_host_to_reu(WORD host_addr, unsigned int reu_addr, int host_
 static void reu_dma_reu_to_host(WORD host_addr, unsigned int reu_addr, int host_step, int reu_step, int len)
 {
     BYTE value;
+    BYTE *host_ptr, *reu_ptr;
+    int n;
     DEBUG_LOG(DEBUG_LEVEL_TRANSFER_HIGH_LEVEL, (reu_log, "copy ext $%05X %s=> main $%04X%s, $%04X (%d) bytes.",
               reu_addr, reu_step ? "" : "(fixed) ", host_addr, host_step ? "" : " (fixed)", len, len));
 
@@ -1230,6 +1359,16 @@ static void reu_dma_reu_to_host(WORD host_addr, unsigned int reu_addr, int host_
     assert(len >= 1);
 
     while (len) {
+        n = reu_dma_bulk_length(host_addr, reu_addr, host_step, reu_step, len, 1, NULL, &host_ptr, &reu_ptr);
+        if (n > 0) {
+            reu_dma_bulk_copy(host_ptr, host_step, reu_ptr, reu_step, n);
+            maincpu_clk += n;
+            host_addr = (host_addr + host_step * n) & 0xffff;
+            reu_addr += reu_step * n;
+            len -= n;
+            continue;
+        }
+
         DEBUG_LOG(DEBUG_LEVEL_TRANSFER_LOW_LEVEL, (reu_log, "Transferring byte: %x from ext $%05X to main $%04X.", reu_ram[reu_addr % reu_size], reu_addr, host_addr));
         reu_clk_inc_pre();
         value = read_from_reu(reu_addr);
@@ -1265,6 +1404,8 @@ static void reu_dma_swap(WORD host_addr, unsigned int reu_addr, int host_step, i
 {
     BYTE value_from_reu;
     BYTE value_from_c64;
+    BYTE *host_read, *host_write, *reu_ptr;
+    int i, n;
     DEBUG_LOG(DEBUG_LEVEL_TRANSFER_HIGH_LEVEL, (reu_log, "swap ext $%05X %s<=> main $%04X%s, $%04X (%d) bytes.",
               reu_addr, reu_step ? "" : "(fixed) ", host_addr, host_step ? "" : " (fixed)", len, len));
 
@@ -1273,6 +1414,20 @@ static void reu_dma_swap(WORD host_addr, unsigned int reu_addr, int host_step, i
     assert(len >= 1);
 
     while (len) {
+        n = reu_dma_bulk_length(host_addr, reu_addr, host_step, reu_step, len, 2, &host_read, &host_write, &reu_ptr);
+        if (n > 0) {
+            for (i = 0; i < n; i++) {
+                value_from_reu = reu_ptr[i * reu_step];
+                reu_ptr[i * reu_step] = host_read[i * host_step];
+                host_write[i * host_step] = value_from_reu;
+            }
+            maincpu_clk += 2 * n;
+            host_addr = (host_addr + host_step * n) & 0xffff;
+            reu_addr += reu_step * n;
+            len -= n;
+            continue;
+        }
+
         value_from_reu = read_from_reu(reu_addr);
         reu_clk_inc_pre();
         machine_handle_pending_alarms(0);
@@ -1314,6 +1469,9 @@ static void reu_dma_compare(WORD host_addr, unsigned int reu_addr, int host_step
     BYTE value_from_reu;
     BYTE value_from_c64;
 
+    BYTE *host_ptr, *reu_ptr;
+    int i, n;
+
     BYTE new_status_or_mask = 0;
 
     DEBUG_LOG(DEBUG_LEVEL_TRANSFER_HIGH_LEVEL, (reu_log, "compare ext $%05X %s<=> main $%04X%s, $%04X (%d) bytes.",
@@ -1329,6 +1487,19 @@ static void reu_dma_compare(WORD host_addr, unsigned int reu_addr, int host_step
     /* rec.status &= ~ (REU_REG_R_STATUS_VERIFY_ERROR | REU_REG_R_STATUS_END_OF_BLOCK); */
 
     while (len) {
+        /* Bytes that compare equal are skipped at once; the first one that
+           differs is handled below.  */
+        n = reu_dma_bulk_length(host_addr, reu_addr, host_step, reu_step, len, 1, &host_ptr, NULL, &reu_ptr);
+        for (i = 0; i < n && reu_ptr[i * reu_step] == host_ptr[i * host_step]; i++) {
+        }
+        if (i > 0) {
+            maincpu_clk += i;
+            host_addr = (host_addr + host_step * i) & 0xffff;
+            reu_addr += reu_step * i;
+            len -= i;
+            continue;
+        }
+
         reu_clk_inc_pre();
         machine_handle_pending_alarms(0);
         value_from_reu = read_from_reu(reu_addr);
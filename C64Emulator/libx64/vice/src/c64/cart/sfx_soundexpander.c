@@ -136,9 +136,14 @@ static sound_chip_t sfx_soundexpander_sound_chip = {
 
 static WORD sfx_soundexpander_sound_chip_offset = 0;
 
+/* gain in percent and balance in the mix */
+static int sfx_soundexpander_gain;
+static int sfx_soundexpander_pan;
+
 void sfx_soundexpander_sound_chip_init(void)
 {
     sfx_soundexpander_sound_chip_offset = sound_chip_register(&sfx_soundexpander_sound_chip);
+    sound_chip_set_mix(sfx_soundexpander_sound_chip_offset, sfx_soundexpander_gain, sfx_soundexpander_pan);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -222,6 +227,32 @@ static int set_sfx_soundexpander_io_swap(int val, void *param)
     return 0;
 }
 
+/* The resources are set before the chip is registered, which then takes
+   them over.  */
+static int set_sfx_soundexpander_gain(int val, void *param)
+{
+    if (val < 0 || val > 200) {
+        return -1;
+    }
+    sfx_soundexpander_gain = val;
+    if (sfx_soundexpander_sound_chip_offset) {
+        sound_chip_set_mix(sfx_soundexpander_sound_chip_offset, sfx_soundexpander_gain, sfx_soundexpander_pan);
+    }
+    return 0;
+}
+
+static int set_sfx_soundexpander_pan(int val, void *param)
+{
+    if (val < -100 || val > 100) {
+        return -1;
+    }
+    sfx_soundexpander_pan = val;
+    if (sfx_soundexpander_sound_chip_offset) {
+        sound_chip_set_mix(sfx_soundexpander_sound_chip_offset, sfx_soundexpander_gain, sfx_soundexpander_pan);
+    }
+    return 0;
+}
+
 void sfx_soundexpander_reset(void)
 {
     /* TODO: do nothing ? */
@@ -244,6 +275,10 @@ static const resource_int_t resources_int[] = {
       &sfx_soundexpander_sound_chip.chip_enabled, set_sfx_soundexpander_enabled, NULL },
     { "SFXSoundExpanderChip", 0, RES_EVENT_STRICT, (resource_value_t)3526,
       &sfx_soundexpander_chip, set_sfx_soundexpander_chip, NULL },
+    { "SFXSoundExpanderGain", 100, RES_EVENT_NO, NULL,
+      &sfx_soundexpander_gain, set_sfx_soundexpander_gain, NULL },
+    { "SFXSoundExpanderPan", 0, RES_EVENT_NO, NULL,
+      &sfx_soundexpander_pan, set_sfx_soundexpander_pan, NULL },
     { NULL }
 };
 
@@ -286,6 +321,16 @@ static const cmdline_option_t cmdline_options[] =
       USE_PARAM_ID, USE_DESCRIPTION_ID,
       IDCLS_P_TYPE, IDCLS_SET_YM_CHIP_TYPE,
       NULL, NULL },
+    { "-sfxsegain", SET_RESOURCE, 1,
+      NULL, NULL, "SFXSoundExpanderGain", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<percent>"), T_("Set the volume of the SFX Sound Expander in the mix (0-200)") },
+    { "-sfxsepan", SET_RESOURCE, 1,
+      NULL, NULL, "SFXSoundExpanderPan", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<balance>"), T_("Set the balance of the SFX Sound Expander (-100 left to 100 right)") },
     { NULL }
 };
 
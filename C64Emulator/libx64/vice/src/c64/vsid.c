@@ -310,6 +310,7 @@ void machine_resources_shutdown(void)
     video_resources_shutdown();
     c64_resources_shutdown();
     sound_resources_shutdown();
+    sid_resources_shutdown();
 }
 
 /* C64-specific command-line option initialization.  */
@@ -243,6 +243,7 @@ void machine_resources_shutdown(void)
     c64dtv_resources_shutdown();
     c64dtvmem_resources_shutdown();
     sound_resources_shutdown();
+    sid_resources_shutdown();
     rs232drv_resources_shutdown();
     printer_resources_shutdown();
     drive_resources_shutdown();
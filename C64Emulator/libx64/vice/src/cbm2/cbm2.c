@@ -144,6 +144,7 @@ void machine_resources_shutdown(void)
     video_resources_shutdown();
     cbm2_resources_shutdown();
     sound_resources_shutdown();
+    sid_resources_shutdown();
     rs232drv_resources_shutdown();
     printer_resources_shutdown();
     drive_resources_shutdown();
@@ -204,6 +204,9 @@
 /* Have FFMPEG swscale lib available */
 /* #undef HAVE_FFMPEG_SWSCALE */
 
+/* Define to 1 if you have the `fmemopen' function. */
+#define HAVE_FMEMOPEN 1
+
 /* Define to 1 if you have the `fork' function. */
 #define HAVE_FORK 1
 
@@ -354,6 +357,9 @@
 /* Define to 1 if you have the `mkstemp' function. */
 #define HAVE_MKSTEMP 1
 
+/* Define to 1 if you have the `mmap' function. */
+#define HAVE_MMAP 1
+
 /* Define to 1 if you have the `mmap_device_io' function. */
 /* #undef HAVE_MMAP_DEVICE_IO */
 
@@ -402,6 +408,9 @@
 /* Define to 1 if you have the <proto/cybergraphics.h> header file. */
 /* #undef HAVE_PROTO_CYBERGRAPHICS_H */
 
+/* Define to 1 if you have the <pthread.h> header file. */
+#define HAVE_PTHREAD_H 1
+
 /* Define to 1 if you have the <proto/openpci.h> header file. */
 /* #undef HAVE_PROTO_OPENPCI_H */
 
@@ -551,7 +560,7 @@
 /* #undef HAVE_SYS_JOYSTICK_H */
 
 /* Define to 1 if you have the <sys/mman.h> header file. */
-/* #undef HAVE_SYS_MMAN_H */
+#define HAVE_SYS_MMAN_H 1
 
 /* Define to 1 if you have the <sys/ndir.h> header file, and it defines `DIR'.
    */
@@ -575,6 +584,9 @@
 /* Define to 1 if you have the <sys/types.h> header file. */
 #define HAVE_SYS_TYPES_H 1
 
+/* Define to 1 if you have <sys/wait.h> that is POSIX.1 compatible. */
+#define HAVE_SYS_WAIT_H 1
+
 /* Support for The Final Ethernet */
 /* #undef HAVE_TFE */
 
@@ -596,6 +608,9 @@
 /* Define to 1 if you have the `usleep' function. */
 /* #undef HAVE_USLEEP */
 
+/* Define to 1 if you have the <utime.h> header file. */
+#define HAVE_UTIME_H 1
+
 /* Define to 1 if the system has the type `u_short'. */
 #define HAVE_U_SHORT 1
 
@@ -778,6 +793,9 @@
 /* Use embedded data files. */
 /* #undef USE_EMBEDDED */
 
+/* Use computed goto opcode dispatch in the 6510 core. */
+/* #undef USE_COMPUTED_GOTO */
+
 /* Define when using gcc */
 #define USE_GCC /**/
 
@@ -881,3 +899,16 @@
 
 /* Define as `fork' if `vfork' does not work. */
 /* #undef vfork */
+
+/* Headless Linux build of x64 (arch/unix/headless, `x64-bench'): none of
+   the Cocoa Touch, AudioQueue or Mac joystick support is available, but
+   zlib is (the Makefile links -lz).  */
+#ifdef HEADLESS_COMPILE
+#undef HAS_JOYSTICK
+#undef MACOSX_BUNDLE
+#undef MACOSX_COCOA
+#undef MACOSX_SUPPORT
+#undef MAC_JOYSTICK
+#undef USE_AUDIOQUEUE
+#define HAVE_ZLIB /**/
+#endif
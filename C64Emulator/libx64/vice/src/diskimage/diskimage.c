@@ -515,6 +515,8 @@ void disk_image_init(void)
 
 int disk_image_resources_init(void)
 {
+    if (fsimage_resources_init() < 0)
+        return -1;
 #ifdef HAVE_RAWDRIVE
     if (rawimage_resources_init() < 0)
         return -1;
@@ -522,6 +524,11 @@ int disk_image_resources_init(void)
     return 0;
 }
 
+void disk_image_vsync_hook(void)
+{
+    fsimage_vsync_hook();
+}
+
 void disk_image_resources_shutdown(void)
 {
 #ifdef HAVE_RAWDRIVE
@@ -531,6 +538,8 @@ void disk_image_resources_shutdown(void)
 
 int disk_image_cmdline_options_init(void)
 {
+    if (fsimage_cmdline_options_init() < 0)
+        return -1;
 #ifdef HAVE_RAWDRIVE
     if (rawimage_cmdline_options_init() < 0)
         return -1;
@@ -28,9 +28,17 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#include <time.h>
+#define FSIMAGE_MMAP
+#endif
 
 #include "archdep.h"
 #include "cbmdos.h"
+#include "cmdline.h"
 #include "diskconstants.h"
 #include "diskimage.h"
 #include "fsimage-gcr.h"
@@ -38,13 +46,59 @@
 #include "fsimage.h"
 #include "lib.h"
 #include "log.h"
+#include "resources.h"
+#include "translate.h"
 #include "types.h"
+#include "util.h"
 #include "x64.h"
 #include "zfile.h"
 
 
 static log_t fsimage_log = LOG_DEFAULT;
 
+static int fsimage_sync_mode = FSIMAGE_SYNC_WRITE;
+
+#ifdef FSIMAGE_MMAP
+/* The images that are mapped into memory.  */
+static fsimage_t *fsimage_map_list = NULL;
+#endif
+
+/*-----------------------------------------------------------------------*/
+
+static int set_fsimage_sync_mode(int val, void *param)
+{
+    if (val < FSIMAGE_SYNC_WRITE || val > FSIMAGE_SYNC_DETACH)
+        return -1;
+
+    fsimage_sync_mode = val;
+    return 0;
+}
+
+static const resource_int_t resources_int[] = {
+    { "DiskImageSync", FSIMAGE_SYNC_WRITE, RES_EVENT_NO, NULL,
+      &fsimage_sync_mode, set_fsimage_sync_mode, NULL },
+    { NULL }
+};
+
+int fsimage_resources_init(void)
+{
+    return resources_register_int(resources_int);
+}
+
+static const cmdline_option_t cmdline_options[] = {
+    { "-diskimagesync", SET_RESOURCE, 1,
+      NULL, NULL, "DiskImageSync", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<mode>"), T_("When to write changes of disk images back to the file: (0: after every write, 1: once per second, 2: on detach)") },
+    { NULL }
+};
+
+int fsimage_cmdline_options_init(void)
+{
+    return cmdline_register_options(cmdline_options);
+}
+
 
 void fsimage_name_set(disk_image_t *image, char *name)
 {
@@ -111,6 +165,167 @@ void fsimage_media_destroy(disk_image_t *image)
 
 /*-----------------------------------------------------------------------*/
 
+/* Sector based images are mapped into memory, so that accessing a sector
+   is a plain copy.  Compressed images are not, as their uncompressed copy
+   only gets written back when it is closed.  */
+
+#ifdef FSIMAGE_MMAP
+static void fsimage_map(disk_image_t *image)
+{
+    fsimage_t *fsimage;
+    size_t length;
+    void *map;
+
+    fsimage = image->media.fsimage;
+
+    switch (image->type) {
+      case DISK_IMAGE_TYPE_D64:
+      case DISK_IMAGE_TYPE_D67:
+      case DISK_IMAGE_TYPE_D71:
+      case DISK_IMAGE_TYPE_D81:
+      case DISK_IMAGE_TYPE_D80:
+      case DISK_IMAGE_TYPE_D82:
+      case DISK_IMAGE_TYPE_X64:
+      case DISK_IMAGE_TYPE_D1M:
+      case DISK_IMAGE_TYPE_D2M:
+      case DISK_IMAGE_TYPE_D4M:
+        break;
+      default:
+        return;
+    }
+
+    if (zfile_is_compressed(fsimage->fd))
+        return;
+
+    fflush(fsimage->fd);
+    length = util_file_length(fsimage->fd);
+    if (length == 0)
+        return;
+
+    map = mmap(NULL, length,
+               image->read_only ? PROT_READ : PROT_READ | PROT_WRITE,
+               MAP_SHARED, fileno(fsimage->fd), 0);
+    if (map == MAP_FAILED)
+        return;
+
+    fsimage->map = (BYTE *)map;
+    fsimage->map_size = length;
+    fsimage->map_dirty = 0;
+    fsimage->map_pending = 0;
+    fsimage->map_sync_time = (unsigned long)time(NULL);
+
+    fsimage->map_next = fsimage_map_list;
+    fsimage_map_list = fsimage;
+}
+
+static void fsimage_unmap(fsimage_t *fsimage)
+{
+    fsimage_t **p;
+
+    if (fsimage->map == NULL)
+        return;
+
+    for (p = &fsimage_map_list; *p != NULL; p = &(*p)->map_next) {
+        if (*p == fsimage) {
+            *p = fsimage->map_next;
+            break;
+        }
+    }
+
+    if (fsimage->map_dirty)
+        msync(fsimage->map, fsimage->map_size, MS_SYNC);
+
+    munmap(fsimage->map, fsimage->map_size);
+    fsimage->map = NULL;
+}
+
+/* With periodic syncing, the writes are only noted here;
+   `fsimage_vsync_hook()' syncs them.  */
+static void fsimage_map_written(fsimage_t *fsimage)
+{
+    fsimage->map_dirty = 1;
+
+    switch (fsimage_sync_mode) {
+      case FSIMAGE_SYNC_WRITE:
+        msync(fsimage->map, fsimage->map_size, MS_ASYNC);
+        break;
+      case FSIMAGE_SYNC_PERIODIC:
+        fsimage->map_pending = 1;
+        break;
+      default:
+        break;
+    }
+}
+#endif
+
+/* Called once per frame: sync the mapped images that have been written
+   to, at most once per second each.  */
+void fsimage_vsync_hook(void)
+{
+#ifdef FSIMAGE_MMAP
+    fsimage_t *fsimage;
+    unsigned long now = 0;
+
+    if (fsimage_sync_mode == FSIMAGE_SYNC_DETACH)
+        return;
+
+    for (fsimage = fsimage_map_list; fsimage != NULL;
+         fsimage = fsimage->map_next) {
+        if (!fsimage->map_pending)
+            continue;
+
+        if (now == 0)
+            now = (unsigned long)time(NULL);
+
+        if (now != fsimage->map_sync_time) {
+            msync(fsimage->map, fsimage->map_size, MS_ASYNC);
+            fsimage->map_pending = 0;
+            fsimage->map_sync_time = now;
+        }
+    }
+#endif
+}
+
+static int fsimage_read_data(fsimage_t *fsimage, long offset, BYTE *buf)
+{
+#ifdef FSIMAGE_MMAP
+    if (fsimage->map != NULL && offset + 256 <= (long)fsimage->map_size) {
+        memcpy(buf, fsimage->map + offset, 256);
+        return 0;
+    }
+#endif
+
+    fseek(fsimage->fd, offset, SEEK_SET);
+
+    if (fread((char *)buf, 256, 1, fsimage->fd) < 1)
+        return -1;
+
+    return 0;
+}
+
+static int fsimage_write_data(fsimage_t *fsimage, long offset, BYTE *buf)
+{
+#ifdef FSIMAGE_MMAP
+    if (fsimage->map != NULL && offset + 256 <= (long)fsimage->map_size) {
+        memcpy(fsimage->map + offset, buf, 256);
+        fsimage_map_written(fsimage);
+        return 0;
+    }
+#endif
+
+    fseek(fsimage->fd, offset, SEEK_SET);
+
+    if (fwrite((char *)buf, 256, 1, fsimage->fd) < 1)
+        return -1;
+
+    /* Make sure the stream is visible to other readers.  */
+    fflush(fsimage->fd);
+
+    return 0;
+}
+
+/*-----------------------------------------------------------------------*/
+
 int fsimage_open(disk_image_t *image)
 {
     fsimage_t *fsimage;
@@ -135,6 +350,9 @@ int fsimage_open(disk_image_t *image)
     }
 
     if (fsimage_probe(image) == 0) {
+#ifdef FSIMAGE_MMAP
+        fsimage_map(image);
+#endif
         return 0;
     }
 
@@ -154,6 +372,10 @@ int fsimage_close(disk_image_t *image)
         return -1;
     }
 
+#ifdef FSIMAGE_MMAP
+    fsimage_unmap(fsimage);
+#endif
+
     zfile_fclose(fsimage->fd);
 
     fsimage_error_info_destroy(fsimage);
@@ -201,9 +423,7 @@ int fsimage_read_sector(disk_image_t *image, BYTE *buf, unsigned int track,
         if (image->type == DISK_IMAGE_TYPE_X64)
             offset += X64_HEADER_LENGTH;
 
-        fseek(fsimage->fd, offset, SEEK_SET);
-
-        if (fread((char *)buf, 256, 1, fsimage->fd) < 1) {
+        if (fsimage_read_data(fsimage, offset, buf) < 0) {
             log_error(fsimage_log,
                       "Error reading T:%i S:%i from disk image.",
                       track, sector);
@@ -297,16 +517,11 @@ int fsimage_write_sector(disk_image_t *image, BYTE *buf, unsigned int track,
         if (image->type == DISK_IMAGE_TYPE_X64)
             offset += X64_HEADER_LENGTH;
 
-        fseek(fsimage->fd, offset, SEEK_SET);
-
-        if (fwrite((char *)buf, 256, 1, fsimage->fd) < 1) {
+        if (fsimage_write_data(fsimage, offset, buf) < 0) {
             log_error(fsimage_log, "Error writing T:%i S:%i to disk image.",
                       track, sector);
             return -1;
         }
-
-        /* Make sure the stream is visible to other readers.  */
-        fflush(fsimage->fd);
         break;
       case DISK_IMAGE_TYPE_G64:
         if (fsimage_gcr_write_sector(image, buf, track, sector) < 0)
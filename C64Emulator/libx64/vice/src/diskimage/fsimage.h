@@ -37,10 +37,29 @@ typedef struct fsimage_s {
     FILE *fd;
     char *name;
     BYTE *error_info;
+
+    /* The image file mapped into memory, or NULL if sectors are accessed
+       with `fd'.  */
+    BYTE *map;
+    size_t map_size;
+    int map_dirty;
+
+    /* Written since the last periodic sync.  */
+    int map_pending;
+    unsigned long map_sync_time;
+
+    /* Next mapped image.  */
+    struct fsimage_s *map_next;
 } fsimage_t;
 
+/* When writes to a mapped image are flushed to the file.  */
+#define FSIMAGE_SYNC_WRITE    0     /* after every sector write */
+#define FSIMAGE_SYNC_PERIODIC 1     /* at most once per second */
+#define FSIMAGE_SYNC_DETACH   2     /* when the image is detached */
 
 extern void fsimage_init(void);
+extern int fsimage_resources_init(void);
+extern int fsimage_cmdline_options_init(void);
 
 extern void fsimage_error_info_create(fsimage_t *fsimage);
 extern void fsimage_error_info_destroy(fsimage_t *fsimage);
@@ -57,6 +76,7 @@ extern int fsimage_read_sector(struct disk_image_s *image, BYTE *buf,
                                unsigned int track, unsigned int sector);
 extern int fsimage_write_sector(struct disk_image_s *image, BYTE *buf,
                                 unsigned int track, unsigned int sector);
+extern void fsimage_vsync_hook(void);
 
 #endif
 
@@ -57,6 +57,16 @@ static const cmdline_option_t cmdline_options[] = {
       USE_PARAM_STRING, USE_DESCRIPTION_ID,
       IDCLS_UNUSED, IDCLS_DISABLE_DRIVE_SOUND,
       NULL, NULL },
+    { "-drivesoundgain", SET_RESOURCE, 1,
+      NULL, NULL, "DriveSoundGain", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<percent>"), T_("Set the volume of the drive sound in the mix (0-200)") },
+    { "-drivesoundpan", SET_RESOURCE, 1,
+      NULL, NULL, "DriveSoundPan", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<balance>"), T_("Set the balance of the drive sound (-100 left to 100 right)") },
     { NULL }
 };
 
@@ -30,6 +30,7 @@
 
 #include "drive-check.h"
 #include "drive-resources.h"
+#include "drive-sound.h"
 #include "drive.h"
 #include "drivecpu.h"
 #include "driverom.h"
@@ -50,6 +51,10 @@ static int drive_true_emulation;
 /* Is drive sound emulation switched on?  */
 int drive_sound_emulation;
 
+/* Gain in percent and balance of the drive sound in the mix.  */
+int drive_sound_gain;
+int drive_sound_pan;
+
 static int set_drive_true_emulation(int val, void *param)
 {
     unsigned int dnr;
@@ -88,6 +93,26 @@ static int set_drive_sound_emulation(int val, void *param)
     return 0;
 }
 
+static int set_drive_sound_gain(int val, void *param)
+{
+    if (val < 0 || val > 200) {
+        return -1;
+    }
+    drive_sound_gain = val;
+    drive_sound_set_mix();
+    return 0;
+}
+
+static int set_drive_sound_pan(int val, void *param)
+{
+    if (val < -100 || val > 100) {
+        return -1;
+    }
+    drive_sound_pan = val;
+    drive_sound_set_mix();
+    return 0;
+}
+
 static int set_drive_extend_image_policy(int val, void *param)
 {
     switch (val) {
@@ -257,6 +282,10 @@ static const resource_int_t resources_int[] = {
       &drive_true_emulation, set_drive_true_emulation, NULL },
     { "DriveSoundEmulation", 0, RES_EVENT_NO, (resource_value_t)0,
       &drive_sound_emulation, set_drive_sound_emulation, NULL },
+    { "DriveSoundGain", 100, RES_EVENT_NO, NULL,
+      &drive_sound_gain, set_drive_sound_gain, NULL },
+    { "DriveSoundPan", 0, RES_EVENT_NO, NULL,
+      &drive_sound_pan, set_drive_sound_pan, NULL },
     { NULL }
 };
 
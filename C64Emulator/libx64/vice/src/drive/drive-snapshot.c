@@ -36,6 +36,7 @@
 #include "drive-snapshot.h"
 #include "drive.h"
 #include "drivecpu.h"
+#include "driveimage.h"
 #include "drivemem.h"
 #include "driverom.h"
 #include "drivetypes.h"
@@ -372,6 +373,7 @@ int drive_snapshot_read_module(snapshot_t *s)
 
     for (i = 0; i < 2; i++) {
         drive = drive_context[i]->drive;
+        drive_image_load_track(drive, drive->current_half_track / 2);
         drive->GCR_track_start_ptr = (drive->gcr->data
                                      + ((drive->current_half_track / 2 - 1)
                                      * NUM_MAX_BYTES_TRACK));
@@ -717,6 +719,8 @@ static int drive_snapshot_write_gcrimage_module(snapshot_t *s, unsigned int dnr)
     drive = drive_context[dnr]->drive;
     sprintf(snap_module_name, "GCRIMAGE%i", dnr);
 
+    drive_image_load_all_tracks(drive);
+
     m = snapshot_module_create(s, snap_module_name, GCRIMAGE_SNAP_MAJOR,
                                GCRIMAGE_SNAP_MINOR);
     if (m == NULL)
@@ -1426,6 +1426,8 @@ const static signed char *motor[DRIVE_NUM];
 static int cycles_per_sec = 1000000;
 static int sample_rate = 22050;
 extern int drive_sound_emulation;
+extern int drive_sound_gain;
+extern int drive_sound_pan;
 
 static int drive_sound_machine_calculate_samples(sound_t **psid, SWORD *pbuf, int nr, int soc, int scc, int *delta_t)
 {
@@ -1583,4 +1585,13 @@ void drive_sound_init(void)
         stepvol[i] = 0;
     }
     drive_sound_offset = sound_chip_register(&drive_sound);
+    drive_sound_set_mix();
+}
+
+void drive_sound_set_mix(void)
+{
+    /* the resources are set before the chip is registered */
+    if (drive_sound_offset) {
+        sound_chip_set_mix(drive_sound_offset, drive_sound_gain, drive_sound_pan);
+    }
 }
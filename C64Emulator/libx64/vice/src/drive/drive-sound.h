@@ -35,5 +35,8 @@ void drive_sound_head(int track, int step, int unit);
 
 void drive_sound_init(void);
 
+/* Apply the DriveSoundGain and DriveSoundPan resources.  */
+void drive_sound_set_mix(void);
+
 #endif
 
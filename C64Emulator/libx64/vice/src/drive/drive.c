@@ -465,6 +465,7 @@ void drive_set_half_track(int num, drive_t *dptr)
         num = 2;
 
     dptr->current_half_track = num;
+    drive_image_load_track(dptr, num / 2);
     dptr->GCR_track_start_ptr = (dptr->gcr->data
                                 + ((dptr->current_half_track / 2 - 1)
                                 * NUM_MAX_BYTES_TRACK));
@@ -755,6 +756,7 @@ void drive_vsync_hook(void)
     unsigned int dnr;
 
     drive_update_ui_status();
+    disk_image_vsync_hook();
 
     for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
         drive_t *drive;
@@ -29,6 +29,7 @@
 #ifndef VICE_DRIVE_H
 #define VICE_DRIVE_H
 
+#include "gcr.h"
 #include "types.h"
 #include "rtc/ds1216e.h"
 
@@ -143,6 +144,10 @@ typedef struct drive_s {
     /* Flag: does the current track need to be written out to disk?  */
     int GCR_dirty_track;
 
+    /* Flags: has the GCR data of each track been built from the (D64/D71)
+       image yet?  Tracks are converted when the head first reaches them.  */
+    BYTE GCR_track_loaded[MAX_GCR_TRACKS];
+
     /* GCR value being written to the disk.  */
     BYTE GCR_write_value;
 
@@ -487,6 +487,8 @@ void drivecpu_execute(drive_context_t *drv, CLOCK clk_value)
 #define drivecpu_byte_ready() (rotation_rotate_disk(drv->drive), \
                                drv->drive->byte_ready_edge)
 
+#define CPU_LOOP_CONTINUE() ((int) (CLK - cpu->stop_clk) < 0)
+
 #define cpu_reset() (cpu_reset)(drv)
 #define bank_limit (cpu->d_bank_limit)
 #define bank_base (cpu->d_bank_base)
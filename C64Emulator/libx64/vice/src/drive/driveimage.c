@@ -89,16 +89,91 @@ static void drive_image_init_track_size_d71(drive_t *drive)
     }
 }
 
-static void drive_image_read_d64_d71(drive_t *drive)
+/* Build the GCR data of track `track' from the sectors of the image.  */
+static void drive_image_read_track(drive_t *drive, unsigned int track)
 {
-    BYTE buffer[260], chksum;
+    BYTE buffer[260], chksum, *ptr;
     int i;
-    unsigned int track, sector;
+    unsigned int sector, max_sector;
 
-    if (!(drive->image))
+    buffer[258] = buffer[259] = 0;
+
+    ptr = drive->gcr->data + GCR_OFFSET(track);
+    max_sector = disk_image_sector_per_track(drive->image->type, track);
+    /* Clear track to avoid read errors.  */
+    memset(ptr, 0x55, NUM_MAX_BYTES_TRACK);
+
+    for (sector = 0; sector < max_sector; sector++) {
+        int rc;
+        ptr = drive->gcr->data + sector_offset(track, sector,
+                                               max_sector, drive);
+
+        rc = disk_image_read_sector(drive->image, buffer + 1, track,
+                                    sector);
+        if (rc < 0) {
+            log_error(drive->log,
+                      "Cannot read T:%d S:%d from disk image.",
+                      track, sector);
+                      continue;
+        }
+
+        if (rc == 21) {
+            ptr = drive->gcr->data + GCR_OFFSET(track);
+            memset(ptr, 0x00, NUM_MAX_BYTES_TRACK);
+            break;
+        }
+
+        buffer[0] = (rc == 22) ? 0xff : 0x07;
+
+        chksum = buffer[1];
+        for (i = 2; i < 257; i++)
+            chksum ^= buffer[i];
+        buffer[257] = (rc == 23) ? chksum ^ 0xff : chksum;
+        gcr_convert_sector_to_GCR(buffer, ptr, track, sector,
+                                  drive->diskID1, drive->diskID2,
+                                  (BYTE)(rc));
+    }
+}
+
+/* Make sure the GCR data of track `track' has been built from a D64/D71
+   image.  Called whenever the head moves onto a track.  */
+void drive_image_load_track(drive_t *drive, unsigned int track)
+{
+    if (drive->image == NULL
+        || track < 1 || track > MAX_GCR_TRACKS
+        || drive->GCR_track_loaded[track - 1])
         return;
 
-    buffer[258] = buffer[259] = 0;
+    switch (drive->image->type) {
+      case DISK_IMAGE_TYPE_D64:
+      case DISK_IMAGE_TYPE_D67:
+      case DISK_IMAGE_TYPE_D71:
+      case DISK_IMAGE_TYPE_X64:
+        break;
+      default:
+        return;
+    }
+
+    drive->GCR_track_loaded[track - 1] = 1;
+    drive_image_read_track(drive, track);
+}
+
+/* Build the GCR data of all tracks not converted yet, for code that needs
+   the complete GCR image (snapshots).  */
+void drive_image_load_all_tracks(drive_t *drive)
+{
+    unsigned int track;
+
+    for (track = 1; track <= MAX_GCR_TRACKS; track++)
+        drive_image_load_track(drive, track);
+}
+
+static void drive_image_read_d64_d71(drive_t *drive)
+{
+    unsigned int track;
+
+    if (!(drive->image))
+        return;
 
     /* Since the D64/D71 format does not provide the actual track sizes or
        speed zones, we set them to standard values.  */
@@ -119,49 +194,12 @@ static void drive_image_read_d64_d71(drive_t *drive)
         drive_image_init_track_size_d71(drive);
     }
 
-    drive_set_half_track(drive->current_half_track, drive);
+    /* The tracks of the image are converted to GCR when the head first
+       reaches them; the GCR data of any other track is left alone.  */
+    for (track = 1; track <= MAX_GCR_TRACKS; track++)
+        drive->GCR_track_loaded[track - 1] = (track > drive->image->tracks);
 
-    for (track = 1; track <= drive->image->tracks; track++) {
-        BYTE *ptr;
-        unsigned int max_sector = 0;
-
-        ptr = drive->gcr->data + GCR_OFFSET(track);
-        max_sector = disk_image_sector_per_track(drive->image->type,
-                                                 track);
-        /* Clear track to avoid read errors.  */
-        memset(ptr, 0x55, NUM_MAX_BYTES_TRACK);
-
-        for (sector = 0; sector < max_sector; sector++) {
-            int rc;
-            ptr = drive->gcr->data + sector_offset(track, sector,
-                                                   max_sector, drive);
-
-            rc = disk_image_read_sector(drive->image, buffer + 1, track,
-                                        sector);
-            if (rc < 0) {
-                log_error(drive->log,
-                          "Cannot read T:%d S:%d from disk image.",
-                          track, sector);
-                          continue;
-            }
-
-            if (rc == 21) {
-                ptr = drive->gcr->data + GCR_OFFSET(track);
-                memset(ptr, 0x00, NUM_MAX_BYTES_TRACK);
-                break;
-            }
-
-            buffer[0] = (rc == 22) ? 0xff : 0x07;
-
-            chksum = buffer[1];
-            for (i = 2; i < 257; i++)
-                chksum ^= buffer[i];
-            buffer[257] = (rc == 23) ? chksum ^ 0xff : chksum;
-            gcr_convert_sector_to_GCR(buffer, ptr, track, sector,
-                                      drive->diskID1, drive->diskID2,
-                                      (BYTE)(rc));
-        }
-    }
+    drive_set_half_track(drive->current_half_track, drive);
 }
 
 static int setID(unsigned int dnr)
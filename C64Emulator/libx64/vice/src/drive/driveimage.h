@@ -32,6 +32,8 @@ struct drive_s;
 
 extern void drive_image_init(void);
 extern void drive_image_init_track_size_d64(struct drive_s *drive);
+extern void drive_image_load_track(struct drive_s *drive, unsigned int track);
+extern void drive_image_load_all_tracks(struct drive_s *drive);
 
 extern int drive_image_attach(struct disk_image_s *image, unsigned int unit);
 extern int drive_image_detach(struct disk_image_s *image, unsigned int unit);
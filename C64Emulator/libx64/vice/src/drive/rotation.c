@@ -181,6 +181,74 @@ inline static SDWORD RANDOM_nextInt(rotation_t *rptr) {
     return (SDWORD) rptr->seed;
 }
 
+/* Move the next 8 bits under the R/W head at once.  This is only done
+   when the result is the same as reading them one by one: the bits are in
+   the track, they contain neither a sync mark nor a run of 4 zero bits
+   (so no GCR=0 handling is needed) and the last 1-bit was recent enough
+   for no random flux event to be possible.  Return 0 if the bits have to
+   be read one at a time.  */
+inline static int read_next_byte(drive_t *dptr, rotation_t *rptr)
+{
+    int off = dptr->GCR_head_offset;
+    int shift = off & 7;
+    const BYTE *p;
+    DWORD data, window, zeros, ones;
+    int bits_to_ready;
+
+    if (dptr->GCR_image_loaded == 0 || rptr->zero_count > 5) {
+        return 0;
+    }
+
+    if (off + 8 > (dptr->GCR_current_track_size << 3)) {
+        return 0;
+    }
+
+    p = dptr->GCR_track_start_ptr + (off >> 3);
+    if (shift == 0) {
+        data = p[0];
+    } else {
+        data = (((DWORD)p[0] << 8 | p[1]) >> (8 - shift)) & 0xff;
+    }
+
+    /* The last 10 bits read followed by the new ones.  Check every window
+       that ends in a new bit.  */
+    window = (rptr->last_read_data << 8) | data;
+    zeros = ~window;
+    zeros &= zeros >> 1;
+    zeros &= zeros >> 2;
+    ones = window & (window >> 1);
+    ones &= ones >> 2;
+    ones &= (ones >> 4) & (window >> 8) & (window >> 9);
+    if (((zeros | ones) & 0xff) != 0) {
+        return 0;
+    }
+
+    off += 8;
+    if (off >= (dptr->GCR_current_track_size << 3)) {
+        off = 0;
+    }
+    dptr->GCR_head_offset = off;
+
+    rptr->last_read_data = window & 0x3ff;
+
+    /* There is a 1-bit in the data, or there would be 4 zeros in a row.  */
+    rptr->zero_count = 1;
+    while ((data & (1 << (rptr->zero_count - 1))) == 0) {
+        rptr->zero_count++;
+    }
+
+    /* Exactly one byte boundary is crossed.  */
+    bits_to_ready = 8 - rptr->bit_counter;
+    dptr->GCR_read = (BYTE)(window >> (8 - bits_to_ready));
+    rptr->last_write_data = (BYTE)(dptr->GCR_read << (8 - bits_to_ready));
+    if ((dptr->byte_ready_active & 2) != 0) {
+        dptr->byte_ready_edge = 1;
+        dptr->byte_ready_level = 1;
+    }
+
+    return 1;
+}
+
 void rotation_begins(drive_t *dptr) {
     unsigned int dnr = dptr->mynumber;
     rotation[dnr].rotation_last_clk = *(dptr->clk);
@@ -217,6 +285,11 @@ void rotation_rotate_disk(drive_t *dptr)
 
     if (dptr->read_write_mode) {
         while (bits_moved -- != 0) {
+            if (bits_moved >= 7 && read_next_byte(dptr, rptr)) {
+                bits_moved -= 7;
+                continue;
+            }
+
             /* GCR=0 support.
              * 
              * In the absence of 1-bits (magnetic flux changes), the drive
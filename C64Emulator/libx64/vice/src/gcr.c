@@ -59,47 +59,80 @@ static const BYTE From_GCR_conv_data[32] =
       0,  9, 10, 11,  0, 13, 14,  0 };
 
 
-static void gcr_convert_4bytes_to_GCR(BYTE *source, BYTE *dest)
+/* GCR code of each byte value (two 5 bit codes, high nybble first) and the
+   byte value of each 10 bit GCR code.  Invalid codes decode as 0, like
+   `From_GCR_conv_data'.  */
+static WORD GCR_conv_byte[256];
+static BYTE From_GCR_conv_byte[1024];
+static int gcr_tables_initialized = 0;
+
+static void gcr_init_tables(void)
 {
-    int i;
-    register unsigned int tdest = 0;    /* at least 16 bits for overflow shifting */
-
-    for (i = 2; i < 10; i += 2, source++, dest++)
-    {
-        tdest <<= 5;  /* make room for the upper nybble */
-        tdest  |= GCR_conv_data[(*source) >> 4];
+    unsigned int i;
 
-        tdest <<= 5;  /* make room for the lower nybble */
-        tdest  |= GCR_conv_data[(*source) & 0x0f];
+    for (i = 0; i < 256; i++)
+        GCR_conv_byte[i] = (WORD)((GCR_conv_data[i >> 4] << 5)
+                                  | GCR_conv_data[i & 0x0f]);
 
-        *dest   = (BYTE)(tdest >> i);
-    }
+    for (i = 0; i < 1024; i++)
+        From_GCR_conv_byte[i] = (BYTE)((From_GCR_conv_data[i >> 5] << 4)
+                                       | From_GCR_conv_data[i & 0x1f]);
 
-    *dest   = (BYTE)tdest;
+    gcr_tables_initialized = 1;
 }
 
-static void gcr_convert_GCR_to_4bytes(BYTE *source, BYTE *dest)
+/* Convert `groups' groups of 4 bytes at `source' into 5 GCR bytes each at
+   `dest'.  The four 10 bit codes of a group are packed into 32 bits plus
+   one byte, so that every group is a handful of table lookups.  */
+static void gcr_convert_bytes_to_GCR(const BYTE *source, BYTE *dest,
+                                     unsigned int groups)
 {
-    int i;
-        /* at least 24 bits for shifting into bits 16...20 */
-    register DWORD tdest = *source;
+    DWORD gcr;
+    WORD last;
+
+    if (!gcr_tables_initialized)
+        gcr_init_tables();
+
+    for (; groups > 0; groups--, source += 4, dest += 5) {
+        last = GCR_conv_byte[source[3]];
+        gcr = ((DWORD)GCR_conv_byte[source[0]] << 22)
+              | ((DWORD)GCR_conv_byte[source[1]] << 12)
+              | ((DWORD)GCR_conv_byte[source[2]] << 2)
+              | (DWORD)(last >> 8);
+
+        dest[0] = (BYTE)(gcr >> 24);
+        dest[1] = (BYTE)(gcr >> 16);
+        dest[2] = (BYTE)(gcr >> 8);
+        dest[3] = (BYTE)gcr;
+        dest[4] = (BYTE)last;
+    }
+}
 
-    tdest <<= 13;
+/* Convert `groups' groups of 5 GCR bytes at `source' into 4 bytes each at
+   `dest'.  The GCR data is taken `shift' bits (0-7) into `source', so the
+   byte following the last group must be readable if `shift' is not 0.  */
+static void gcr_convert_GCR_to_bytes(const BYTE *source, BYTE *dest,
+                                     unsigned int groups, int shift)
+{
+    DWORD gcr;
+    unsigned int last;
 
-    for (i = 5; i < 13; i += 2, dest++)
-    {
-        source++;
-        tdest  |= ((DWORD)(*source)) << i;
+    if (!gcr_tables_initialized)
+        gcr_init_tables();
 
-            /*  "tdest >> 16" could be optimized to a word
-             *  aligned access, hopefully the compiler does
-             *  this for us (in a portable way)
-             */
-        *dest   = From_GCR_conv_data[ (tdest >> 16) & 0x1f ] << 4;
-        tdest <<= 5;
+    for (; groups > 0; groups--, source += 5, dest += 4) {
+        gcr = ((DWORD)source[0] << 24) | ((DWORD)source[1] << 16)
+              | ((DWORD)source[2] << 8) | (DWORD)source[3];
+        last = source[4];
+        if (shift) {
+            gcr = (gcr << shift) | (last >> (8 - shift));
+            last = ((last << shift) | (source[5] >> (8 - shift))) & 0xff;
+        }
 
-        *dest  |= From_GCR_conv_data[ (tdest >> 16) & 0x1f ];
-        tdest <<= 5;
+        dest[0] = From_GCR_conv_byte[gcr >> 22];
+        dest[1] = From_GCR_conv_byte[(gcr >> 12) & 0x3ff];
+        dest[2] = From_GCR_conv_byte[(gcr >> 2) & 0x3ff];
+        dest[3] = From_GCR_conv_byte[((gcr & 3) << 8) | last];
     }
 }
 
@@ -107,8 +140,7 @@ void gcr_convert_sector_to_GCR(BYTE *buffer, BYTE *ptr, unsigned int track,
                                unsigned int sector, BYTE diskID1, BYTE diskID2,
                                BYTE error_code)
 {
-    int i;
-    BYTE buf[4], header_id1;
+    BYTE buf[8], header_id1;
 
     header_id1 = (error_code == 29) ? diskID1 ^ 0xff : diskID1;
 
@@ -123,69 +155,52 @@ void gcr_convert_sector_to_GCR(BYTE *buffer, BYTE *ptr, unsigned int track,
     if (error_code == 27)
         buf[1] ^= 0xff;
 
-    gcr_convert_4bytes_to_GCR(buf, ptr);
-    ptr += 5;
-
-    buf[0] = diskID2;
-    buf[1] = header_id1;
-    buf[2] = buf[3] = 0x0f;
-    gcr_convert_4bytes_to_GCR(buf, ptr);
-    ptr += 5;
+    buf[4] = diskID2;
+    buf[5] = header_id1;
+    buf[6] = buf[7] = 0x0f;
+    gcr_convert_bytes_to_GCR(buf, ptr, 2);
+    ptr += 10;
 
     ptr += 9;
 
     memset(ptr, 0xff, 5);       /* Sync */
     ptr += 5;
 
-    for (i = 0; i < 65; i++) {
-        gcr_convert_4bytes_to_GCR(buffer, ptr);
-        buffer += 4;
-        ptr += 5;
-    }
+    gcr_convert_bytes_to_GCR(buffer, ptr, 65);
 }
 
 void gcr_convert_GCR_to_sector(BYTE *buffer, BYTE *ptr,
                                BYTE *GCR_track_start_ptr,
                                unsigned int GCR_current_track_size)
 {
-    BYTE *offset = ptr;
     BYTE *GCR_track_end = GCR_track_start_ptr + GCR_current_track_size;
-    BYTE GCR_header[6];
-    int i, j, s, shift;
+    BYTE GCR_data[65 * 5 + 1];
+    const BYTE *source = ptr;
+    int shift;
+    unsigned int i, len;
 
     /* additional 1 bits are part of the previous sync and must
        be shifted out. so check/count these here */
     shift = 0;
-    i = *(offset);
+    i = *ptr;
     while (i & 0x80) {
         i <<= 1;
         shift++;
     }
 
-    for (i = 0; i < 65; i++) {
-        /* get 5 bytes of gcr data */
-        for (j = 0; j < 5; j++) {
-            GCR_header[j] = *(offset++);
-            if (offset >= GCR_track_end) {
-                offset = GCR_track_start_ptr;
-            }
-        }
-        /* if the gcr data is not aligned, shift accordingly */
-        if (shift) {
-            GCR_header[5] = *(offset);
-            for (s = 0; s < shift; s++) {
-                for (j = 0; j < 5; j++) {
-                    GCR_header[j] <<= 1;
-                    if (GCR_header[j + 1] & 0x80) {
-                        GCR_header[j] |= 1;
-                    }
-                }
-                GCR_header[5] <<= 1;
-            }
+    /* Decode straight from the track unless the sector wraps around its
+       end; then copy it out first.  */
+    len = 65 * 5 + (shift ? 1 : 0);
+    if (ptr + len > GCR_track_end) {
+        for (i = 0; i < len; i++) {
+            GCR_data[i] = *(ptr++);
+            if (ptr >= GCR_track_end)
+                ptr = GCR_track_start_ptr;
         }
-        gcr_convert_GCR_to_4bytes(GCR_header, buffer);
-        buffer += 4;
+        source = GCR_data;
     }
+
+    gcr_convert_GCR_to_bytes(source, buffer, 65, shift);
 }
 
 BYTE *gcr_find_sector_header(unsigned int track, unsigned int sector,
@@ -229,18 +244,10 @@ BYTE *gcr_find_sector_header(unsigned int track, unsigned int sector,
         GCR_header[5] = *(offset);
         /* shift out additional 1 bits, which are part of the sync */
         shift = 0;
-        while (GCR_header[0] & 0x80) {
-            for (i = 0; i < 5; i++) {
-                GCR_header[i] <<= 1;
-                if (GCR_header[i + 1] & 0x80) {
-                    GCR_header[i] |= 1;
-                }
-            }
-            GCR_header[5] <<= 1;
+        while (shift < 8 && (GCR_header[0] << shift) & 0x80)
             shift++;
-        }
 
-        gcr_convert_GCR_to_4bytes(GCR_header, header_data);
+        gcr_convert_GCR_to_bytes(GCR_header, header_data, 1, shift);
         if (header_data[0] == 0x08) {
             /* FIXME: Add some sanity checks here.  */
             if (header_data[2] == sector && header_data[3] == track) {
@@ -309,7 +316,7 @@ int gcr_write_sector(BYTE *gcr_track_start_ptr,
                      unsigned int gcr_current_track_size, BYTE *writedata,
                      unsigned int track, unsigned int sector)
 {
-    BYTE buffer[260], gcr_buffer[325], *offset, *buf, *gcr_data;
+    BYTE buffer[260], gcr_buffer[325], *offset;
     BYTE chksum;
     int i;
 
@@ -330,14 +337,7 @@ int gcr_write_sector(BYTE *gcr_track_start_ptr,
     buffer[257] = chksum;
     buffer[258] = buffer[259] = 0;
 
-    buf = buffer;
-    gcr_data = gcr_buffer;
-
-    for (i = 0; i < 65; i++) {
-        gcr_convert_4bytes_to_GCR(buf, gcr_data);
-        buf += 4;
-        gcr_data += 5;
-    }
+    gcr_convert_bytes_to_GCR(buffer, gcr_buffer, 65);
 
     for (i = 0; i < 325; i++) {
         *offset = gcr_buffer[i];
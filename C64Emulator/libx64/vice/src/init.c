@@ -63,6 +63,7 @@
 #include "uiapi.h"
 #include "vdrive.h"
 #include "vice-event.h"
+#include "zfile.h"
 
 extern int c64scene_fake_vsid;
 
@@ -115,6 +116,10 @@ int init_resources(void)
         init_resource_fail("disk image");
         return -1;
     }
+    if (zfile_resources_init() < 0) {
+        init_resource_fail("compressed file");
+        return -1;
+    }
     if (event_resources_init() < 0) {
         init_resource_fail("event");
         return -1;
@@ -197,6 +202,10 @@ int init_cmdline_options(void)
             init_cmdline_options_fail("disk image");
             return -1;
         }
+        if (zfile_cmdline_options_init() < 0) {
+            init_cmdline_options_fail("compressed file");
+            return -1;
+        }
         if (event_cmdline_options_init() < 0) {
             init_cmdline_options_fail("event");
             return -1;
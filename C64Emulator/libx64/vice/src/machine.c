@@ -260,6 +260,7 @@ void machine_shutdown(void)
     disk_image_resources_shutdown();
     machine_resources_shutdown();
     sysfile_resources_shutdown();
+    zfile_resources_shutdown();
     zfile_shutdown();
     ui_resources_shutdown();
     log_resources_shutdown();
@@ -325,6 +325,14 @@ alarm_context_t *maincpu_alarm_context = NULL;
 clk_guard_t *maincpu_clk_guard = NULL;
 monitor_interface_t *maincpu_monitor_interface = NULL;
 
+/* Plain memory accessed directly, see mem.h.  The x64sc CPU always goes
+   through the handlers.  */
+static BYTE *mem_ptr_tab_none[0x101];
+BYTE **_mem_read_ptr_tab_ptr = mem_ptr_tab_none;
+BYTE **_mem_write_ptr_tab_ptr = mem_ptr_tab_none;
+BYTE *_mem_read_zero_ptr = NULL;
+BYTE *_mem_write_zero_ptr = NULL;
+
 /* This flag is an obsolete optimization. It's always 0 for the x64sc CPU,
    but has to be kept for the common code. */
 int maincpu_rmw_flag = 0;
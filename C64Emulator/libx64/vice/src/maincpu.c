@@ -79,6 +79,47 @@
 
 /* ------------------------------------------------------------------------- */
 
+#ifndef FEATURE_CPUMEMHISTORY
+
+/* Loads and stores go directly to plain RAM and ROM when the memory
+   tables allow it (see mem.h).  */
+#ifndef STORE_ZERO
+#define STORE_ZERO(addr, value)                                        \
+    ((((addr) & 0xff) >= 2 && _mem_write_zero_ptr != NULL)             \
+     ? (void)(_mem_write_zero_ptr[(addr) & 0xff] = (BYTE)(value))      \
+     : (*_mem_write_tab_ptr[0])((WORD)(addr), (BYTE)(value)))
+#endif
+
+#ifndef LOAD_ZERO
+#define LOAD_ZERO(addr)                                                \
+    ((((addr) & 0xff) >= 2 && _mem_read_zero_ptr != NULL)              \
+     ? _mem_read_zero_ptr[(addr) & 0xff]                               \
+     : (*_mem_read_tab_ptr[0])((WORD)(addr)))
+#endif
+
+#define MEM_DIRECT_STORE(addr, value)                                  \
+    ((_mem_write_ptr_tab_ptr[(addr) >> 8] != NULL)                     \
+     ? (void)(_mem_write_ptr_tab_ptr[(addr) >> 8][(addr) & 0xff]       \
+              = (BYTE)(value))                                         \
+     : (*_mem_write_tab_ptr[(addr) >> 8])((WORD)(addr), (BYTE)(value)))
+
+#define MEM_DIRECT_LOAD(addr)                                          \
+    ((_mem_read_ptr_tab_ptr[(addr) >> 8] != NULL)                      \
+     ? _mem_read_ptr_tab_ptr[(addr) >> 8][(addr) & 0xff]               \
+     : (*_mem_read_tab_ptr[(addr) >> 8])((WORD)(addr)))
+
+#endif /* !FEATURE_CPUMEMHISTORY */
+
+#ifndef MEM_DIRECT_STORE
+#define MEM_DIRECT_STORE(addr, value) \
+    (*_mem_write_tab_ptr[(addr) >> 8])((WORD)(addr), (BYTE)(value))
+#endif
+
+#ifndef MEM_DIRECT_LOAD
+#define MEM_DIRECT_LOAD(addr) \
+    (*_mem_read_tab_ptr[(addr) >> 8])((WORD)(addr))
+#endif
+
 #ifndef STORE_ZERO
 #define STORE_ZERO(addr, value) \
     (*_mem_write_tab_ptr[0])((WORD)(addr), (BYTE)(value))
@@ -145,12 +186,12 @@ BYTE memmap_mem_read(unsigned int addr)
 
 #ifndef STORE
 #define STORE(addr, value) \
-    (*_mem_write_tab_ptr[(addr) >> 8])((WORD)(addr), (BYTE)(value))
+    MEM_DIRECT_STORE(addr, value)
 #endif
 
 #ifndef LOAD
 #define LOAD(addr) \
-    (*_mem_read_tab_ptr[(addr) >> 8])((WORD)(addr))
+    MEM_DIRECT_LOAD(addr)
 #endif
 
 #define LOAD_ADDR(addr) \
@@ -223,6 +264,14 @@ alarm_context_t *maincpu_alarm_context = NULL;
 clk_guard_t *maincpu_clk_guard = NULL;
 monitor_interface_t *maincpu_monitor_interface = NULL;
 
+/* Plain memory accessed directly, see mem.h.  Machines whose memory code
+   does not set these up always go through the handlers.  */
+static BYTE *mem_ptr_tab_none[0x101];
+BYTE **_mem_read_ptr_tab_ptr = mem_ptr_tab_none;
+BYTE **_mem_write_ptr_tab_ptr = mem_ptr_tab_none;
+BYTE *_mem_read_zero_ptr = NULL;
+BYTE *_mem_write_zero_ptr = NULL;
+
 /* Global clock counter.  */
 CLOCK maincpu_clk = 0L;
 
@@ -418,6 +467,250 @@ inline static int interrupt_check_irq_delay(interrupt_cpu_status_t *cs,
 
 /* ------------------------------------------------------------------------- */
 
+/* Idle loop fast-forward.
+
+   Many programs wait for an interrupt in loops like `JMP *' or
+   `LDA $nnnn / BEQ *-3' that only read RAM or ROM.  Such a loop spins
+   until an interrupt handler or DMA changes memory, which can only happen
+   after the next alarm.  If one pass through the loop leaves the CPU in
+   the state it started in, the passes that end before the next alarm are
+   skipped in one step.  Reads from I/O are never skipped, as I/O
+   registers can change with the clock or have side effects.  Nothing is
+   skipped while the monitor checks the CPU either: the loop reads memory
+   directly, past the tables that report watchpoint hits, and breakpoints
+   and single steps are checked per instruction.  */
+
+#if !defined C64DTV && !defined CPU_8502 && !defined CYCLE_EXACT_ALARM
+
+/* Opcodes an idle loop can start with.  */
+static const BYTE idle_loop_head_tab[0x100] = {
+            /* 0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F */
+    /* $00 */  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* $00 */
+    /* $10 */  1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* $10 */
+    /* $20 */  0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, /* $20 */
+    /* $30 */  1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* $30 */
+    /* $40 */  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, /* $40 */
+    /* $50 */  1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* $50 */
+    /* $60 */  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* $60 */
+    /* $70 */  1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* $70 */
+    /* $80 */  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* $80 */
+    /* $90 */  1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* $90 */
+    /* $A0 */  1, 0, 1, 0, 1, 1, 1, 0, 0, 1, 0, 0, 1, 1, 1, 0, /* $A0 */
+    /* $B0 */  1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* $B0 */
+    /* $C0 */  1, 0, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, /* $C0 */
+    /* $D0 */  1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* $D0 */
+    /* $E0 */  1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, /* $E0 */
+    /* $F0 */  1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0  /* $F0 */
+            /* 0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F */
+};
+
+/* Read `addr' for an idle loop.  Only memory the CPU could also fetch
+   opcodes from directly is allowed (see `mem_read_limit()'); the zero page
+   counts as part of the stack page, except for the processor port.  */
+static int idle_loop_read(unsigned int addr, BYTE *value)
+{
+    BYTE *p;
+
+    if (addr < 2
+        || (int)addr >= mem_read_limit_tab_ptr[(addr >> 8) ? (addr >> 8) : 1]) {
+        return 0;
+    }
+
+    p = _mem_read_base_tab_ptr[addr >> 8];
+    if (p == NULL) {
+        return 0;
+    }
+
+    *value = p[addr & 0xff];
+    return 1;
+}
+
+/* Run the loop starting at `pc' once without side effects, starting from
+   the given registers.  Return the number of cycles to skip, or 0 if the
+   code at `pc' is not an idle loop in this state.  */
+static CLOCK idle_loop_skip(unsigned int pc, BYTE *bank_base, int bank_limit,
+                            BYTE reg_a, BYTE reg_x, BYTE reg_y, BYTE reg_p,
+                            BYTE flag_n, BYTE flag_z)
+{
+    unsigned int head = pc;
+    unsigned int cycles = 0;
+    unsigned int tmp;
+    BYTE a = reg_a, x = reg_x, y = reg_y;
+    BYTE sign = flag_n & 0x80, zero = !flag_z, p = reg_p;
+    BYTE value;
+    CLOCK next_clk;
+    int taken;
+
+    while ((int)pc < bank_limit) {
+        BYTE *op = bank_base + pc;
+
+        switch (op[0]) {
+          case 0xea:            /* NOP */
+            cycles += 2;
+            pc += 1;
+            continue;
+          case 0xa9:            /* LDA #$nn */
+          case 0xa2:            /* LDX #$nn */
+          case 0xa0:            /* LDY #$nn */
+          case 0xc9:            /* CMP #$nn */
+          case 0xe0:            /* CPX #$nn */
+          case 0xc0:            /* CPY #$nn */
+          case 0x29:            /* AND #$nn */
+            value = op[1];
+            cycles += 2;
+            pc += 2;
+            break;
+          case 0xa5:            /* LDA $nn */
+          case 0xa6:            /* LDX $nn */
+          case 0xa4:            /* LDY $nn */
+          case 0xc5:            /* CMP $nn */
+          case 0xe4:            /* CPX $nn */
+          case 0xc4:            /* CPY $nn */
+          case 0x24:            /* BIT $nn */
+            if (!idle_loop_read(op[1], &value)) {
+                return 0;
+            }
+            cycles += 3;
+            pc += 2;
+            break;
+          case 0xad:            /* LDA $nnnn */
+          case 0xae:            /* LDX $nnnn */
+          case 0xac:            /* LDY $nnnn */
+          case 0xcd:            /* CMP $nnnn */
+          case 0xec:            /* CPX $nnnn */
+          case 0xcc:            /* CPY $nnnn */
+          case 0x2c:            /* BIT $nnnn */
+            if (!idle_loop_read(op[1] | (op[2] << 8), &value)) {
+                return 0;
+            }
+            cycles += 4;
+            pc += 3;
+            break;
+          case 0x4c:            /* JMP $nnnn */
+            if ((unsigned int)(op[1] | (op[2] << 8)) != head) {
+                return 0;
+            }
+            cycles += 3;
+            goto loop_closed;
+          case 0x10:            /* BPL $nnnn */
+          case 0x30:            /* BMI $nnnn */
+          case 0x50:            /* BVC $nnnn */
+          case 0x70:            /* BVS $nnnn */
+          case 0x90:            /* BCC $nnnn */
+          case 0xb0:            /* BCS $nnnn */
+          case 0xd0:            /* BNE $nnnn */
+          case 0xf0:            /* BEQ $nnnn */
+            switch (op[0] >> 6) {
+              case 0:
+                taken = (sign != 0);
+                break;
+              case 1:
+                taken = ((p & P_OVERFLOW) != 0);
+                break;
+              case 2:
+                taken = ((p & P_CARRY) != 0);
+                break;
+              default:
+                taken = (zero != 0);
+                break;
+            }
+            if (!(op[0] & 0x20)) {
+                taken = !taken;
+            }
+            if (!taken) {
+                return 0;
+            }
+            tmp = pc + 2;
+            if (((tmp + (signed char)op[1]) & 0xffff) != head) {
+                return 0;
+            }
+            cycles += ((tmp ^ head) & 0xff00) ? 4 : 3;
+            goto loop_closed;
+          default:
+            return 0;
+        }
+
+        switch (op[0]) {
+          case 0xa9:
+          case 0xa5:
+          case 0xad:
+            a = value;
+            sign = a & 0x80;
+            zero = (a == 0);
+            break;
+          case 0xa2:
+          case 0xa6:
+          case 0xae:
+            x = value;
+            sign = x & 0x80;
+            zero = (x == 0);
+            break;
+          case 0xa0:
+          case 0xa4:
+          case 0xac:
+            y = value;
+            sign = y & 0x80;
+            zero = (y == 0);
+            break;
+          case 0x29:
+            a &= value;
+            sign = a & 0x80;
+            zero = (a == 0);
+            break;
+          case 0x24:
+          case 0x2c:
+            sign = value & 0x80;
+            p = (p & ~P_OVERFLOW) | (value & P_OVERFLOW);
+            zero = ((a & value) == 0);
+            break;
+          default:
+            tmp = ((op[0] == 0xc9 || op[0] == 0xc5 || op[0] == 0xcd) ? a
+                   : (op[0] & 0x20) ? x : y) - value;
+            p = (p & ~P_CARRY) | (tmp < 0x100 ? P_CARRY : 0);
+            sign = tmp & 0x80;
+            zero = ((tmp & 0xff) == 0);
+            break;
+        }
+    }
+
+    return 0;
+
+loop_closed:
+    /* The loop can only be skipped if another pass would do exactly the
+       same.  */
+    if (pc < head || (int)pc >= bank_limit
+        || a != reg_a || x != reg_x || y != reg_y
+        || sign != (flag_n & 0x80) || zero != !flag_z
+        || (p & (P_CARRY | P_OVERFLOW)) != (reg_p & (P_CARRY | P_OVERFLOW))) {
+        return 0;
+    }
+
+    /* Stop before the pass in which the next alarm is due, so it is
+       dispatched at the same instruction as without skipping.  */
+    next_clk = alarm_context_next_pending_clk(maincpu_alarm_context);
+    if (next_clk == CLOCK_MAX || next_clk <= maincpu_clk + cycles) {
+        return 0;
+    }
+
+    return ((next_clk - maincpu_clk - 1) / cycles) * cycles;
+}
+
+/* Called after a jump or a taken branch.  */
+#define CPU_IDLE_LOOP()                                                     \
+    do {                                                                    \
+        if (((int)reg_pc) < bank_limit                                      \
+            && idle_loop_head_tab[bank_base[reg_pc]]                        \
+            && maincpu_int_status->global_pending_int == IK_NONE            \
+            && monitor_mask[CALLER] == MI_NONE) {                           \
+            CLK += idle_loop_skip(reg_pc, bank_base, bank_limit, reg_a,     \
+                                  reg_x, reg_y, reg_p, flag_n, flag_z);     \
+        }                                                                   \
+    } while (0)
+
+#endif /* !C64DTV && !CPU_8502 && !CYCLE_EXACT_ALARM */
+
+/* ------------------------------------------------------------------------- */
+
 #ifdef NEED_REG_PC
 unsigned int reg_pc;
 #endif
@@ -508,9 +801,13 @@ void maincpu_mainloop(void)
 
 #define GLOBAL_REGS maincpu_regs
 
+#define CPU_LOOP_CONTINUE() 1
+
+#define CPU_OPCODE_DONE() maincpu_int_status->num_dma_per_opcode = 0
+
 #include "6510core.c"
 
-        maincpu_int_status->num_dma_per_opcode = 0;
+        CPU_OPCODE_DONE();
 #if 0
         if (CLK > 246171754)
             debug.maincpu_traceflg = 1;
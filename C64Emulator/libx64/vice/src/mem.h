@@ -42,6 +42,14 @@ extern store_func_ptr_t *_mem_write_tab_ptr;
 extern BYTE **_mem_read_base_tab_ptr;
 extern int *mem_read_limit_tab_ptr;
 
+/* Plain memory behind each page that the CPU can load from or store to
+   without calling the handler, or NULL.  The zero page is never in the
+   tables; `_mem_read_zero_ptr' and `_mem_write_zero_ptr' cover $02-$FF.  */
+extern BYTE **_mem_read_ptr_tab_ptr;
+extern BYTE **_mem_write_ptr_tab_ptr;
+extern BYTE *_mem_read_zero_ptr;
+extern BYTE *_mem_write_zero_ptr;
+
 extern BYTE mem_ram[];
 extern BYTE *mem_page_zero;
 extern BYTE *mem_page_one;
@@ -275,6 +275,7 @@ void machine_resources_shutdown(void)
     video_resources_shutdown();
     plus4_resources_shutdown();
     sound_resources_shutdown();
+    sid_resources_shutdown();
     rs232drv_resources_shutdown();
     printer_resources_shutdown();
     drive_resources_shutdown();
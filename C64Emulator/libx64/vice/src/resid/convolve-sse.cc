@@ -0,0 +1,77 @@
+//  ---------------------------------------------------------------------------
+//  This file is part of reSID, a MOS6581 SID emulator engine.
+//  Copyright (C) 2004  Dag Lem <resid@nimrod.no>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//  ---------------------------------------------------------------------------
+
+#include "resid-config.h"
+
+#if RESID_USE_SIMD
+
+#include <immintrin.h>
+
+namespace reSID
+{
+
+// ----------------------------------------------------------------------------
+// Convolution of n samples with a FIR table, 8 samples at a time.
+// The FIR table must be 16 byte aligned, and n a multiple of 8.
+// The 32 bit sums wrap around exactly like the scalar code, so the result
+// is the same.
+// ----------------------------------------------------------------------------
+__attribute__((target("sse2")))
+int convolve_sse2(const short* a, const short* b, int n)
+{
+  __m128i out4 = _mm_setzero_si128();
+
+  for (int i = 0; i < n; i += 8) {
+    __m128i a8 = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i b8 = _mm_load_si128((const __m128i*)(b + i));
+    out4 = _mm_add_epi32(out4, _mm_madd_epi16(a8, b8));
+  }
+
+  out4 = _mm_add_epi32(out4, _mm_shuffle_epi32(out4, _MM_SHUFFLE(1, 0, 3, 2)));
+  out4 = _mm_add_epi32(out4, _mm_shuffle_epi32(out4, _MM_SHUFFLE(2, 3, 0, 1)));
+
+  return _mm_cvtsi128_si32(out4);
+}
+
+// ----------------------------------------------------------------------------
+// Convolution of n samples with a FIR table, 16 samples at a time.
+// The FIR table must be 32 byte aligned, and n a multiple of 16.
+// ----------------------------------------------------------------------------
+__attribute__((target("avx2")))
+int convolve_avx2(const short* a, const short* b, int n)
+{
+  __m256i out8 = _mm256_setzero_si256();
+
+  for (int i = 0; i < n; i += 16) {
+    __m256i a16 = _mm256_loadu_si256((const __m256i*)(a + i));
+    __m256i b16 = _mm256_load_si256((const __m256i*)(b + i));
+    out8 = _mm256_add_epi32(out8, _mm256_madd_epi16(a16, b16));
+  }
+
+  __m128i out4 = _mm_add_epi32(_mm256_castsi256_si128(out8),
+                               _mm256_extracti128_si256(out8, 1));
+  out4 = _mm_add_epi32(out4, _mm_shuffle_epi32(out4, _MM_SHUFFLE(1, 0, 3, 2)));
+  out4 = _mm_add_epi32(out4, _mm_shuffle_epi32(out4, _MM_SHUFFLE(2, 3, 0, 1)));
+
+  return _mm_cvtsi128_si32(out4);
+}
+
+} // namespace reSID
+
+#endif // RESID_USE_SIMD
@@ -0,0 +1,158 @@
+//  ---------------------------------------------------------------------------
+//  This file is part of reSID, a MOS6581 SID emulator engine.
+//  Copyright (C) 2004  Dag Lem <resid@nimrod.no>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//  ---------------------------------------------------------------------------
+
+// Check that the SIMD convolution kernels the host CPU supports return
+// exactly what the scalar kernel returns.
+//
+// convolvecheck [rounds]
+//
+// Each round convolves random samples at every offset into the sample
+// buffer with a random FIR table, for every table length the kernels
+// accept up to 1024.  The samples are drawn from three ranges: the full
+// 16 bit range, where the 32 bit sums wrap around, the range of the
+// resampled SID output, and the extremes -32768 and 32767 only.  The
+// program exits with status 1 on the first difference.
+
+#include "resid-config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace reSID
+{
+
+extern int convolve(const short* a, const short* b, int n);
+#if RESID_USE_SIMD
+extern int convolve_sse2(const short* a, const short* b, int n);
+extern int convolve_avx2(const short* a, const short* b, int n);
+#endif
+
+}
+
+using namespace reSID;
+
+enum {
+  // Longest table, and alignment of the table, as in SID::fir.
+  MAX_N = 1024,
+  ALIGN = 16,
+  // Offsets into the sample buffer; the samples need no alignment.
+  OFFSETS = 16
+};
+
+struct kernel_t {
+  const char* name;
+  int (*convolve)(const short* a, const short* b, int n);
+  // Table lengths must be a multiple of this.
+  int step;
+};
+
+// Fixed generator, so that a failure can be reproduced.
+static unsigned int seed = 1;
+
+static short random_sample(int range)
+{
+  seed = seed*1103515245 + 12345;
+  int r = (int)(seed >> 8);
+
+  switch (range) {
+  case 0:
+    return (short)r;
+  case 1:
+    return (short)(r%8192 - 4096);
+  default:
+    return (r & 1) ? 32767 : -32768;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  int rounds = argc > 1 ? atoi(argv[1]) : 4;
+
+  kernel_t kernels[2];
+  int num_kernels = 0;
+
+#if RESID_USE_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2")) {
+    kernels[num_kernels].name = "sse2";
+    kernels[num_kernels].convolve = convolve_sse2;
+    kernels[num_kernels].step = 8;
+    num_kernels++;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    kernels[num_kernels].name = "avx2";
+    kernels[num_kernels].convolve = convolve_avx2;
+    kernels[num_kernels].step = 16;
+    num_kernels++;
+  }
+#endif
+
+  if (num_kernels == 0) {
+    printf("No SIMD kernel on this host, nothing to check.\n");
+    return 0;
+  }
+
+  short* samples = new short[MAX_N + OFFSETS];
+  short* table_buf = new short[MAX_N + ALIGN];
+  short* table = table_buf;
+  while ((size_t)table & (ALIGN*sizeof(short) - 1)) {
+    table++;
+  }
+
+  unsigned long checked[2] = { 0, 0 };
+
+  for (int round = 0; round < rounds; round++) {
+    for (int range = 0; range < 3; range++) {
+      for (int i = 0; i < MAX_N + OFFSETS; i++) {
+	samples[i] = random_sample(range);
+      }
+      for (int i = 0; i < MAX_N; i++) {
+	table[i] = random_sample(range);
+      }
+
+      for (int k = 0; k < num_kernels; k++) {
+	for (int n = kernels[k].step; n <= MAX_N; n += kernels[k].step) {
+	  for (int offset = 0; offset < OFFSETS; offset++) {
+	    int expected = convolve(samples + offset, table, n);
+	    int result = kernels[k].convolve(samples + offset, table, n);
+
+	    if (result != expected) {
+	      printf("%s: round %d, range %d, n = %d, offset %d: "
+		     "%d instead of %d\n",
+		     kernels[k].name, round, range, n, offset,
+		     result, expected);
+	      return 1;
+	    }
+	    checked[k]++;
+	  }
+	}
+      }
+    }
+  }
+
+  for (int k = 0; k < num_kernels; k++) {
+    printf("%s: %lu convolutions, all equal to the scalar kernel.\n",
+	   kernels[k].name, checked[k]);
+  }
+
+  delete[] samples;
+  delete[] table_buf;
+
+  return 0;
+}
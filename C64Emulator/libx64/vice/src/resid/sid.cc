@@ -21,6 +21,16 @@
 
 #include "sid.h"
 #include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#if RESID_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #ifndef round
 #define round(x) (x>=0.0?floor(x+0.5):ceil(x-0.5))
@@ -29,6 +39,29 @@
 namespace reSID
 {
 
+extern int convolve(const short* a, const short* b, int n);
+#if RESID_USE_SIMD
+extern int convolve_sse2(const short* a, const short* b, int n);
+extern int convolve_avx2(const short* a, const short* b, int n);
+#endif
+
+// ----------------------------------------------------------------------------
+// Pick the fastest convolution kernel the host CPU supports.
+// ----------------------------------------------------------------------------
+static int (*convolve_kernel())(const short*, const short*, int)
+{
+#if RESID_USE_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return convolve_avx2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return convolve_sse2;
+  }
+#endif
+  return reSID::convolve;
+}
+
 // ----------------------------------------------------------------------------
 // Constructor.
 // ----------------------------------------------------------------------------
@@ -37,6 +70,9 @@ SID::SID()
   // Initialize pointers.
   sample = 0;
   fir = 0;
+  fir_table = 0;
+
+  convolve = convolve_kernel();
 
   sid_model = MOS6581;
   voice[0].set_sync_source(&voice[2]);
@@ -57,7 +93,7 @@ SID::SID()
 SID::~SID()
 {
   delete[] sample;
-  delete[] fir;
+  fir_table_release(fir_table);
 }
 
 
@@ -360,8 +396,12 @@ void SID::write_state(const State& state)
 {
   int i;
 
+  // Bypass the MOS8580 write pipeline, which would only keep the last
+  // register.
   for (i = 0; i <= 0x18; i++) {
-    write(i, state.sid_register[i]);
+    write_address = i;
+    bus_value = state.sid_register[i];
+    write();
   }
 
   bus_value = state.bus_value;
@@ -455,6 +495,418 @@ double SID::I0(double x)
 }
 
 
+// ----------------------------------------------------------------------------
+// FIR table cache.
+// The FIR tables only depend on the sampling parameters, and are shared by
+// all SID instances using the same parameters. Tables are reference counted.
+// Tables no longer in use are kept until a new table is made, so that a SID
+// being closed and reopened with unchanged parameters does not calculate its
+// table again.
+// With a cache directory set, tables are also kept in files, which are
+// mapped into memory by later runs rather than calculated.
+// Like the rest of reSID, the cache is not thread safe; SID instances must be
+// created, configured, and destroyed from a single thread.
+// ----------------------------------------------------------------------------
+struct SID::fir_table_t
+{
+  // Sampling parameters.
+  double clock_freq;
+  double sample_freq;
+  double pass_freq;
+  double filter_scale;
+  int method;
+
+  int fir_N;
+  int fir_RES;
+  int fir_stride;
+
+  // fir_stride*fir_RES samples, aligned to FIR_ALIGN samples.
+  const short* fir;
+
+  // Memory holding the tables; either allocated, or a file mapping.
+  short* fir_alloc;
+  void* map;
+  size_t map_size;
+
+  int refcount;
+  fir_table_t* next;
+};
+
+SID::fir_table_t* SID::fir_tables = 0;
+char* SID::fir_cache_dir = 0;
+
+// Header of a FIR table file, followed by the tables. The header takes up
+// 64 bytes, keeping the mapped tables aligned to FIR_ALIGN samples.
+struct fir_file_header_t
+{
+  char magic[8];
+  int version;
+  // Written as 0x01020304, telling the byte order.
+  int byte_order;
+  int fir_N;
+  int fir_RES;
+  int fir_stride;
+  int method;
+  double clock_freq;
+  double sample_freq;
+  double pass_freq;
+  double filter_scale;
+};
+
+static const char fir_file_magic[8] = { 'r', 'e', 'S', 'I', 'D', 'F', 'I', 'R' };
+static const int fir_file_version = 1;
+
+static void fir_file_header_set(fir_file_header_t* header, int fir_N,
+                                int fir_RES, int fir_stride, int method,
+                                double clock_freq, double sample_freq,
+                                double pass_freq, double filter_scale)
+{
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, fir_file_magic, sizeof(header->magic));
+  header->version = fir_file_version;
+  header->byte_order = 0x01020304;
+  header->fir_N = fir_N;
+  header->fir_RES = fir_RES;
+  header->fir_stride = fir_stride;
+  header->method = method;
+  header->clock_freq = clock_freq;
+  header->sample_freq = sample_freq;
+  header->pass_freq = pass_freq;
+  header->filter_scale = filter_scale;
+}
+
+
+// ----------------------------------------------------------------------------
+// Set the directory for FIR table files. A null or empty directory turns off
+// the use of files.
+// ----------------------------------------------------------------------------
+void SID::set_fir_cache_dir(const char* dir)
+{
+  delete[] fir_cache_dir;
+  fir_cache_dir = 0;
+
+  if (dir && *dir) {
+    fir_cache_dir = new char[strlen(dir) + 1];
+    strcpy(fir_cache_dir, dir);
+  }
+}
+
+
+// ----------------------------------------------------------------------------
+// Get a reference to the FIR tables for the given sampling parameters,
+// loading or calculating them unless they are in the cache already.
+// ----------------------------------------------------------------------------
+SID::fir_table_t* SID::fir_table_get(double clock_freq, sampling_method method,
+				     double sample_freq, double pass_freq,
+				     double filter_scale)
+{
+  fir_table_t* table;
+  fir_table_t** prev;
+
+  for (table = fir_tables; table; table = table->next) {
+    if (table->clock_freq == clock_freq && table->method == method
+        && table->sample_freq == sample_freq && table->pass_freq == pass_freq
+        && table->filter_scale == filter_scale)
+    {
+      table->refcount++;
+      return table;
+    }
+  }
+
+  // Free the tables no longer in use.
+  for (prev = &fir_tables; *prev; ) {
+    table = *prev;
+    if (table->refcount == 0) {
+      *prev = table->next;
+      fir_table_free(table);
+    }
+    else {
+      prev = &table->next;
+    }
+  }
+
+  table = new fir_table_t;
+  table->clock_freq = clock_freq;
+  table->sample_freq = sample_freq;
+  table->pass_freq = pass_freq;
+  table->filter_scale = filter_scale;
+  table->method = method;
+  table->fir = 0;
+  table->fir_alloc = 0;
+  table->map = 0;
+  table->map_size = 0;
+
+  const double pi = 3.1415926535897932385;
+
+  // 16 bits -> -96dB stopband attenuation.
+  const double A = -20*log10(1.0/(1 << 16));
+  // A fraction of the bandwidth is allocated to the transition band,
+  double dw = (1 - 2*pass_freq/sample_freq)*pi*2;
+
+  // The filter order will maximally be 124 with the current constraints.
+  // N >= (96.33 - 7.95)/(2.285*0.1*pi) -> N >= 123
+  // The filter order is equal to the number of zero crossings, i.e.
+  // it should be an even number (sinc is symmetric about x = 0).
+  int N = int((A - 7.95)/(2.285*dw) + 0.5);
+  N += N & 1;
+
+  double f_cycles_per_sample = clock_freq/sample_freq;
+
+  // The filter length is equal to the filter order + 1.
+  // The filter length must be an odd number (sinc is symmetric about x = 0).
+  table->fir_N = int(N*f_cycles_per_sample) + 1;
+  table->fir_N |= 1;
+
+  // We clamp the filter table resolution to 2^n, making the fixed point
+  // sample_offset a whole multiple of the filter table resolution.
+  int res = method == SAMPLE_RESAMPLE ?
+    FIR_RES : FIR_RES_FASTMEM;
+  int n = (int)ceil(log(res/f_cycles_per_sample)/log(2.0f));
+  table->fir_RES = 1 << n;
+
+  // Each table is padded with zeros to a multiple of FIR_ALIGN.
+  table->fir_stride = (table->fir_N + FIR_ALIGN - 1) & ~(FIR_ALIGN - 1);
+
+  if (!fir_table_load(table)) {
+    fir_table_calculate(table);
+    fir_table_store(table);
+  }
+
+  table->refcount = 1;
+  table->next = fir_tables;
+  fir_tables = table;
+
+  return table;
+}
+
+
+// ----------------------------------------------------------------------------
+// Let go of a reference to FIR tables.
+// ----------------------------------------------------------------------------
+void SID::fir_table_release(fir_table_t* table)
+{
+  if (table) {
+    table->refcount--;
+  }
+}
+
+
+// ----------------------------------------------------------------------------
+// Free FIR tables no longer in the cache.
+// ----------------------------------------------------------------------------
+void SID::fir_table_free(fir_table_t* table)
+{
+#if RESID_USE_MMAP
+  if (table->map) {
+    munmap(table->map, table->map_size);
+  }
+#endif
+  delete[] table->fir_alloc;
+  delete table;
+}
+
+
+// ----------------------------------------------------------------------------
+// Calculate fir_RES FIR tables for linear interpolation.
+// ----------------------------------------------------------------------------
+void SID::fir_table_calculate(fir_table_t* table)
+{
+  const double pi = 3.1415926535897932385;
+
+  // 16 bits -> -96dB stopband attenuation.
+  const double A = -20*log10(1.0/(1 << 16));
+  // The cutoff frequency is midway through the transition band (nyquist)
+  double wc = pi;
+
+  // For calculation of beta and N see the reference for the kaiserord
+  // function in the MATLAB Signal Processing Toolbox:
+  // http://www.mathworks.com/access/helpdesk/help/toolbox/signal/kaiserord.html
+  const double beta = 0.1102*(A - 8.7);
+  const double I0beta = I0(beta);
+
+  double f_samples_per_cycle = table->sample_freq/table->clock_freq;
+  double f_cycles_per_sample = table->clock_freq/table->sample_freq;
+
+  int fir_N = table->fir_N;
+  int fir_RES = table->fir_RES;
+  int fir_stride = table->fir_stride;
+
+  // Allocate memory for FIR tables, aligned for vector loads.
+  table->fir_alloc = new short[fir_stride*fir_RES + FIR_ALIGN];
+  short* fir = table->fir_alloc;
+  while ((size_t)fir & (FIR_ALIGN*sizeof(short) - 1)) {
+    fir++;
+  }
+  table->fir = fir;
+
+  for (int i = 0; i < fir_RES; i++) {
+    int fir_offset = i*fir_stride + fir_N/2;
+    double j_offset = double(i)/fir_RES;
+    // Calculate FIR table. This is the sinc function, weighted by the
+    // Kaiser window.
+    for (int j = -fir_N/2; j <= fir_N/2; j++) {
+      double jx = j - j_offset;
+      double wt = wc*jx/f_cycles_per_sample;
+      double temp = jx/(fir_N/2);
+      double Kaiser =
+	fabs(temp) <= 1 ? I0(beta*sqrt(1 - temp*temp))/I0beta : 0;
+      double sincwt =
+	fabs(wt) >= 1e-6 ? sin(wt)/wt : 1;
+      double val =
+	(1 << FIR_SHIFT)*table->filter_scale*f_samples_per_cycle*wc/pi*sincwt*Kaiser;
+      fir[fir_offset + j] = (short)round(val);
+    }
+    for (int j = fir_N; j < fir_stride; j++) {
+      fir[i*fir_stride + j] = 0;
+    }
+  }
+}
+
+
+// ----------------------------------------------------------------------------
+// Name of the file keeping the FIR tables, or null if there is no cache
+// directory. The name must be freed by delete[].
+// ----------------------------------------------------------------------------
+char* SID::fir_table_path(fir_table_t* table)
+{
+  if (!fir_cache_dir) {
+    return 0;
+  }
+
+  // The parameters in the name need not be exact; the file header holds
+  // the exact parameters.
+  char* path = new char[strlen(fir_cache_dir) + 96];
+  sprintf(path, "%s/resid-fir-%d-%d-%d-%d-%d.bin", fir_cache_dir,
+          int(table->clock_freq + 0.5), int(table->sample_freq + 0.5),
+          int(table->pass_freq + 0.5), int(table->filter_scale*1000 + 0.5),
+          table->method);
+  return path;
+}
+
+
+// ----------------------------------------------------------------------------
+// Load FIR tables from the cache directory, mapping the file into memory
+// where possible.
+// ----------------------------------------------------------------------------
+bool SID::fir_table_load(fir_table_t* table)
+{
+  char* path = fir_table_path(table);
+  if (!path) {
+    return false;
+  }
+
+  fir_file_header_t header;
+  fir_file_header_set(&header, table->fir_N, table->fir_RES, table->fir_stride,
+                      table->method, table->clock_freq, table->sample_freq,
+                      table->pass_freq, table->filter_scale);
+  size_t fir_size = size_t(table->fir_stride)*table->fir_RES*sizeof(short);
+  size_t file_size = sizeof(header) + fir_size;
+
+#if RESID_USE_MMAP
+  int fd = open(path, O_RDONLY);
+  delete[] path;
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || size_t(st.st_size) != file_size) {
+    close(fd);
+    return false;
+  }
+
+  void* map = mmap(0, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+
+  if (memcmp(map, &header, sizeof(header))) {
+    munmap(map, file_size);
+    return false;
+  }
+
+  table->map = map;
+  table->map_size = file_size;
+  table->fir = (const short*)((const char*)map + sizeof(header));
+  return true;
+#else
+  FILE* f = fopen(path, "rb");
+  delete[] path;
+  if (!f) {
+    return false;
+  }
+
+  fir_file_header_t file_header;
+  if (fread(&file_header, sizeof(file_header), 1, f) != 1
+      || memcmp(&file_header, &header, sizeof(header)))
+  {
+    fclose(f);
+    return false;
+  }
+
+  table->fir_alloc = new short[fir_size/sizeof(short) + FIR_ALIGN];
+  short* fir = table->fir_alloc;
+  while ((size_t)fir & (FIR_ALIGN*sizeof(short) - 1)) {
+    fir++;
+  }
+
+  if (fread(fir, fir_size, 1, f) != 1) {
+    fclose(f);
+    delete[] table->fir_alloc;
+    table->fir_alloc = 0;
+    return false;
+  }
+
+  fclose(f);
+  table->fir = fir;
+  return true;
+#endif
+}
+
+
+// ----------------------------------------------------------------------------
+// Store calculated FIR tables in the cache directory. The file is written
+// under a temporary name and renamed into place, so that other processes
+// never see a partial file.
+// ----------------------------------------------------------------------------
+void SID::fir_table_store(fir_table_t* table)
+{
+  char* path = fir_table_path(table);
+  if (!path) {
+    return;
+  }
+
+  char* tmp_path = new char[strlen(path) + 5];
+  sprintf(tmp_path, "%s.tmp", path);
+
+  fir_file_header_t header;
+  fir_file_header_set(&header, table->fir_N, table->fir_RES, table->fir_stride,
+                      table->method, table->clock_freq, table->sample_freq,
+                      table->pass_freq, table->filter_scale);
+  size_t fir_size = size_t(table->fir_stride)*table->fir_RES*sizeof(short);
+
+  FILE* f = fopen(tmp_path, "wb");
+  if (f) {
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+      && fwrite(table->fir, fir_size, 1, f) == 1;
+    if (fclose(f) == 0 && ok) {
+      // rename() does not replace an existing file everywhere.
+      if (rename(tmp_path, path) != 0) {
+        remove(path);
+        ok = rename(tmp_path, path) == 0;
+      }
+    }
+    if (!ok) {
+      remove(tmp_path);
+    }
+  }
+
+  delete[] tmp_path;
+  delete[] path;
+}
+
+
 // ----------------------------------------------------------------------------
 // Setting of SID sampling parameters.
 //
@@ -523,79 +975,31 @@ bool SID::set_sampling_parameters(double clock_freq, sampling_method method,
   if (method != SAMPLE_RESAMPLE && method != SAMPLE_RESAMPLE_FASTMEM)
   {
     delete[] sample;
-    delete[] fir;
+    fir_table_release(fir_table);
     sample = 0;
     fir = 0;
+    fir_table = 0;
     return true;
   }
 
-  const double pi = 3.1415926535897932385;
+  // Get the FIR tables before letting go of the current ones, which may be
+  // the same.
+  fir_table_t* table =
+    fir_table_get(clock_freq, method, sample_freq, pass_freq, filter_scale);
+  fir_table_release(fir_table);
+  fir_table = table;
 
-  // 16 bits -> -96dB stopband attenuation.
-  const double A = -20*log10(1.0/(1 << 16));
-  // A fraction of the bandwidth is allocated to the transition band,
-  double dw = (1 - 2*pass_freq/sample_freq)*pi*2;
-  // The cutoff frequency is midway through the transition band (nyquist)
-  double wc = pi;
-
-  // For calculation of beta and N see the reference for the kaiserord
-  // function in the MATLAB Signal Processing Toolbox:
-  // http://www.mathworks.com/access/helpdesk/help/toolbox/signal/kaiserord.html
-  const double beta = 0.1102*(A - 8.7);
-  const double I0beta = I0(beta);
-
-  // The filter order will maximally be 124 with the current constraints.
-  // N >= (96.33 - 7.95)/(2.285*0.1*pi) -> N >= 123
-  // The filter order is equal to the number of zero crossings, i.e.
-  // it should be an even number (sinc is symmetric about x = 0).
-  int N = int((A - 7.95)/(2.285*dw) + 0.5);
-  N += N & 1;
-
-  double f_samples_per_cycle = sample_freq/clock_freq;
-  double f_cycles_per_sample = clock_freq/sample_freq;
-
-  // The filter length is equal to the filter order + 1.
-  // The filter length must be an odd number (sinc is symmetric about x = 0).
-  fir_N = int(N*f_cycles_per_sample) + 1;
-  fir_N |= 1;
-
-  // We clamp the filter table resolution to 2^n, making the fixed point
-  // sample_offset a whole multiple of the filter table resolution.
-  int res = method == SAMPLE_RESAMPLE ?
-    FIR_RES : FIR_RES_FASTMEM;
-  int n = (int)ceil(log(res/f_cycles_per_sample)/log(2.0f));
-  fir_RES = 1 << n;
-
-  // Allocate memory for FIR tables.
-  delete[] fir;
-  fir = new short[fir_N*fir_RES];
-
-  // Calculate fir_RES FIR tables for linear interpolation.
-  for (int i = 0; i < fir_RES; i++) {
-    int fir_offset = i*fir_N + fir_N/2;
-    double j_offset = double(i)/fir_RES;
-    // Calculate FIR table. This is the sinc function, weighted by the
-    // Kaiser window.
-    for (int j = -fir_N/2; j <= fir_N/2; j++) {
-      double jx = j - j_offset;
-      double wt = wc*jx/f_cycles_per_sample;
-      double temp = jx/(fir_N/2);
-      double Kaiser =
-	fabs(temp) <= 1 ? I0(beta*sqrt(1 - temp*temp))/I0beta : 0;
-      double sincwt =
-	fabs(wt) >= 1e-6 ? sin(wt)/wt : 1;
-      double val =
-	(1 << FIR_SHIFT)*filter_scale*f_samples_per_cycle*wc/pi*sincwt*Kaiser;
-      fir[fir_offset + j] = (short)round(val);
-    }
-  }
+  fir_N = table->fir_N;
+  fir_RES = table->fir_RES;
+  fir_stride = table->fir_stride;
+  fir = table->fir;
 
   // Allocate sample buffer.
   if (!sample) {
-    sample = new short[RINGSIZE*2];
+    sample = new short[RINGSIZE*2 + FIR_ALIGN];
   }
   // Clear sample buffer.
-  for (int j = 0; j < RINGSIZE*2; j++) {
+  for (int j = 0; j < RINGSIZE*2 + FIR_ALIGN; j++) {
     sample[j] = 0;
   }
   sample_index = 0;
@@ -708,12 +1112,295 @@ void SID::clock(cycle_count delta_t)
     voice[i].wave.set_waveform_output(delta_t);
   }
 
-  // Clock filter.
-  filter.clock(delta_t,
-	       voice[0].output(), voice[1].output(), voice[2].output());
+  int voice1 = voice[0].output();
+  int voice2 = voice[1].output();
+  int voice3 = voice[2].output();
+
+  if (likely(voice1 | voice2 | voice3)) {
+    // Clock filter.
+    filter.clock(delta_t, voice1, voice2, voice3);
+
+    // Clock external filter.
+    extfilt.clock(delta_t, filter.output());
+    return;
+  }
+
+  // All voices are silent, and the filters settle into a state which is left
+  // unchanged by clocking. The filters are clocked in steps of at most 3 and
+  // 8 cycles, respectively; if the first step leaves the state unchanged, so
+  // will the remaining (shorter or equal) steps, which are then skipped.
+  Filter filter_prev = filter;
+  cycle_count delta_t_flt = delta_t < 3 ? delta_t : 3;
+  filter.clock(delta_t_flt, voice1, voice2, voice3);
+  if (!filter_unchanged(filter_prev)) {
+    filter.clock(delta_t - delta_t_flt, voice1, voice2, voice3);
+  }
+
+  ExternalFilter extfilt_prev = extfilt;
+  delta_t_flt = delta_t < 8 ? delta_t : 8;
+  extfilt.clock(delta_t_flt, filter.output());
+  if (!extfilt_unchanged(extfilt_prev)) {
+    extfilt.clock(delta_t - delta_t_flt, filter.output());
+  }
+}
+
+
+// ----------------------------------------------------------------------------
+// Check whether clocking has left the filter state as it was.
+// The filter / mixer inputs are not part of the state being compared.
+// ----------------------------------------------------------------------------
+bool SID::filter_unchanged(const Filter& filter_prev)
+{
+  return filter.Vhp == filter_prev.Vhp
+    && filter.Vbp == filter_prev.Vbp
+    && filter.Vbp_x == filter_prev.Vbp_x
+    && filter.Vbp_vc == filter_prev.Vbp_vc
+    && filter.Vlp == filter_prev.Vlp
+    && filter.Vlp_x == filter_prev.Vlp_x
+    && filter.Vlp_vc == filter_prev.Vlp_vc;
+}
+
+bool SID::extfilt_unchanged(const ExternalFilter& extfilt_prev)
+{
+  return extfilt.Vlp == extfilt_prev.Vlp && extfilt.Vhp == extfilt_prev.Vhp;
+}
+
+
+// ----------------------------------------------------------------------------
+// Number of the next cycles, at most n, that can be run by clock_block()
+// without any of the voices having anything to do but step its accumulator,
+// pulse comparator and rate counter.
+// ----------------------------------------------------------------------------
+cycle_count SID::clock_block_span(cycle_count n)
+{
+  if (unlikely(write_pipeline)) {
+    return 0;
+  }
+
+  for (int i = 0; i < 3; i++) {
+    WaveformGenerator& wave = voice[i].wave;
+    EnvelopeGenerator& envelope = voice[i].envelope;
 
-  // Clock external filter.
-  extfilt.clock(delta_t, filter.output());
+    // Test bit, hard sync, noise shift, combined waveforms writing the shift
+    // register, and pipelined envelope decrements need single cycle clocking.
+    if (wave.test || wave.sync || wave.shift_pipeline || wave.waveform > 0x8
+        || envelope.envelope_pipeline)
+    {
+      return 0;
+    }
+
+    // Cycles until the rate counter reaches the rate period, or wraps around
+    // at 0x8000 (the ADSR delay bug). An envelope counter frozen at zero is
+    // not stepped, and is clocked over the whole span in one go.
+    if (!envelope.hold_zero) {
+      cycle_count rate_step = (envelope.rate_counter < envelope.rate_period ?
+                               envelope.rate_period : 0x8000)
+        - envelope.rate_counter;
+      if (rate_step - 1 < n) {
+        n = rate_step - 1;
+      }
+    }
+
+    // Cycles until accumulator bit 19 is set high, starting the pipeline
+    // of the noise shift register.
+    if (wave.freq) {
+      reg24 low = wave.accumulator & 0x0fffff;
+      reg24 delta_accumulator = (low < 0x080000 ? 0x080000 : 0x180000) - low;
+      cycle_count shift_step = (delta_accumulator + wave.freq - 1)/wave.freq;
+      if (shift_step - 1 < n) {
+        n = shift_step - 1;
+      }
+    }
+
+    // Cycles until the floating DAC input fades to zero.
+    if (!wave.waveform && wave.floating_output_ttl) {
+      if (wave.floating_output_ttl - 1 < n) {
+        n = wave.floating_output_ttl - 1;
+      }
+    }
+  }
+
+  return n;
+}
+
+
+// ----------------------------------------------------------------------------
+// SID clocking - n cycles, storing the output of every cycle in buf unless
+// it is null.
+// The result is exactly the same as calling clock() n times. Spans given by
+// clock_block_span() are run in one loop over the voice state of all three
+// voices, kept as arrays; the remaining cycles are clocked by clock().
+// With all envelopes at zero the filter inputs are constant, and once a cycle
+// leaves the filters unchanged, so will every following cycle of the span.
+// The oscillators are then stepped ahead to the last cycle of the span, with
+// the constant output filled in for the skipped cycles.
+// ----------------------------------------------------------------------------
+void SID::clock_block(cycle_count n, short* buf)
+{
+  while (n > 0) {
+    cycle_count span = clock_block_span(n);
+
+    if (span == 0) {
+      clock();
+      if (buf) {
+        *buf++ = output();
+      }
+      n--;
+      continue;
+    }
+
+    // Voice state.
+    reg24 accumulator[3];
+    reg24 freq[3];
+    reg12 pw[3];
+    reg24 ring_msb_mask[3];
+    int sync_source[3];
+    reg8 waveform[3];
+    unsigned short* wave[3];
+    unsigned short* dac[3];
+    unsigned short no_pulse[3];
+    unsigned short no_noise_or_noise_output[3];
+    unsigned short pulse_output[3];
+    reg12 waveform_output[3];
+    int wave_zero[3];
+    int envelope_output[3];
+    int i, j;
+
+    for (i = 0; i < 3; i++) {
+      WaveformGenerator& w = voice[i].wave;
+
+      accumulator[i] = w.accumulator;
+      freq[i] = w.freq;
+      pw[i] = w.pw;
+      ring_msb_mask[i] = w.ring_msb_mask;
+      for (j = 0; j < 3; j++) {
+        if (w.sync_source == &voice[j].wave) {
+          sync_source[i] = j;
+        }
+      }
+      waveform[i] = w.waveform;
+      wave[i] = w.wave;
+      dac[i] = WaveformGenerator::model_dac[w.sid_model];
+      no_pulse[i] = w.no_pulse;
+      no_noise_or_noise_output[i] = w.no_noise_or_noise_output;
+      pulse_output[i] = w.pulse_output;
+      waveform_output[i] = w.waveform_output;
+      wave_zero[i] = voice[i].wave_zero;
+      // The envelope counters do not change within the span.
+      envelope_output[i] = voice[i].envelope.output();
+    }
+
+    bool silent = !(envelope_output[0] | envelope_output[1] | envelope_output[2]);
+    bool settled = false;
+    Filter filter_prev = filter;
+    ExternalFilter extfilt_prev = extfilt;
+
+    for (cycle_count t = 0; t < span; t++) {
+      if (unlikely(settled) && t < span - 1) {
+        // Step the oscillators ahead to the last cycle of the span.
+        reg24 skip = span - 1 - t;
+        short out = output();
+
+        for (i = 0; i < 3; i++) {
+          accumulator[i] = (accumulator[i] + skip*freq[i]) & 0xffffff;
+          pulse_output[i] = -((accumulator[i] >> 12) >= pw[i]) & 0xfff;
+        }
+
+        if (buf) {
+          for (; t < span - 1; t++) {
+            buf[t] = out;
+          }
+        }
+        t = span - 1;
+      }
+
+      // Clock oscillators.
+      for (i = 0; i < 3; i++) {
+        accumulator[i] = (accumulator[i] + freq[i]) & 0xffffff;
+      }
+
+      // Calculate waveform output, see WaveformGenerator.
+      for (i = 0; i < 3; i++) {
+        if (likely(waveform[i])) {
+          int ix = (accumulator[i]
+                    ^ (accumulator[sync_source[i]] & ring_msb_mask[i])) >> 12;
+          waveform_output[i] = wave[i][ix]
+            & (no_pulse[i] | pulse_output[i]) & no_noise_or_noise_output[i];
+        }
+        pulse_output[i] = -((accumulator[i] >> 12) >= pw[i]) & 0xfff;
+      }
+
+      if (unlikely(silent)) {
+        filter_prev = filter;
+        extfilt_prev = extfilt;
+      }
+
+      // Clock filter.
+      filter.clock((dac[0][waveform_output[0]] - wave_zero[0])*envelope_output[0],
+                   (dac[1][waveform_output[1]] - wave_zero[1])*envelope_output[1],
+                   (dac[2][waveform_output[2]] - wave_zero[2])*envelope_output[2]);
+
+      // Clock external filter.
+      extfilt.clock(filter.output());
+
+      if (buf) {
+        buf[t] = output();
+      }
+
+      if (unlikely(silent)) {
+        settled = filter_unchanged(filter_prev) && extfilt_unchanged(extfilt_prev);
+      }
+    }
+
+    for (i = 0; i < 3; i++) {
+      WaveformGenerator& w = voice[i].wave;
+      reg24 accumulator_prev = (accumulator[i] - freq[i]) & 0xffffff;
+
+      w.accumulator = accumulator[i];
+      w.msb_rising = (~accumulator_prev & accumulator[i] & 0x800000) ? true : false;
+      w.pulse_output = pulse_output[i];
+      if (waveform[i]) {
+        w.waveform_output = waveform_output[i];
+      }
+      else if (w.floating_output_ttl) {
+        w.floating_output_ttl -= span;
+      }
+      voice[i].envelope.clock(span);
+    }
+
+    // Age bus value.
+    if (bus_value_ttl > 0 && bus_value_ttl <= span) {
+      bus_value = 0;
+    }
+    bus_value_ttl -= span;
+
+    if (buf) {
+      buf += span;
+    }
+    n -= span;
+  }
+}
+
+
+// ----------------------------------------------------------------------------
+// SID clocking - n cycles, storing the output of every cycle in the sample
+// ring buffer.
+// ----------------------------------------------------------------------------
+void SID::clock_ring(cycle_count n)
+{
+  while (n > 0) {
+    cycle_count span = RINGSIZE - sample_index;
+    if (span > n) {
+      span = n;
+    }
+
+    clock_block(span, sample + sample_index);
+    memcpy(sample + sample_index + RINGSIZE, sample + sample_index,
+           span*sizeof(short));
+
+    sample_index = (sample_index + span) & RINGMASK;
+    n -= span;
+  }
 }
 
 
@@ -800,12 +1487,14 @@ int SID::clock_interpolate(cycle_count& delta_t, short* buf, int n,
       delta_t_sample = delta_t;
     }
 
-    for (int i = delta_t_sample; i > 0; i--) {
-      clock();
-      if (unlikely(i <= 2)) {
-	sample_prev = sample_now;
-	sample_now = output();
-      }
+    // Only the output of the last two cycles is used.
+    short output_last[2];
+    cycle_count last = delta_t_sample < 2 ? delta_t_sample : 2;
+    clock_block(delta_t_sample - last, 0);
+    clock_block(last, output_last);
+    for (int i = 0; i < last; i++) {
+      sample_prev = sample_now;
+      sample_now = output_last[i];
     }
 
     if ((delta_t -= delta_t_sample) == 0) {
@@ -872,11 +1561,7 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n,
       delta_t_sample = delta_t;
     }
 
-    for (int i = 0; i < delta_t_sample; i++) {
-      clock();
-      sample[sample_index] = sample[sample_index + RINGSIZE] = output();
-      ++sample_index &= RINGMASK;
-    }
+    clock_ring(delta_t_sample);
 
     if ((delta_t -= delta_t_sample) == 0) {
       sample_offset -= delta_t_sample << FIXP_SHIFT;
@@ -887,14 +1572,11 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n,
 
     int fir_offset = sample_offset*fir_RES >> FIXP_SHIFT;
     int fir_offset_rmd = sample_offset*fir_RES & FIXP_MASK;
-    short* fir_start = fir + fir_offset*fir_N;
+    const short* fir_start = fir + fir_offset*fir_stride;
     short* sample_start = sample + sample_index - fir_N - 1 + RINGSIZE;
 
     // Convolution with filter impulse response.
-    int v1 = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v1 += sample_start[j]*fir_start[j];
-    }
+    int v1 = convolve(sample_start, fir_start, fir_stride);
 
     // Use next FIR table, wrap around to first FIR table using
     // next sample.
@@ -902,13 +1584,10 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n,
       fir_offset = 0;
       ++sample_start;
     }
-    fir_start = fir + fir_offset*fir_N;
+    fir_start = fir + fir_offset*fir_stride;
 
     // Convolution with filter impulse response.
-    int v2 = 0;
-    for (int k = 0; k < fir_N; k++) {
-      v2 += sample_start[k]*fir_start[k];
-    }
+    int v2 = convolve(sample_start, fir_start, fir_stride);
 
     // Linear interpolation.
     // fir_offset_rmd is equal for all samples, it can thus be factorized out:
@@ -949,11 +1628,7 @@ int SID::clock_resample_fastmem(cycle_count& delta_t, short* buf, int n,
       delta_t_sample = delta_t;
     }
 
-    for (int i = 0; i < delta_t_sample; i++) {
-      clock();
-      sample[sample_index] = sample[sample_index + RINGSIZE] = output();
-      ++sample_index &= RINGMASK;
-    }
+    clock_ring(delta_t_sample);
 
     if ((delta_t -= delta_t_sample) == 0) {
       sample_offset -= delta_t_sample << FIXP_SHIFT;
@@ -963,14 +1638,11 @@ int SID::clock_resample_fastmem(cycle_count& delta_t, short* buf, int n,
     sample_offset = next_sample_offset & FIXP_MASK;
 
     int fir_offset = sample_offset*fir_RES >> FIXP_SHIFT;
-    short* fir_start = fir + fir_offset*fir_N;
+    const short* fir_start = fir + fir_offset*fir_stride;
     short* sample_start = sample + sample_index - fir_N + RINGSIZE;
 
     // Convolution with filter impulse response.
-    int v = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v += sample_start[j]*fir_start[j];
-    }
+    int v = convolve(sample_start, fir_start, fir_stride);
 
     v >>= FIR_SHIFT;
 
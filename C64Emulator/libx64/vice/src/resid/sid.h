@@ -47,6 +47,9 @@ public:
 			       double filter_scale = 0.97);
   void adjust_sampling_frequency(double sample_freq);
 
+  // Directory for keeping FIR tables across runs, or 0 for none.
+  static void set_fir_cache_dir(const char* dir);
+
   void clock();
   void clock(cycle_count delta_t);
   int clock(cycle_count& delta_t, short* buf, int n, int interleave = 1);
@@ -98,6 +101,25 @@ public:
 
  protected:
   static double I0(double x);
+
+  // FIR tables shared by all SID instances with the same sampling
+  // parameters.
+  struct fir_table_t;
+  static fir_table_t* fir_table_get(double clock_freq, sampling_method method,
+				    double sample_freq, double pass_freq,
+				    double filter_scale);
+  static void fir_table_release(fir_table_t* table);
+  static void fir_table_calculate(fir_table_t* table);
+  static char* fir_table_path(fir_table_t* table);
+  static bool fir_table_load(fir_table_t* table);
+  static void fir_table_store(fir_table_t* table);
+  static void fir_table_free(fir_table_t* table);
+
+  bool filter_unchanged(const Filter& filter_prev);
+  bool extfilt_unchanged(const ExternalFilter& extfilt_prev);
+  cycle_count clock_block_span(cycle_count n);
+  void clock_block(cycle_count n, short* buf);
+  void clock_ring(cycle_count n);
   int clock_fast(cycle_count& delta_t, short* buf, int n, int interleave);
   int clock_interpolate(cycle_count& delta_t, short* buf, int n,
 			int interleave);
@@ -134,6 +156,9 @@ public:
     FIR_RES = 285,
     FIR_RES_FASTMEM = 51473,
     FIR_SHIFT = 15,
+    // FIR tables are padded to a whole number of vectors of this many
+    // samples, and aligned to as many bytes as it takes.
+    FIR_ALIGN = 16,
 
     RINGSIZE = 1 << 14,
     RINGMASK = RINGSIZE - 1,
@@ -151,12 +176,22 @@ public:
   short sample_prev, sample_now;
   int fir_N;
   int fir_RES;
+  // fir_N rounded up to a multiple of FIR_ALIGN.
+  int fir_stride;
 
-  // Ring buffer with overflow for contiguous storage of RINGSIZE samples.
+  // Ring buffer with overflow for contiguous storage of RINGSIZE samples,
+  // followed by FIR_ALIGN samples read by the zero padding of the tables.
   short* sample;
 
-  // FIR_RES filter tables (FIR_N*FIR_RES).
-  short* fir;
+  // FIR_RES filter tables (fir_stride*FIR_RES), aligned to FIR_ALIGN
+  // samples, from the shared table cache.
+  const short* fir;
+  fir_table_t* fir_table;
+  static fir_table_t* fir_tables;
+  static char* fir_cache_dir;
+
+  // Convolution kernel for the host CPU.
+  int (*convolve)(const short* a, const short* b, int n);
 };
 
 
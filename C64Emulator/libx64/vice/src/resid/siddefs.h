@@ -29,6 +29,21 @@
 #define HAVE_BOOL 1
 #define HAVE_BUILTIN_EXPECT 1
 
+// SSE2 and AVX2 convolution kernels, chosen at run time by the features of
+// the host CPU.  They need the target attribute of GCC or Clang.
+#if (defined(__i386__) || defined(__x86_64__)) && (defined(__clang__) || __GNUC__ >= 5)
+#define RESID_USE_SIMD 1
+#else
+#define RESID_USE_SIMD 0
+#endif
+
+// FIR table files are mapped into memory on systems with mmap().
+#if defined(__unix__) || defined(__APPLE__)
+#define RESID_USE_MMAP 1
+#else
+#define RESID_USE_MMAP 0
+#endif
+
 // Define bool, true, and false for C++ compilers that lack these keywords.
 #if !HAVE_BOOL
 typedef int bool;
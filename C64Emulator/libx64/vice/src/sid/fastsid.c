@@ -48,6 +48,17 @@
 
 #include "fixpoint.h"
 
+/* SSE2 and AVX2 kernels for filtering and mixing, chosen at run time by
+   the features of the host CPU.  They need the target attribute of GCC or
+   Clang.  */
+#if (defined(__i386__) || defined(__x86_64__)) \
+    && (defined(__clang__) || __GNUC__ >= 5)
+#define FASTSID_USE_SIMD 1
+#include <immintrin.h>
+#else
+#define FASTSID_USE_SIMD 0
+#endif
+
 #ifndef TRUE
 #define TRUE 1
 #endif
@@ -637,95 +648,447 @@ inline static void setup_voice(voice_t *pv)
     pv->gateflip = 0;
 }
 
-static SWORD fastsid_calculate_single_sample(sound_t *psid, int i)
+/* Samples are calculated in blocks: each stage runs over the whole block
+   for one voice at a time, so that the per-sample work is a tight loop
+   the compiler can keep in registers (or vectorise), instead of walking
+   every stage of every voice for each single sample.  */
+#define FASTSID_BLOCK 256
+
+/* addfptrs, noise & hard sync test */
+static void fastsid_osc_block(sound_t *psid, DWORD f[3][FASTSID_BLOCK],
+                              DWORD rv[3][FASTSID_BLOCK], int n)
 {
-    DWORD o0, o1, o2;
-    int dosync1, dosync2;
-    voice_t *v0, *v1, *v2;
+    voice_t *v0 = &psid->v[0];
+    voice_t *v1 = &psid->v[1];
+    voice_t *v2 = &psid->v[2];
+    int i, k;
+
+    /* Without hard sync the voices do not depend on each other.  */
+    if (!v0->sync && !v1->sync && !v2->sync) {
+        for (k = 0; k < 3; k++) {
+            voice_t *pv = &psid->v[k];
+            DWORD pf = pv->f, fs = pv->fs, prv = pv->rv;
+
+            for (i = 0; i < n; i++) {
+                if ((pf += fs) < fs) {
+                    prv = NSHIFT(prv, 16);
+                }
+                f[k][i] = pf;
+                rv[k][i] = prv;
+            }
+            pv->f = pf;
+            pv->rv = prv;
+        }
+        return;
+    }
 
-    setup_sid(psid);
-    v0 = &psid->v[0];
-    setup_voice(v0);
-    v1 = &psid->v[1];
-    setup_voice(v1);
-    v2 = &psid->v[2];
-    setup_voice(v2);
-
-    /* addfptrs, noise & hard sync test */
-    dosync1 = 0;
-    if ((v0->f += v0->fs) < v0->fs) {
-        v0->rv = NSHIFT(v0->rv, 16);
-        if (v1->sync)
-            dosync1 = 1;
+    for (i = 0; i < n; i++) {
+        int dosync1, dosync2;
+
+        dosync1 = 0;
+        if ((v0->f += v0->fs) < v0->fs) {
+            v0->rv = NSHIFT(v0->rv, 16);
+            if (v1->sync)
+                dosync1 = 1;
+        }
+        dosync2 = 0;
+        if ((v1->f += v1->fs) < v1->fs) {
+            v1->rv = NSHIFT(v1->rv, 16);
+            if (v2->sync)
+                dosync2 = 1;
+        }
+        if ((v2->f += v2->fs) < v2->fs) {
+            v2->rv = NSHIFT(v2->rv, 16);
+            if (v0->sync) {
+            /* hard sync */
+                v0->rv = NSHIFT(v0->rv, v0->f >> 28);
+                v0->f = 0;
+            }
+        }
+
+        /* hard sync */
+        if (dosync2) {
+            v2->rv = NSHIFT(v2->rv, v2->f >> 28);
+            v2->f = 0;
+        }
+        if (dosync1) {
+            v1->rv = NSHIFT(v1->rv, v1->f >> 28);
+            v1->f = 0;
+        }
+
+        f[0][i] = v0->f;
+        f[1][i] = v1->f;
+        f[2][i] = v2->f;
+        rv[0][i] = v0->rv;
+        rv[1][i] = v1->rv;
+        rv[2][i] = v2->rv;
     }
-    dosync2 = 0;
-    if ((v1->f += v1->fs) < v1->fs) {
-        v1->rv = NSHIFT(v1->rv, 16);
-        if (v2->sync)
-            dosync2 = 1;
+}
+
+/* step the adsr counter of one sample */
+#define ADSR_STEP(pv, adsr, adsrs, adsrz)                   \
+    do {                                                    \
+        adsr += adsrs;                                      \
+        if (adsr + 0x80000000 < adsrz + 0x80000000) {       \
+            pv->adsr = adsr;                                \
+            trigger_adsr(pv);                               \
+            adsr = pv->adsr;                                \
+            adsrs = (DWORD)pv->adsrs;                       \
+            adsrz = pv->adsrz;                              \
+        }                                                   \
+    } while (0)
+
+/* adsr and oscillator output of one voice; `fprev' is the counter of the
+   previous voice, which ring modulates this one.  A silent envelope gives
+   0 whatever the waveform, so the waveform is multiplied in
+   unconditionally.  */
+static void fastsid_voice_block(voice_t *pv, const DWORD *f,
+                                const DWORD *fprev, const DWORD *rv,
+                                DWORD *o, int n)
+{
+    DWORD adsr = pv->adsr;
+    DWORD adsrs = (DWORD)pv->adsrs;
+    DWORD adsrz = pv->adsrz;
+    int i;
+
+#ifdef WAVETABLES
+    if (pv->noise) {
+        for (i = 0; i < n; i++) {
+            ADSR_STEP(pv, adsr, adsrs, adsrz);
+            o[i] = (adsr >> 16)
+                   * (((DWORD)NVALUE(NSHIFT(rv[i], f[i] >> 28))) << 7);
+        }
+    } else {
+        const WORD *wt = pv->wt;
+        const WORD *wtr = pv->wtr;
+        DWORD wtpf = pv->wtpf;
+        DWORD wtl = pv->wtl;
+
+        for (i = 0; i < n; i++) {
+            ADSR_STEP(pv, adsr, adsrs, adsrz);
+            o[i] = (adsr >> 16)
+                   * (wt[(f[i] + wtpf) >> wtl] ^ wtr[fprev[i] >> 31]);
+        }
     }
-    if ((v2->f += v2->fs) < v2->fs) {
-        v2->rv = NSHIFT(v2->rv, 16);
-        if (v0->sync) {
-        /* hard sync */
-            v0->rv = NSHIFT(v0->rv, v0->f >> 28);
-            v0->f = 0;
+#else
+    {
+        DWORD pf = pv->f, pprevf = pv->vprev->f, prv = pv->rv;
+
+        for (i = 0; i < n; i++) {
+            ADSR_STEP(pv, adsr, adsrs, adsrz);
+            o[i] = adsr >> 16;
+            if (o[i]) {
+                pv->f = f[i];
+                pv->vprev->f = fprev[i];
+                pv->rv = rv[i];
+                o[i] *= doosc(pv);
+            }
         }
+        pv->f = pf;
+        pv->vprev->f = pprevf;
+        pv->rv = prv;
     }
+#endif
+    pv->adsr = adsr;
+}
+
+static void fastsid_filter_block_c(sound_t *psid, DWORD o[3][FASTSID_BLOCK],
+                                   int n)
+{
+    int i, k;
 
-    /* hard sync */
-    if (dosync2) {
-        v2->rv = NSHIFT(v2->rv, v2->f >> 28);
-        v2->f = 0;
+    /* The filter of each voice is a chain of dependent operations; doing
+       the voices in turn lets the CPU overlap their chains.  */
+    for (i = 0; i < n; i++) {
+        for (k = 0; k < 3; k++) {
+            voice_t *pv = &psid->v[k];
+
+            pv->filtIO = ampMod1x8[(o[k][i] >> 22)];
+            dofilter(pv);
+            o[k][i] = ((DWORD)(pv->filtIO) + 0x80) << (7 + 15);
+        }
     }
-    if (dosync1) {
-        v1->rv = NSHIFT(v1->rv, v1->f >> 28);
-        v1->f = 0;
+}
+
+static void fastsid_mix_block_c(SWORD *pbuf, DWORD o[3][FASTSID_BLOCK],
+                                int n, int vol)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        pbuf[i] = (SWORD)(((SDWORD)((o[0][i] + o[1][i] + o[2][i]) >> 20)
+                  - 0x600) * vol);
+    }
+}
+
+#if FASTSID_USE_SIMD
+
+#ifndef FIXPOINT_ARITHMETIC
+/* The filter feeds each sample back into the next one, so it cannot run
+   across the block; instead the three voices are filtered side by side in
+   one vector (the fourth lane is unused).  Every operation matches the
+   float arithmetic of dofilter() exactly: the double precision multiply of
+   the band pass, the integer division of filtIO, and the expansion of the
+   unparenthesized REAL_MULT() in the feedback of the high and band pass,
+   which scales only the resonance term by filterDy.  */
+__attribute__((target("sse2")))
+static void fastsid_filter_block_sse2(sound_t *psid,
+                                      DWORD o[3][FASTSID_BLOCK], int n)
+{
+    voice_t *v = psid->v;
+    int type = psid->filterType;
+    __m128i filter = _mm_setr_epi32(v[0].filter ? -1 : 0,
+                                    v[1].filter ? -1 : 0,
+                                    v[2].filter ? -1 : 0, 0);
+    __m128 low = _mm_setr_ps(v[0].filtLow, v[1].filtLow, v[2].filtLow, 0);
+    __m128 ref = _mm_setr_ps(v[0].filtRef, v[1].filtRef, v[2].filtRef, 0);
+    __m128 dy = _mm_set1_ps(psid->filterDy);
+    __m128 resdy = _mm_set1_ps(psid->filterResDy);
+    __m128 quarter = _mm_set1_ps(0.25f);
+    __m128 minval = _mm_set1_ps(-128.0f);
+    __m128 maxval = _mm_set1_ps(127.0f);
+    __m128d tenth = _mm_set1_pd(0.1);
+    __m128i bias = _mm_set1_epi32(0x80);
+    __m128i io = _mm_setzero_si128();
+    DWORD out[4];
+    float fl[4], fr[4];
+    int i;
+
+    for (i = 0; i < n; i++) {
+        __m128i in = _mm_setr_epi32(ampMod1x8[o[0][i] >> 22],
+                                    ampMod1x8[o[1][i] >> 22],
+                                    ampMod1x8[o[2][i] >> 22], 0);
+        __m128 newlow, newref, sample, sample2;
+        __m128i res;
+
+        switch (type) {
+          case 0x00:
+            res = _mm_setzero_si128();
+            newlow = low;
+            newref = ref;
+            break;
+          case 0x20:
+            newlow = _mm_add_ps(low, _mm_mul_ps(ref, dy));
+            newref = _mm_add_ps(ref, _mm_sub_ps(_mm_sub_ps(
+                     _mm_cvtepi32_ps(in), newlow),
+                     _mm_mul_ps(_mm_mul_ps(ref, resdy), dy)));
+            /* dividing by 4 is exact, as is multiplying by 1/4 */
+            res = _mm_cvttps_epi32(_mm_sub_ps(newref,
+                                              _mm_mul_ps(newlow, quarter)));
+            break;
+          case 0x40:
+            {
+                __m128 t = _mm_mul_ps(ref, dy);
+                __m128d tlo = _mm_mul_pd(_mm_cvtps_pd(t), tenth);
+                __m128d thi = _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(t, t)),
+                                         tenth);
+                __m128i div8;
+
+                newlow = _mm_add_ps(low, _mm_movelh_ps(_mm_cvtpd_ps(tlo),
+                                                       _mm_cvtpd_ps(thi)));
+                newref = _mm_add_ps(ref, _mm_sub_ps(_mm_sub_ps(
+                         _mm_cvtepi32_ps(in), newlow),
+                         _mm_mul_ps(_mm_mul_ps(ref, resdy), dy)));
+                /* io / 8 rounds towards zero */
+                div8 = _mm_srai_epi32(_mm_add_epi32(in, _mm_and_si128(
+                       _mm_srai_epi32(in, 31), _mm_set1_epi32(7))), 3);
+                sample = _mm_sub_ps(newref, _mm_cvtepi32_ps(div8));
+                /* The operand order keeps a NaN, like the comparisons.  */
+                sample = _mm_max_ps(minval, sample);
+                sample = _mm_min_ps(maxval, sample);
+                res = _mm_cvttps_epi32(sample);
+            }
+            break;
+          default:
+            {
+                __m128i tmp;
+
+                newlow = _mm_add_ps(low, _mm_mul_ps(ref, dy));
+                sample = _mm_cvtepi32_ps(in);
+                sample2 = _mm_sub_ps(sample, newlow);
+                tmp = _mm_cvttps_epi32(sample2);
+                sample2 = _mm_sub_ps(sample2, _mm_mul_ps(ref, resdy));
+                newref = _mm_add_ps(ref, _mm_mul_ps(sample2, dy));
+                if (type == 0x10 || type == 0x30) {
+                    res = _mm_cvttps_epi32(newlow);
+                } else if (type == 0x60) {
+                    res = tmp;
+                } else {
+                    res = _mm_sub_epi32(_mm_cvttps_epi32(sample),
+                                        _mm_srai_epi32(tmp, 1));
+                }
+            }
+            break;
+        }
+
+        /* (signed char) */
+        res = _mm_srai_epi32(_mm_slli_epi32(res, 24), 24);
+
+        /* Voices without filter pass their input; their filter state is
+           left alone below.  */
+        low = newlow;
+        ref = newref;
+        io = _mm_or_si128(_mm_and_si128(filter, res),
+                          _mm_andnot_si128(filter, in));
+
+        _mm_storeu_si128((__m128i *)out,
+                         _mm_slli_epi32(_mm_add_epi32(io, bias), 7 + 15));
+        o[0][i] = out[0];
+        o[1][i] = out[1];
+        o[2][i] = out[2];
+    }
+
+    _mm_storeu_ps(fl, low);
+    _mm_storeu_ps(fr, ref);
+    _mm_storeu_si128((__m128i *)out, io);
+    for (i = 0; i < 3; i++) {
+        if (v[i].filter) {
+            v[i].filtLow = fl[i];
+            v[i].filtRef = fr[i];
+        }
+        if (n > 0) {
+            v[i].filtIO = (signed char)out[i];
+        }
+    }
+}
+#endif
+
+/* The sum of the voices fits 16 bits after the shift, so the volume can be
+   multiplied in 16-bit lanes; the low half of the product is what the
+   cast to SWORD keeps.  */
+__attribute__((target("sse2")))
+static void fastsid_mix_block_sse2(SWORD *pbuf, DWORD o[3][FASTSID_BLOCK],
+                                   int n, int vol)
+{
+    __m128i offset = _mm_set1_epi32(0x600);
+    __m128i mvol = _mm_set1_epi16((short)vol);
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m128i a = _mm_add_epi32(_mm_add_epi32(
+                    _mm_loadu_si128((const __m128i *)&o[0][i]),
+                    _mm_loadu_si128((const __m128i *)&o[1][i])),
+                    _mm_loadu_si128((const __m128i *)&o[2][i]));
+        __m128i b = _mm_add_epi32(_mm_add_epi32(
+                    _mm_loadu_si128((const __m128i *)&o[0][i + 4]),
+                    _mm_loadu_si128((const __m128i *)&o[1][i + 4])),
+                    _mm_loadu_si128((const __m128i *)&o[2][i + 4]));
+
+        a = _mm_sub_epi32(_mm_srli_epi32(a, 20), offset);
+        b = _mm_sub_epi32(_mm_srli_epi32(b, 20), offset);
+        a = _mm_packs_epi32(a, b);
+        _mm_storeu_si128((__m128i *)&pbuf[i], _mm_mullo_epi16(a, mvol));
+    }
+    for (; i < n; i++) {
+        pbuf[i] = (SWORD)(((SDWORD)((o[0][i] + o[1][i] + o[2][i]) >> 20)
+                  - 0x600) * vol);
+    }
+}
+
+__attribute__((target("avx2")))
+static void fastsid_mix_block_avx2(SWORD *pbuf, DWORD o[3][FASTSID_BLOCK],
+                                   int n, int vol)
+{
+    __m256i offset = _mm256_set1_epi32(0x600);
+    __m256i mvol = _mm256_set1_epi16((short)vol);
+    int i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m256i a = _mm256_add_epi32(_mm256_add_epi32(
+                    _mm256_loadu_si256((const __m256i *)&o[0][i]),
+                    _mm256_loadu_si256((const __m256i *)&o[1][i])),
+                    _mm256_loadu_si256((const __m256i *)&o[2][i]));
+        __m256i b = _mm256_add_epi32(_mm256_add_epi32(
+                    _mm256_loadu_si256((const __m256i *)&o[0][i + 8]),
+                    _mm256_loadu_si256((const __m256i *)&o[1][i + 8])),
+                    _mm256_loadu_si256((const __m256i *)&o[2][i + 8]));
+
+        a = _mm256_sub_epi32(_mm256_srli_epi32(a, 20), offset);
+        b = _mm256_sub_epi32(_mm256_srli_epi32(b, 20), offset);
+        /* packs works within 128-bit lanes */
+        a = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8);
+        _mm256_storeu_si256((__m256i *)&pbuf[i], _mm256_mullo_epi16(a, mvol));
+    }
+    for (; i < n; i++) {
+        pbuf[i] = (SWORD)(((SDWORD)((o[0][i] + o[1][i] + o[2][i]) >> 20)
+                  - 0x600) * vol);
+    }
+}
+
+#endif
+
+static void (*fastsid_filter_block)(sound_t *psid,
+                                    DWORD o[3][FASTSID_BLOCK], int n)
+    = fastsid_filter_block_c;
+static void (*fastsid_mix_block)(SWORD *pbuf, DWORD o[3][FASTSID_BLOCK],
+                                 int n, int vol)
+    = fastsid_mix_block_c;
+
+/* pick the fastest kernels the host CPU supports */
+static void fastsid_init_kernels(void)
+{
+#if FASTSID_USE_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+#ifndef FIXPOINT_ARITHMETIC
+        fastsid_filter_block = fastsid_filter_block_sse2;
+#endif
+        fastsid_mix_block = fastsid_mix_block_sse2;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        fastsid_mix_block = fastsid_mix_block_avx2;
+    }
+#endif
+}
+
+/* calculate up to FASTSID_BLOCK samples into pbuf */
+static void fastsid_calculate_block(sound_t *psid, SWORD *pbuf, int n)
+{
+    DWORD f[3][FASTSID_BLOCK];
+    DWORD rv[3][FASTSID_BLOCK];
+    DWORD o[3][FASTSID_BLOCK];
+    int k;
+
+    /* Registers only change between calls, so once per block is enough.  */
+    setup_sid(psid);
+    for (k = 0; k < 3; k++) {
+        setup_voice(&psid->v[k]);
+    }
+
+    fastsid_osc_block(psid, f, rv, n);
+
+    for (k = 0; k < 3; k++) {
+        fastsid_voice_block(&psid->v[k], f[k], f[(k + 2) % 3], rv[k], o[k],
+                            n);
+    }
+    if (!psid->has3) {
+        memset(o[2], 0, n * sizeof(DWORD));
     }
 
-    /* do adsr */
-    if ((v0->adsr += v0->adsrs) + 0x80000000 < v0->adsrz + 0x80000000)
-        trigger_adsr(v0);
-    if ((v1->adsr += v1->adsrs) + 0x80000000 < v1->adsrz + 0x80000000)
-        trigger_adsr(v1);
-    if ((v2->adsr += v2->adsrs) + 0x80000000 < v2->adsrz + 0x80000000)
-        trigger_adsr(v2);
-
-    /* oscillators */
-    o0 = v0->adsr >> 16;
-    o1 = v1->adsr >> 16;
-    o2 = v2->adsr >> 16;
-    if (o0)
-        o0 *= doosc(v0);
-    if (o1)
-        o1 *= doosc(v1);
-    if (psid->has3 && o2)
-        o2 *= doosc(v2);
-    else
-        o2 = 0;
     /* sample */
     if (psid->emulatefilter) {
-        v0->filtIO = ampMod1x8[(o0 >> 22)];
-        dofilter(v0);
-        o0 = ((DWORD)(v0->filtIO) + 0x80) << (7 + 15);
-        v1->filtIO = ampMod1x8[(o1 >> 22)];
-        dofilter(v1);
-        o1 = ((DWORD)(v1->filtIO) + 0x80) << (7 + 15);
-        v2->filtIO = ampMod1x8[(o2 >> 22)];
-        dofilter(v2);
-        o2 = ((DWORD)(v2->filtIO) + 0x80) << (7 + 15);
+        fastsid_filter_block(psid, o, n);
     }
 
-    return (SWORD)(((SDWORD)((o0 + o1 + o2) >> 20) - 0x600) * psid->vol);
+    fastsid_mix_block(pbuf, o, n, psid->vol);
 }
 
 static int fastsid_calculate_samples(sound_t *psid, SWORD *pbuf, int nr,
                                      int interleave, int *delta_t)
 {
-    int i;
+    SWORD buf[FASTSID_BLOCK];
+    int i, j, n;
 
-    for (i = 0; i < nr; i++) {
-        pbuf[i * interleave] = fastsid_calculate_single_sample(psid, i);
+    for (i = 0; i < nr; i += n) {
+        n = nr - i < FASTSID_BLOCK ? nr - i : FASTSID_BLOCK;
+        if (interleave == 1) {
+            fastsid_calculate_block(psid, pbuf + i, n);
+        } else {
+            fastsid_calculate_block(psid, buf, n);
+            for (j = 0; j < n; j++) {
+                pbuf[(i + j) * interleave] = buf[j];
+            }
+        }
     }
 
     return nr;
@@ -734,10 +1097,16 @@ static int fastsid_calculate_samples(sound_t *psid, SWORD *pbuf, int nr,
 int fastsid_calculate_samples_mix(sound_t *psid, SWORD *pbuf, int nr,
                                   int interleave, int *delta_t)
 {
-    int i;
-
-    for (i = 0; i< nr; i++) {
-        pbuf[i * interleave] = sound_audio_mix(pbuf[i * interleave], fastsid_calculate_single_sample(psid, i));
+    SWORD buf[FASTSID_BLOCK];
+    int i, j, n;
+
+    for (i = 0; i < nr; i += n) {
+        n = nr - i < FASTSID_BLOCK ? nr - i : FASTSID_BLOCK;
+        fastsid_calculate_block(psid, buf, n);
+        for (j = 0; j < n; j++) {
+            pbuf[(i + j) * interleave] =
+                sound_audio_mix(pbuf[(i + j) * interleave], buf[j]);
+        }
     }
 
     return nr;
@@ -837,6 +1206,7 @@ static int fastsid_init(sound_t *psid, int speed, int cycles_per_sec)
         return 0;
 
     init_filter(psid, speed);
+    fastsid_init_kernels();
     setup_sid(psid);
     for (i = 0; i < 3; i++) {
         psid->v[i].vprev = &psid->v[(i + 2) % 3];
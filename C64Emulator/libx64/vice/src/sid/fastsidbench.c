@@ -0,0 +1,363 @@
+/*
+ * fastsidbench.c - fastsid sample generator benchmark.
+ *
+ * Written by
+ *  VICE Project
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The benchmark replays a workload of SID register writes, reads, resets
+   and sample fragments of all sizes on fastsid, once for every
+   combination of filter emulation, SID model and sample rate.  The
+   workload is generated from a fixed seed, so the samples it produces
+   never change unless fastsid does: a checksum of the samples and of the
+   values read back is compared to the one recorded from the original
+   per-sample generator, which makes the benchmark a regression test of
+   the sample generator too.  Voices are mostly playing plain waveforms,
+   with stretches of hard sync, ring modulation, noise, combined waveforms
+   and the test bit in between.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+#include "fastsid.h"
+#include "lib.h"
+#include "maincpu.h"
+#include "sid.h"
+#include "sound.h"
+#include "types.h"
+
+#define BENCH_CYCLES_PER_SEC 985248
+#define BENCH_MAX_FRAGMENT   1200
+
+enum {
+    OP_STORE,
+    OP_READ,
+    OP_RESET,
+    OP_CALCULATE
+};
+
+typedef struct bench_op_s {
+    BYTE op;
+    BYTE addr;
+    BYTE value;
+    BYTE interleave;
+    int nr;
+} bench_op_t;
+
+typedef struct bench_config_s {
+    int filters;
+    int model;
+    int speed;
+    /* checksum of the original per-sample generator */
+    DWORD checksum;
+} bench_config_t;
+
+static bench_config_t configs[] = {
+    { 0, 0, 44100, 0x90de831eU },
+    { 1, 0, 44100, 0x6f774739U },
+    { 0, 1, 44100, 0xf121afbdU },
+    { 1, 1, 44100, 0x72e1c264U },
+    { 0, 0, 22050, 0x30e07822U },
+    { 1, 0, 22050, 0x3c73702dU },
+    { 0, 1, 22050, 0x0d4f5f11U },
+    { 1, 1, 22050, 0xebec73c2U },
+    { 0, 0, 0, 0 }
+};
+
+static bench_op_t *ops = NULL;
+static unsigned int num_ops = 0;
+static unsigned int max_ops = 0;
+static unsigned long num_samples = 0;
+
+static bench_config_t *config;
+
+/* ------------------------------------------------------------------------- */
+
+/* fastsid only needs these few symbols from the rest of the emulator.  */
+
+CLOCK maincpu_clk = 0;
+
+int resources_get_int(const char *name, int *value_return)
+{
+    if (!strcmp(name, "SidFilters")) {
+        *value_return = config->filters;
+        return 0;
+    }
+    if (!strcmp(name, "SidModel")) {
+        *value_return = config->model;
+        return 0;
+    }
+    return -1;
+}
+
+/* There is no sound device, so reads of the oscillator see it at the
+   start of the next fragment.  */
+long sound_sample_position(void)
+{
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static DWORD rnd_state = 0x1234567;
+
+static DWORD bench_random(void)
+{
+    rnd_state = rnd_state * 1103515245 + 12345;
+    return (rnd_state >> 8) & 0xffffff;
+}
+
+static void op_add(BYTE op, BYTE addr, BYTE value, int nr, int interleave)
+{
+    if (num_ops == max_ops) {
+        max_ops = max_ops ? max_ops * 2 : 4096;
+        ops = lib_realloc(ops, max_ops * sizeof(bench_op_t));
+    }
+    ops[num_ops].op = op;
+    ops[num_ops].addr = addr;
+    ops[num_ops].value = value;
+    ops[num_ops].nr = nr;
+    ops[num_ops].interleave = (BYTE)interleave;
+    num_ops++;
+
+    if (op == OP_CALCULATE) {
+        num_samples += (unsigned long)nr;
+    }
+}
+
+static BYTE random_control(int effects)
+{
+    static const BYTE waveforms[] = {
+        0x10, 0x20, 0x40, 0x80, 0x30, 0x50, 0x60, 0x70, 0x00, 0x90, 0xf0
+    };
+    BYTE value;
+
+    value = waveforms[bench_random() % (effects ? 11 : 3)];
+    value |= (BYTE)(bench_random() & 1);
+    if (effects) {
+        if (bench_random() % 4 == 0) {
+            value |= 0x02;
+        }
+        if (bench_random() % 4 == 0) {
+            value |= 0x04;
+        }
+        if (bench_random() % 30 == 0) {
+            value |= 0x08;
+        }
+    }
+    return value;
+}
+
+static void generate_workload(unsigned int fragments)
+{
+    unsigned int i;
+    int effects = 0;
+
+    for (i = 0; i < fragments; i++) {
+        int nr, interleave, writes, k;
+
+        /* switch between plain play and the unusual features */
+        if (bench_random() % 200 == 0) {
+            effects = !effects;
+        }
+
+        writes = (int)(bench_random() % 6);
+        for (k = 0; k < writes; k++) {
+            BYTE addr = (BYTE)(bench_random() % 25);
+            BYTE value = (BYTE)bench_random();
+
+            if (bench_random() % 4 == 0) {
+                addr = 0x18;
+            }
+            if (addr == 0x18) {
+                value = (BYTE)((value & 0x77) | 0x08);
+                if (bench_random() % 8 == 0) {
+                    value |= 0x80;
+                }
+            } else if (addr < 21 && addr % 7 == 4) {
+                value = random_control(effects);
+            }
+            op_add(OP_STORE, addr, value, 0, 0);
+        }
+
+        if (bench_random() % 500 == 0) {
+            op_add(OP_RESET, 0, 0, 0, 0);
+        }
+
+        if (bench_random() % 8 == 0) {
+            nr = 0;
+        } else if (bench_random() % 3 == 0) {
+            nr = 1 + (int)(bench_random() % 8);
+        } else {
+            nr = 1 + (int)(bench_random() % BENCH_MAX_FRAGMENT);
+        }
+        interleave = bench_random() % 3 == 0 ? 2 : 1;
+        op_add(OP_CALCULATE, 0, 0, nr, interleave);
+
+        if (bench_random() % 50 == 0) {
+            op_add(OP_READ, 0x1b, 0, 0, 0);
+            op_add(OP_READ, 0x1c, 0, 0, 0);
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* FNV-1a of the low and high bytes of the values */
+static DWORD checksum_add(DWORD sum, const SWORD *data, int size)
+{
+    int i;
+
+    for (i = 0; i < size; i++) {
+        sum = (sum ^ (BYTE)(data[i] & 0xff)) * 16777619U;
+        sum = (sum ^ (BYTE)((data[i] >> 8) & 0xff)) * 16777619U;
+    }
+    return sum;
+}
+
+/* Replay the workload on a new SID, returning the checksum of what it
+   produced if `check' is set.  */
+static DWORD replay_workload(int check)
+{
+    static SWORD buf[2 * BENCH_MAX_FRAGMENT];
+    BYTE init[32];
+    sound_t *psid;
+    DWORD sum = 2166136261U;
+    unsigned int i;
+    int delta_t = 0;
+
+    memset(init, 0, sizeof(init));
+    maincpu_clk = 0;
+
+    psid = fastsid_hooks.open(init);
+    fastsid_hooks.init(psid, config->speed, BENCH_CYCLES_PER_SEC);
+
+    for (i = 0; i < num_ops; i++) {
+        bench_op_t *op = &ops[i];
+        SWORD value;
+
+        switch (op->op) {
+          case OP_STORE:
+            fastsid_hooks.store(psid, op->addr, op->value);
+            break;
+          case OP_READ:
+            value = fastsid_hooks.read(psid, op->addr);
+            if (check) {
+                sum = checksum_add(sum, &value, 1);
+            }
+            break;
+          case OP_RESET:
+            fastsid_hooks.reset(psid, maincpu_clk);
+            break;
+          case OP_CALCULATE:
+            if (check) {
+                memset(buf, 0x55, op->nr * op->interleave * sizeof(SWORD));
+            }
+            fastsid_hooks.calculate_samples(psid, buf, op->nr,
+                                            op->interleave, &delta_t);
+            if (check) {
+                sum = checksum_add(sum, buf, op->nr * op->interleave);
+            }
+            maincpu_clk += (CLOCK)op->nr * BENCH_CYCLES_PER_SEC
+                           / config->speed;
+            break;
+        }
+    }
+
+    fastsid_hooks.close(psid);
+
+    return sum;
+}
+
+static double bench_time(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static int replay(unsigned int rounds)
+{
+    unsigned int round, mismatches = 0;
+
+    for (config = configs; config->speed; config++) {
+        double start, elapsed;
+        DWORD sum;
+
+        start = bench_time();
+        for (round = 0; round < rounds; round++) {
+            replay_workload(0);
+        }
+        elapsed = bench_time() - start;
+
+        sum = replay_workload(1);
+
+        printf("filters %d, model %d, %5d Hz: %.1f ns/sample, "
+               "checksum %08x%s\n", config->filters, config->model,
+               config->speed,
+               elapsed * 1e9 / ((double)num_samples * (double)rounds),
+               (unsigned int)sum, sum == config->checksum ? "" : " (!)");
+
+        if (sum != config->checksum) {
+            mismatches++;
+        }
+    }
+
+    if (mismatches > 0) {
+        printf("%u configurations did not produce the recorded samples!\n",
+               mismatches);
+        return -1;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void usage(void)
+{
+    printf("Usage: fastsidbench [rounds]\n");
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int rounds = 3;
+
+    if (argc > 1 && argv[1][0] == '-') {
+        usage();
+        return 1;
+    }
+    if (argc > 1) {
+        rounds = (unsigned int)strtoul(argv[1], NULL, 0);
+    }
+
+    generate_workload(20000);
+
+    return replay(rounds) < 0 ? 1 : 0;
+}
@@ -90,6 +90,7 @@ static int resid_init(sound_t *psid, int speed, int cycles_per_sec)
     char model_text[100];
     char method_text[100];
     double passband, gain;
+    const char *fir_cache_dir;
     int filters_enabled, model, sampling, passband_percentage, gain_percentage, filter_bias_mV;
 
     if (resources_get_int("SidFilters", &filters_enabled) < 0) {
@@ -116,6 +117,10 @@ static int resid_init(sound_t *psid, int speed, int cycles_per_sec)
         return 0;
     }
 
+    if (resources_get_string("SidResidFirCacheDir", &fir_cache_dir) < 0) {
+        return 0;
+    }
+
     passband = speed * passband_percentage / 200.0;
     gain = gain_percentage / 100.0;
 
@@ -176,6 +181,8 @@ static int resid_init(sound_t *psid, int speed, int cycles_per_sec)
         break;
     }
 
+    reSID::SID::set_fir_cache_dir(fir_cache_dir);
+
     if (!psid->sid->set_sampling_parameters(cycles_per_sec, method,
                                             speed, passband, gain)) {
         log_warning(LOG_DEFAULT,
@@ -36,6 +36,7 @@
 #include "resources.h"
 #include "sid.h"
 #include "sid-cmdline-options.h"
+#include "sid-log.h"
 #include "sid-resources.h"
 #include "translate.h"
 
@@ -58,6 +59,11 @@ int sid_common_set_engine_model(const char *param, void *extra_param)
     return sid_set_engine_model(engine, model);
 }
 
+static int sid_log_opt(const char *param, void *extra_param)
+{
+    return sid_log_open(param);
+}
+
 static const cmdline_option_t sidengine_cmdline_options[] = {
     { "-sidenginemodel", CALL_FUNCTION, 1,
       sid_common_set_engine_model, NULL, NULL, NULL,
@@ -98,6 +104,11 @@ static const cmdline_option_t resid_cmdline_options[] = {
       USE_PARAM_ID, USE_DESCRIPTION_ID,
       IDCLS_P_NUMBER, IDCLS_RESID_FILTER_BIAS,
       NULL, NULL, },
+    { "-residfircache", SET_RESOURCE, 1,
+      NULL, NULL, "SidResidFirCacheDir", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<path>"), T_("Keep reSID resampling filter tables in this directory (empty: calculate them every time)") },
     { NULL }
 };
 #endif
@@ -132,6 +143,11 @@ static const cmdline_option_t common_cmdline_options[] = {
       USE_PARAM_STRING, USE_DESCRIPTION_ID,
       IDCLS_UNUSED, IDCLS_DISABLE_SID_FILTERS,
       NULL, NULL },
+    { "-sidlog", CALL_FUNCTION, 1,
+      sid_log_opt, NULL, NULL, NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<name>"), T_("Log SID register writes to this file, for rendering with sidrender") },
     { NULL }
 };
 
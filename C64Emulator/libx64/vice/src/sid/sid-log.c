@@ -0,0 +1,204 @@
+/*
+ * sid-log.c - SID register write log.
+ *
+ * Written by
+ *  VICE Project
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The log records every write to the SID registers with its clock, no
+   matter which SID engine (if any) is running.  Only these writes shape
+   the sound, so a log can be rendered to audio later, much faster than
+   real time, by `sidrender' (see arch/unix/headless/sidrender.cc).  */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "archdep.h"
+#include "clkguard.h"
+#include "log.h"
+#include "machine.h"
+#include "maincpu.h"
+#include "resources.h"
+#include "sid-log.h"
+#include "sid-resources.h"
+#include "sid.h"
+#include "types.h"
+
+int sid_log_enabled = 0;
+
+static FILE *sid_log_file = NULL;
+
+/* Clock of the last record; the header is written with the first one.  */
+static CLOCK sid_log_clk;
+static int sid_log_started;
+
+/* Number of SIDs in the current segment.  */
+static int sid_log_chips;
+
+static log_t sid_log = LOG_ERR;
+
+static void sid_log_put_clock(CLOCK clk)
+{
+    CLOCK delta = clk - sid_log_clk;
+
+    while (delta >= 0x80) {
+        fputc((int)(delta & 0x7f) | 0x80, sid_log_file);
+        delta >>= 7;
+    }
+    fputc((int)delta, sid_log_file);
+
+    sid_log_clk = clk;
+}
+
+/* Write registers $00-$18 of every SID at delta clock 0.  */
+static void sid_log_put_registers(CLOCK clk)
+{
+    int chipno, addr;
+
+    for (chipno = 0; chipno < sid_log_chips; chipno++) {
+        BYTE *regs = sid_get_siddata(chipno);
+
+        for (addr = 0; addr <= 0x18; addr++) {
+            sid_log_put_clock(clk);
+            fputc((chipno << 5) | addr, sid_log_file);
+            fputc(regs[addr], sid_log_file);
+        }
+    }
+}
+
+static void clk_overflow_callback(CLOCK sub, void *data)
+{
+    if (sid_log_started) {
+        sid_log_clk -= sub;
+    }
+}
+
+static void sid_log_start(CLOCK clk)
+{
+    static int clk_guard_added = 0;
+    BYTE header[SID_LOG_HEADER_SIZE];
+    DWORD cycles_per_sec = (DWORD)machine_get_cycles_per_second();
+    int chips = sid_stereo + 1;
+    int model = 0;
+
+    /* The main CPU clock guard does not exist yet when the log is opened
+       from the command line.  */
+    if (!clk_guard_added) {
+        clk_guard_add_callback(maincpu_clk_guard, clk_overflow_callback, NULL);
+        clk_guard_added = 1;
+    }
+
+    resources_get_int("SidModel", &model);
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, SID_LOG_MAGIC, SID_LOG_MAGIC_LEN);
+    header[8] = SID_LOG_VERSION;
+    header[9] = (BYTE)chips;
+    header[10] = (BYTE)model;
+    header[12] = (BYTE)(cycles_per_sec & 0xff);
+    header[13] = (BYTE)((cycles_per_sec >> 8) & 0xff);
+    header[14] = (BYTE)((cycles_per_sec >> 16) & 0xff);
+    header[15] = (BYTE)((cycles_per_sec >> 24) & 0xff);
+    fwrite(header, 1, sizeof(header), sid_log_file);
+
+    sid_log_clk = clk;
+    sid_log_chips = chips;
+    sid_log_started = 1;
+
+    sid_log_put_registers(clk);
+}
+
+/* Start the log, or a new segment if the clock went back or the number of
+   SIDs changed since the last record.  */
+static void sid_log_sync(CLOCK clk)
+{
+    int chips = sid_stereo + 1;
+
+    if (!sid_log_started) {
+        sid_log_start(clk);
+        return;
+    }
+
+    if (clk >= sid_log_clk && chips == sid_log_chips) {
+        return;
+    }
+
+    sid_log_clk = clk;
+    sid_log_chips = chips;
+
+    sid_log_put_clock(clk);
+    fputc(SID_LOG_EVENT_SEGMENT, sid_log_file);
+    fputc(chips, sid_log_file);
+
+    sid_log_put_registers(clk);
+}
+
+int sid_log_open(const char *filename)
+{
+    sid_log_close();
+
+    if (sid_log == LOG_ERR) {
+        sid_log = log_open("SIDLog");
+    }
+
+    sid_log_file = fopen(filename, MODE_WRITE);
+    if (sid_log_file == NULL) {
+        log_error(sid_log, "Cannot open SID log file `%s'.", filename);
+        return -1;
+    }
+
+    sid_log_started = 0;
+    sid_log_enabled = 1;
+
+    log_message(sid_log, "Logging SID register writes to `%s'.", filename);
+    return 0;
+}
+
+void sid_log_close(void)
+{
+    if (sid_log_file == NULL) {
+        return;
+    }
+
+    fclose(sid_log_file);
+    sid_log_file = NULL;
+    sid_log_enabled = 0;
+}
+
+void sid_log_store(CLOCK clk, int chipno, BYTE addr, BYTE val)
+{
+    sid_log_sync(clk);
+
+    sid_log_put_clock(clk);
+    fputc((chipno << 5) | (addr & 0x1f), sid_log_file);
+    fputc(val, sid_log_file);
+}
+
+void sid_log_reset(CLOCK clk)
+{
+    sid_log_sync(clk);
+
+    sid_log_put_clock(clk);
+    fputc(SID_LOG_EVENT_RESET, sid_log_file);
+}
@@ -0,0 +1,66 @@
+/*
+ * sid-log.h - SID register write log.
+ *
+ * Written by
+ *  VICE Project
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_SID_LOG_H
+#define VICE_SID_LOG_H
+
+#include "types.h"
+
+/* Log file layout (all values little endian):
+
+   header   "VICESID" 0x1a, u8 version, u8 number of SIDs, u8 SidModel,
+            u8 reserved, u32 clock cycles per second
+   record   delta clock, u8 tag, u8 value (register writes only)
+
+   The delta clock is the number of cycles since the previous record,
+   stored 7 bits per byte starting with the lowest, bit 7 set in all but
+   the last byte.  Bits 7-5 of the tag are the SID number and bits 4-0 the
+   register; SID number 7 marks an event.  A log starts with the contents
+   of registers $00-$18 of every SID, written at delta clock 0.
+
+   SID_LOG_EVENT_RESET resets all SIDs.  SID_LOG_EVENT_SEGMENT, followed
+   by a u8 number of SIDs, starts a new segment when the clock went back
+   (a snapshot was loaded) or SIDs were added or removed: the SIDs from
+   that number on are reset, and the registers of the others follow at
+   delta clock 0, like at the start of the log.  */
+
+#define SID_LOG_MAGIC           "VICESID\x1a"
+#define SID_LOG_MAGIC_LEN       8
+#define SID_LOG_VERSION         2
+#define SID_LOG_HEADER_SIZE     16
+
+#define SID_LOG_EVENT           0xe0
+#define SID_LOG_EVENT_RESET     (SID_LOG_EVENT | 0x00)
+#define SID_LOG_EVENT_SEGMENT   (SID_LOG_EVENT | 0x01)
+
+extern int sid_log_enabled;
+
+extern int sid_log_open(const char *filename);
+extern void sid_log_close(void);
+extern void sid_log_store(CLOCK clk, int chipno, BYTE addr, BYTE val);
+extern void sid_log_reset(CLOCK clk);
+
+#endif
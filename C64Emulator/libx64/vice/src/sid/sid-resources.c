@@ -35,16 +35,19 @@
 #endif
 
 #include "hardsid.h"
+#include "lib.h"
 #include "log.h"
 #include "machine.h"
 #ifdef HAVE_PARSID
 #include "parsid.h"
 #endif
 #include "resources.h"
+#include "sid-log.h"
 #include "sid-resources.h"
 #include "sid.h"
 #include "sound.h"
 #include "types.h"
+#include "util.h"
 
 /* Resource handling -- Added by Ettore 98-04-26.  */
 
@@ -60,6 +63,7 @@ static int sid_resid_sampling;
 static int sid_resid_passband;
 static int sid_resid_gain;
 static int sid_resid_filter_bias;
+static char *sid_resid_fir_cache_dir = NULL;
 #endif
 int sid_stereo = 0;
 int checking_sid_stereo;
@@ -268,6 +272,12 @@ static int set_sid_resid_filter_bias(int i, void *param)
     return 0;
 }
 
+static int set_sid_resid_fir_cache_dir(const char *val, void *param)
+{
+    util_string_set(&sid_resid_fir_cache_dir, val);
+    return 0;
+}
+
 #endif
 
 #ifdef HAVE_HARDSID
@@ -330,6 +340,12 @@ static const resource_int_t resid_resources_int[] = {
       &sid_resid_filter_bias, set_sid_resid_filter_bias, NULL },
     { NULL }
 };
+
+static const resource_string_t resid_resources_string[] = {
+    { "SidResidFirCacheDir", "", RES_EVENT_NO, NULL,
+      &sid_resid_fir_cache_dir, set_sid_resid_fir_cache_dir, NULL },
+    { NULL }
+};
 #endif
 
 static const resource_int_t common_resources_int[] = {
@@ -370,6 +386,10 @@ int sid_resources_init(void)
     if (resources_register_int(resid_resources_int) < 0) {
         return -1;
     }
+
+    if (resources_register_string(resid_resources_string) < 0) {
+        return -1;
+    }
 #endif
 
     if (resources_register_int(stereo_resources_int) < 0) {
@@ -379,6 +399,16 @@ int sid_resources_init(void)
     return sid_common_resources_init();
 }
 
+void sid_resources_shutdown(void)
+{
+    sid_log_close();
+
+#if defined(HAVE_RESID) || defined(HAVE_RESID_FP) || defined(HAVE_RESID_DTV)
+    lib_free(sid_resid_fir_cache_dir);
+    sid_resid_fir_cache_dir = NULL;
+#endif
+}
+
 /* ------------------------------------------------------------------------- */
 
 #ifdef SID_SETTINGS_DIALOG
@@ -29,6 +29,7 @@
 
 extern int sid_resources_init(void);
 extern int sid_common_resources_init(void);
+extern void sid_resources_shutdown(void);
 
 extern int sid_set_sid_stereo_address(int val, void *param);
 extern int sid_set_sid_triple_address(int val, void *param);
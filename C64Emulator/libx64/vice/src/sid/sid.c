@@ -32,6 +32,14 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #include "catweaselmkiii.h"
 #include "fastsid.h"
 #include "hardsid.h"
@@ -42,10 +50,12 @@
 #include "parsid.h"
 #endif
 #include "resources.h"
+#include "sid-log.h"
 #include "sid-resources.h"
 #include "sid-snapshot.h"
 #include "sid.h"
 #include "sound.h"
+#include "soundmix.h"
 #include "types.h"
 
 #ifdef HAVE_MOUSE
@@ -75,6 +85,37 @@ static void (*sid_store_func)(WORD addr, BYTE val, int chipno);
 
 static int sid_enable, sid_engine_type = -1;
 
+/* Register writes queued with their clock when several SIDs are emulated
+   with a cycle based engine.  They are applied while the samples are
+   calculated, so the chips can be run independently.  Every chip is
+   clocked up to each write, also those to the other chips, just like when
+   the sound was run up to the write right away.  */
+typedef struct sid_write_s {
+    CLOCK clk;
+    BYTE chipno;
+    BYTE addr;
+    BYTE val;
+} sid_write_t;
+
+static sid_write_t *sid_queue = NULL;
+static int sid_queue_num = 0;
+static int sid_queue_size = 0;
+
+/* The share of one chip in `sid_sound_machine_calculate_samples()'.  */
+typedef struct sid_render_s {
+    sound_t *psid;
+    int chipno;
+    SWORD *pbuf;
+    int nr;
+    int interleave;
+    CLOCK clk;
+    int delta_t;
+    int result;
+} sid_render_t;
+
+static void sid_workers_start(void);
+static void sid_workers_stop(void);
+
 BYTE *sid_get_siddata(unsigned int channel)
 {
     return siddata[channel];
@@ -169,6 +210,13 @@ static void sid_store_chip(WORD addr, BYTE byte, int chipno)
 {
     addr &= 0x1f;
 
+    if (sid_log_enabled) {
+        if (maincpu_rmw_flag) {
+            sid_log_store(maincpu_clk - 1, chipno, (BYTE)addr, lastsidread);
+        }
+        sid_log_store(maincpu_clk, chipno, (BYTE)addr, byte);
+    }
+
     siddata[chipno][addr] = byte;
 
     /* WARNING: assumes `maincpu_rmw_flag' is 0 or 1.  */
@@ -259,6 +307,10 @@ void sid3_store(WORD addr, BYTE byte)
 
 void sid_reset(void)
 {
+    if (sid_log_enabled) {
+        sid_log_reset(maincpu_clk);
+    }
+
     sound_reset();
 
     memset(siddata, 0, sizeof(siddata));
@@ -288,6 +340,11 @@ sound_t *sid_sound_machine_open(int chipno)
     }
 #endif
 
+    /* The workers only pay off with several cycle based chips.  */
+    if (chipno == 1 && sid_sound_machine_cycle_based()) {
+        sid_workers_start();
+    }
+
     return sid_engine.open(siddata[chipno]);
 }
 
@@ -296,8 +353,49 @@ int sid_sound_machine_init(sound_t *psid, int speed, int cycles_per_sec)
     return sid_engine.init(psid, speed, cycles_per_sec);
 }
 
+static int sid_chip_number(sound_t *psid)
+{
+    unsigned int i;
+
+    for (i = 0; i < SOUND_SIDS_MAX; i++) {
+        if (sound_get_psid(i) == psid) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/* Drop the queued writes to a chip.  */
+static void sid_queue_clear(sound_t *psid)
+{
+    int chipno = sid_chip_number(psid);
+    int i, num = 0;
+
+    for (i = 0; i < sid_queue_num; i++) {
+        if (sid_queue[i].chipno != chipno) {
+            sid_queue[num++] = sid_queue[i];
+        }
+    }
+    sid_queue_num = num;
+}
+
+/* Apply the queued writes right away, when no samples are calculated
+   for them.  */
+static void sid_queue_apply(sound_t **psid)
+{
+    int i;
+
+    for (i = 0; i < sid_queue_num; i++) {
+        sid_engine.store(psid[sid_queue[i].chipno], sid_queue[i].addr,
+                         sid_queue[i].val);
+    }
+    sid_queue_num = 0;
+}
+
 void sid_sound_machine_close(sound_t *psid)
 {
+    sid_workers_stop();
+    sid_queue_clear(psid);
     sid_engine.close(psid);
 }
 
@@ -311,76 +409,331 @@ void sid_sound_machine_store(sound_t *psid, WORD addr, BYTE byte)
     sid_engine.store(psid, addr, byte);
 }
 
+/* Queue a register write, to be applied at `clk' by
+   `sid_sound_machine_calculate_samples()'.  Only done for cycle based
+   engines with more than one SID, as then the chips can be calculated in
+   parallel.  */
+int sid_sound_machine_store_clk(sound_t *psid, WORD addr, BYTE byte, CLOCK clk)
+{
+    int chipno;
+
+    if (!sid_sound_machine_cycle_based() || sound_get_psid(1) == NULL) {
+        return 0;
+    }
+
+    chipno = sid_chip_number(psid);
+    if (chipno < 0) {
+        return 0;
+    }
+
+    if (sid_queue_num == sid_queue_size) {
+        sid_queue_size = sid_queue_size ? sid_queue_size * 2 : 64;
+        sid_queue = lib_realloc(sid_queue, sid_queue_size * sizeof(sid_write_t));
+    }
+    sid_queue[sid_queue_num].clk = clk;
+    sid_queue[sid_queue_num].chipno = (BYTE)chipno;
+    sid_queue[sid_queue_num].addr = (BYTE)addr;
+    sid_queue[sid_queue_num].val = byte;
+    sid_queue_num++;
+
+    return 1;
+}
+
 void sid_sound_machine_reset(sound_t *psid, CLOCK cpu_clk)
 {
+    sid_queue_clear(psid);
     sid_engine.reset(psid, cpu_clk);
 }
 
+/* Calculate the samples of one chip, applying its queued writes at the
+   right cycles on the way.  The queue is only read here, so the chips
+   can be calculated at the same time.  */
+static void sid_render(sid_render_t *job)
+{
+    CLOCK end = job->clk + job->delta_t;
+    SWORD *pbuf = job->pbuf;
+    int nr = job->nr;
+    int i, n, delta_t;
+
+    job->result = 0;
+
+    for (i = 0; i < sid_queue_num; i++) {
+        if (sid_queue[i].clk > job->clk) {
+            delta_t = (int)(sid_queue[i].clk - job->clk);
+            n = sid_engine.calculate_samples(job->psid, pbuf, nr,
+                                             job->interleave, &delta_t);
+            pbuf += n * job->interleave;
+            nr -= n;
+            job->result += n;
+            job->clk = sid_queue[i].clk;
+        }
+        if (sid_queue[i].chipno == job->chipno) {
+            sid_engine.store(job->psid, sid_queue[i].addr, sid_queue[i].val);
+        }
+    }
+
+    delta_t = (end > job->clk) ? (int)(end - job->clk) : 0;
+    job->result += sid_engine.calculate_samples(job->psid, pbuf, nr,
+                                                job->interleave, &delta_t);
+    job->delta_t = delta_t;
+}
+
+#ifdef HAVE_PTHREAD_H
+/* Worker threads calculating the second and third SID, only started on
+   hosts with more than one processor.  They run from when the sound
+   opens several SIDs with a cycle based engine until it closes.  */
+typedef struct sid_worker_s {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    sid_render_t *job;
+    int stop;
+} sid_worker_t;
+
+static sid_worker_t sid_workers[SOUND_SIDS_MAX - 1];
+
+/* Number of running workers.  */
+static int sid_workers_num = 0;
+
+static void *sid_worker_main(void *arg)
+{
+    sid_worker_t *worker = (sid_worker_t *)arg;
+
+    pthread_mutex_lock(&worker->lock);
+    while (1) {
+        while (worker->job == NULL && !worker->stop) {
+            pthread_cond_wait(&worker->cond, &worker->lock);
+        }
+        if (worker->stop) {
+            break;
+        }
+        pthread_mutex_unlock(&worker->lock);
+
+        sid_render(worker->job);
+
+        pthread_mutex_lock(&worker->lock);
+        worker->job = NULL;
+        pthread_cond_broadcast(&worker->cond);
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return NULL;
+}
+#endif
+
+static void sid_workers_start(void)
+{
+#ifdef HAVE_PTHREAD_H
+    int i;
+
+    if (sid_workers_num > 0) {
+        return;
+    }
+
+#ifdef _SC_NPROCESSORS_ONLN
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+        return;
+    }
+#else
+    return;
+#endif
+
+    for (i = 0; i < SOUND_SIDS_MAX - 1; i++) {
+        sid_worker_t *worker = &sid_workers[i];
+
+        worker->job = NULL;
+        worker->stop = 0;
+        pthread_mutex_init(&worker->lock, NULL);
+        pthread_cond_init(&worker->cond, NULL);
+        if (pthread_create(&worker->thread, NULL, sid_worker_main, worker) != 0) {
+            pthread_cond_destroy(&worker->cond);
+            pthread_mutex_destroy(&worker->lock);
+            break;
+        }
+        sid_workers_num++;
+    }
+#endif
+}
+
+/* Stop the workers and wait for them to end.  No job is running, as the
+   jobs are only handed out and waited for within a call of
+   `sid_sound_machine_calculate_samples()'.  */
+static void sid_workers_stop(void)
+{
+#ifdef HAVE_PTHREAD_H
+    int i;
+
+    for (i = 0; i < sid_workers_num; i++) {
+        sid_worker_t *worker = &sid_workers[i];
+
+        pthread_mutex_lock(&worker->lock);
+        worker->stop = 1;
+        pthread_cond_broadcast(&worker->cond);
+        pthread_mutex_unlock(&worker->lock);
+
+        pthread_join(worker->thread, NULL);
+        pthread_cond_destroy(&worker->cond);
+        pthread_mutex_destroy(&worker->lock);
+    }
+    sid_workers_num = 0;
+#endif
+}
+
+/* Calculate `num' chips, the first one by the caller and the others on
+   the worker threads if there are any.  */
+static void sid_render_all(sid_render_t *jobs, int num)
+{
+    int i;
+#ifdef HAVE_PTHREAD_H
+    int workers = 0;
+
+    if (num > 1) {
+        workers = sid_workers_num;
+        if (workers > num - 1) {
+            workers = num - 1;
+        }
+    }
+
+    for (i = 0; i < workers; i++) {
+        pthread_mutex_lock(&sid_workers[i].lock);
+        sid_workers[i].job = &jobs[i + 1];
+        pthread_cond_broadcast(&sid_workers[i].cond);
+        pthread_mutex_unlock(&sid_workers[i].lock);
+    }
+
+    sid_render(&jobs[0]);
+    for (i = workers + 1; i < num; i++) {
+        sid_render(&jobs[i]);
+    }
+
+    for (i = 0; i < workers; i++) {
+        pthread_mutex_lock(&sid_workers[i].lock);
+        while (sid_workers[i].job != NULL) {
+            pthread_cond_wait(&sid_workers[i].cond, &sid_workers[i].lock);
+        }
+        pthread_mutex_unlock(&sid_workers[i].lock);
+    }
+#else
+    for (i = 0; i < num; i++) {
+        sid_render(&jobs[i]);
+    }
+#endif
+}
+
+static void sid_render_setup(sid_render_t *job, sound_t **psid, int chipno,
+                             SWORD *pbuf, int nr, int interleave, int delta_t)
+{
+    job->psid = psid[chipno];
+    job->chipno = chipno;
+    job->pbuf = pbuf;
+    job->nr = nr;
+    job->interleave = interleave;
+    job->clk = maincpu_clk - delta_t;
+    job->delta_t = delta_t;
+    job->result = 0;
+}
+
 int sid_sound_machine_calculate_samples(sound_t **psid, SWORD *pbuf, int nr, int soc, int scc, int *delta_t)
 {
     int i;
-    SWORD *tmp_buf1;
-    SWORD *tmp_buf2;
+    SWORD *tmp_buf1 = NULL;
+    SWORD *tmp_buf2 = NULL;
+    sid_render_t jobs[SOUND_SIDS_MAX];
+    sid_render_t *last;
     int tmp_nr = 0;
-    int tmp_delta_t = *delta_t;
 
+    /* Nothing is calculated for other combinations of channels, e.g. with
+       the dummy device, but the queue must not grow.  */
+    if (soc < 1 || soc > 2 || scc < 1 || scc > 3) {
+        sid_queue_apply(psid);
+        return 0;
+    }
+
+    /* The first job is the chip whose sample count and remaining cycles
+       are returned.  */
     if (soc == 1 && scc == 1) {
-        return sid_engine.calculate_samples(psid[0], pbuf, nr, 1, delta_t);
+        sid_render_setup(&jobs[0], psid, 0, pbuf, nr, 1, *delta_t);
     }
     if (soc == 1 && scc == 2) {
         tmp_buf1 = lib_malloc(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[0], tmp_buf1, nr, 1, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf, nr, 1, delta_t);
-        for (i = 0; i < tmp_nr; i++) {
-            pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf1[i]);
-        }
-        lib_free(tmp_buf1);
-        return tmp_nr;
+        sid_render_setup(&jobs[0], psid, 1, pbuf, nr, 1, *delta_t);
+        sid_render_setup(&jobs[1], psid, 0, tmp_buf1, nr, 1, *delta_t);
     }
     if (soc == 1 && scc == 3) {
         tmp_buf1 = lib_malloc(2 * nr);
         tmp_buf2 = lib_malloc(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[0], tmp_buf1, nr, 1, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf2, nr, 1, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf, nr, 1, delta_t);
-        for (i = 0; i < tmp_nr; i++) {
-            pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf1[i]);
-            pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf2[i]);
-        }
-        lib_free(tmp_buf1);
-        lib_free(tmp_buf2);
-        return tmp_nr;
+        sid_render_setup(&jobs[0], psid, 1, pbuf, nr, 1, *delta_t);
+        sid_render_setup(&jobs[1], psid, 0, tmp_buf1, nr, 1, *delta_t);
+        sid_render_setup(&jobs[2], psid, 2, tmp_buf2, nr, 1, *delta_t);
     }
     if (soc == 2 && scc == 1) {
-        tmp_nr = sid_engine.calculate_samples(psid[0], pbuf, nr, 2, delta_t);
+        sid_render_setup(&jobs[0], psid, 0, pbuf, nr, 2, *delta_t);
+    }
+    if (soc == 2 && scc == 2) {
+        sid_render_setup(&jobs[0], psid, 1, pbuf + 1, nr, 2, *delta_t);
+        sid_render_setup(&jobs[1], psid, 0, pbuf, nr, 2, *delta_t);
+    }
+    if (soc == 2 && scc == 3) {
+        tmp_buf1 = lib_malloc(4 * nr);
+        sid_render_setup(&jobs[0], psid, 1, pbuf + 1, nr, 2, *delta_t);
+        sid_render_setup(&jobs[1], psid, 0, pbuf, nr, 2, *delta_t);
+        sid_render_setup(&jobs[2], psid, 2, tmp_buf1, nr, 2, *delta_t);
+    }
+
+    sid_render_all(jobs, scc);
+    sid_queue_num = 0;
+
+    last = &jobs[0];
+    tmp_nr = last->result;
+    *delta_t = last->delta_t;
+
+    if (soc == 2 && scc == 1) {
         for (i = 0; i < tmp_nr; i++) {
             pbuf[(i * 2) + 1] = pbuf[i * 2];
         }
-        return tmp_nr;
-    }
-    if (soc == 2 && scc == 2) {
-        tmp_nr = sid_engine.calculate_samples(psid[0], pbuf, nr, 2, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf + 1, nr, 2, delta_t);
-        return tmp_nr;
     }
+    /* the third SID goes to both sides */
     if (soc == 2 && scc == 3) {
-        tmp_buf1 = lib_malloc(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf1, nr, 1, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[0], pbuf, nr, 2, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf + 1, nr, 2, delta_t);
         for (i = 0; i < tmp_nr; i++) {
-            pbuf[i * 2] = sound_audio_mix(pbuf[i * 2], tmp_buf1[i]);
-            pbuf[(i * 2) + 1] = sound_audio_mix(pbuf[(i * 2) + 1], tmp_buf1[i]);
+            tmp_buf1[(i * 2) + 1] = tmp_buf1[i * 2];
+        }
+    }
+
+    /* SIDs sharing a channel are summed like the other sound chips */
+    if (tmp_buf1 != NULL) {
+        sound_mix_source_t src[SOUND_SIDS_MAX];
+        int sources = 0;
+
+        src[sources].buf = pbuf;
+        src[sources].gain[0] = src[sources].gain[1] = SOUND_MIX_UNITY;
+        sources++;
+        src[sources].buf = tmp_buf1;
+        src[sources].gain[0] = src[sources].gain[1] = SOUND_MIX_UNITY;
+        sources++;
+        if (tmp_buf2 != NULL) {
+            src[sources].buf = tmp_buf2;
+            src[sources].gain[0] = src[sources].gain[1] = SOUND_MIX_UNITY;
+            sources++;
         }
-        lib_free(tmp_buf1);
+        sound_chip_clipped(sound_mix(pbuf, src, sources, tmp_nr, soc));
     }
+
+    lib_free(tmp_buf1);
+    lib_free(tmp_buf2);
+
     return tmp_nr;
 }
 
 void sid_sound_machine_prevent_clk_overflow(sound_t *psid, CLOCK sub)
 {
+    int i;
+
+    /* Called once per chip, so only the first one adjusts the queue.  */
+    if (psid == sound_get_psid(0)) {
+        for (i = 0; i < sid_queue_num; i++) {
+            sid_queue[i].clk = (sid_queue[i].clk > sub) ? sid_queue[i].clk - sub : 0;
+        }
+    }
+
     sid_engine.prevent_clk_overflow(psid, sub);
 }
 
@@ -547,6 +900,7 @@ void sid_state_read(unsigned int channel, sid_snapshot_state_t *sid_state)
 
 void sid_state_write(unsigned int channel, sid_snapshot_state_t *sid_state)
 {
+    sid_queue_clear(sound_get_psid(channel));
     sid_engine.state_write(sound_get_psid(channel), sid_state);
 }
 
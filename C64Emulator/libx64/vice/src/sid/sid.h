@@ -140,6 +140,7 @@ extern int sid_sound_machine_init(sound_t *psid, int speed, int cycles_per_sec);
 extern void sid_sound_machine_close(sound_t *psid);
 extern BYTE sid_sound_machine_read(sound_t *psid, WORD addr);
 extern void sid_sound_machine_store(sound_t *psid, WORD addr, BYTE byte);
+extern int sid_sound_machine_store_clk(sound_t *psid, WORD addr, BYTE byte, CLOCK clk);
 extern void sid_sound_machine_reset(sound_t *psid, CLOCK cpu_clk);
 extern int sid_sound_machine_calculate_samples(sound_t **psid, SWORD *pbuf, int nr, int sound_output_channels, int sound_chip_channels, int *delta_t);
 extern void sid_sound_machine_prevent_clk_overflow(sound_t *psid, CLOCK sub);
@@ -50,6 +50,7 @@
 #include "maincpu.h"
 #include "resources.h"
 #include "sound.h"
+#include "soundmix.h"
 #include "translate.h"
 #include "types.h"
 #include "uiapi.h"
@@ -75,11 +76,21 @@ static WORD offset = 0;
 
 static sound_chip_t *sound_calls[20];
 
+/* gain in percent and balance of each chip */
+static int sound_chip_gain[20];
+static int sound_chip_pan[20];
+
+/* buffers of the chips but the first one, which calculates its samples
+   right into the output */
+static SWORD *sound_chip_buffer[20];
+
 WORD sound_chip_register(sound_chip_t *chip)
 {
     assert(chip != NULL);
 
     sound_calls[offset >> 5] = chip;
+    sound_chip_gain[offset >> 5] = 100;
+    sound_chip_pan[offset >> 5] = 0;
     offset += 0x20;
 
     assert((offset >> 5) < 20);
@@ -87,6 +98,24 @@ WORD sound_chip_register(sound_chip_t *chip)
     return offset - 0x20;
 }
 
+void sound_chip_set_mix(WORD chip_offset, int gain, int pan)
+{
+    if (gain < 0) {
+        gain = 0;
+    }
+    if (gain > 200) {
+        gain = 200;
+    }
+    if (pan < -100) {
+        pan = -100;
+    }
+    if (pan > 100) {
+        pan = 100;
+    }
+    sound_chip_gain[chip_offset >> 5] = gain;
+    sound_chip_pan[chip_offset >> 5] = pan;
+}
+
 /* ------------------------------------------------------------------------- */
 
 static sound_t *sound_machine_open(int chipno)
@@ -126,7 +155,11 @@ static void sound_machine_close(sound_t *psid)
     }
 }
 
-static int sound_machine_calculate_samples(sound_t **psid, SWORD *pbuf, int nr, int soc, int scc, int *delta_t)
+/* Calculate the samples of the first chip into `pbuf' and those of the
+   others into buffers of their own, setting `bufs[i]' to the buffer of
+   chip `i', or NULL if it is disabled.  They are mixed by
+   sound_mix_chips().  */
+static int sound_machine_calculate_samples(sound_t **psid, SWORD *pbuf, int nr, int soc, int scc, int *delta_t, SWORD **bufs)
 {
     int i;
     int temp;
@@ -135,11 +168,20 @@ static int sound_machine_calculate_samples(sound_t **psid, SWORD *pbuf, int nr,
         temp = sound_calls[0]->calculate_samples(psid, pbuf, nr, soc, scc, delta_t);
     } else {
         temp = nr;
+        memset(pbuf, 0, temp * soc * sizeof(SWORD));
     }
+    bufs[0] = pbuf;
 
     for (i = 1; i < (offset >> 5); i++) {
+        bufs[i] = NULL;
         if (sound_calls[i]->chip_enabled) {
-            sound_calls[i]->calculate_samples(psid, pbuf, temp, soc, scc, delta_t);
+            if (sound_chip_buffer[i] == NULL) {
+                sound_chip_buffer[i] = lib_malloc(SOUND_CHANNELS_MAX * SOUND_BUFSIZE * sizeof(SWORD));
+            }
+            /* the chips add their samples to what is in the buffer */
+            memset(sound_chip_buffer[i], 0, temp * soc * sizeof(SWORD));
+            sound_calls[i]->calculate_samples(psid, sound_chip_buffer[i], temp, soc, scc, delta_t);
+            bufs[i] = sound_chip_buffer[i];
         }
     }
     return temp;
@@ -150,6 +192,14 @@ static void sound_machine_store(sound_t *psid, WORD addr, BYTE val)
     sound_calls[addr >> 5]->store(psid,(WORD)(addr & 0x1f), val);
 }
 
+static int sound_machine_store_clk(sound_t *psid, WORD addr, BYTE val, CLOCK clk)
+{
+    if (sound_calls[addr >> 5]->store_clk == NULL) {
+        return 0;
+    }
+    return sound_calls[addr >> 5]->store_clk(psid, (WORD)(addr & 0x1f), val, clk);
+}
+
 static BYTE sound_machine_read(sound_t *psid, WORD addr)
 {
     return sound_calls[addr >> 5]->read(psid, (WORD)(addr & 0x1f));
@@ -209,6 +259,7 @@ static int buffer_size;               /* app_resources.soundBufferSize */
 static int suspend_time;              /* app_resources.soundSuspendTime */
 static int speed_adjustment_setting;  /* app_resources.soundSpeedAdjustment */
 static int volume;
+static int dc_block;
 static int fragment_size;
 static int output_option;
 
@@ -348,6 +399,12 @@ static int set_volume(int val, void *param)
     return 0;
 }
 
+static int set_dc_block(int val, void *param)
+{
+    dc_block = val ? 1 : 0;
+    return 0;
+}
+
 static const resource_string_t resources_string[] = {
     { "SoundDeviceName", "", RES_EVENT_NO, NULL,
       &device_name, set_device_name, NULL },
@@ -377,6 +434,8 @@ static const resource_int_t resources_int[] = {
       (void *)&volume, set_volume, NULL },
     { "SoundOutput", SOUND_OUTPUT_SYSTEM, RES_EVENT_NO, NULL,
       (void *)&output_option, set_output_option, NULL },
+    { "SoundDCBlock", 0, RES_EVENT_NO, NULL,
+      (void *)&dc_block, set_dc_block, NULL },
     { NULL }
 };
 
@@ -461,6 +520,16 @@ static const cmdline_option_t cmdline_options[] = {
       USE_PARAM_STRING, USE_DESCRIPTION_STRING,
       IDCLS_UNUSED, IDCLS_UNUSED, 
       T_("<output mode>"), T_("Sound output mode: (0: system decides mono/stereo, 1: always mono, 2: always stereo") },
+    { "-sounddcblock", SET_RESOURCE, 0,
+      NULL, NULL, "SoundDCBlock", (resource_value_t)1,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Remove the DC offset from the sound output") },
+    { "+sounddcblock", SET_RESOURCE, 0,
+      NULL, NULL, "SoundDCBlock", (resource_value_t)0,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Do not remove the DC offset from the sound output") },
     { NULL }
 };
 
@@ -539,6 +608,13 @@ typedef struct
     /* is the device suspended? */
     int issuspended;
     SWORD lastsample[SOUND_CHANNELS_MAX];
+
+    /* state of the DC blocker */
+    sound_mix_dc_t dc;
+
+    /* samples mixed and clipped since the device was opened */
+    unsigned long mixed;
+    unsigned long clipped;
 } snddata_t;
 
 static snddata_t snddata;
@@ -839,7 +915,10 @@ int sound_open(void)
 
         for (c = 0; c < snddata.sound_output_channels; c++) {
             snddata.lastsample[c] = 0;
+            snddata.dc.level[c] = 0;
         }
+        snddata.mixed = 0;
+        snddata.clipped = 0;
 
         snddata.playdev = pdev;
         snddata.fragsize = fragsize;
@@ -931,7 +1010,13 @@ int sound_open(void)
 /* close sid */
 void sound_close(void)
 {
+    int i;
+
     if (snddata.playdev) {
+        if (snddata.clipped) {
+            log_message(sound_log, "%lu of %lu samples clipped",
+                        snddata.clipped, snddata.mixed);
+        }
         log_message(sound_log, "Closing device `%s'", snddata.playdev->name);
         if (snddata.playdev->close)
             snddata.playdev->close();
@@ -949,6 +1034,11 @@ void sound_close(void)
 
     snddata.prevused = snddata.prevfill = 0;
 
+    for (i = 0; i < 20; i++) {
+        lib_free(sound_chip_buffer[i]);
+        sound_chip_buffer[i] = NULL;
+    }
+
     sdev_open = FALSE;
     sound_state_changed = FALSE;
 
@@ -959,24 +1049,79 @@ void sound_close(void)
     offset = 0;
 }
 
-/* run sid */
-static int sound_run_sound(void)
+/* check that sound is played and the device is open */
+static int sound_ready(void)
 {
-    int nr = 0, i;
-    int delta_t = 0;
-    SWORD *bufferptr;
-    static int overflow_warning_count = 0;
-
     /* XXX: implement the exact ... */
     if (!playback_enabled || (suspend_time > 0 && disabletime)) {
         return 1;
     }
 
     if (!snddata.playdev) {
-        i = sound_open();
-        if (i) {
-            return i;
+        return sound_open();
+    }
+
+    return 0;
+}
+
+void sound_chip_clipped(unsigned int samples)
+{
+    snddata.clipped += samples;
+}
+
+/* run sid */
+/* Mix the `nr' samples the chips calculated into `pbuf', with the volume,
+   their gains and balance, and take the DC offset off if wanted.  */
+static void sound_mix_chips(SWORD **bufs, SWORD *pbuf, int nr)
+{
+    sound_mix_source_t src[SOUND_MIX_SOURCES_MAX];
+    int soc = snddata.sound_output_channels;
+    int i, c, sources = 0, unity = 1;
+
+    for (i = 0; i < (offset >> 5); i++) {
+        int gain, pan;
+
+        if (bufs[i] == NULL) {
+            continue;
         }
+        gain = SOUND_MIX_UNITY * volume / 100 * sound_chip_gain[i] / 100;
+        if (gain > SOUND_MIX_GAIN_MAX) {
+            gain = SOUND_MIX_GAIN_MAX;
+        }
+        pan = soc > 1 ? sound_chip_pan[i] : 0;
+
+        src[sources].buf = bufs[i];
+        src[sources].gain[0] = pan > 0 ? gain * (100 - pan) / 100 : gain;
+        src[sources].gain[1] = pan < 0 ? gain * (100 + pan) / 100 : gain;
+        for (c = 0; c < soc; c++) {
+            if (src[sources].gain[c] != SOUND_MIX_UNITY) {
+                unity = 0;
+            }
+        }
+        sources++;
+    }
+
+    /* nothing to do for a single chip at full volume */
+    if (sources > 1 || !unity) {
+        snddata.clipped += sound_mix(pbuf, src, sources, nr, soc);
+    }
+    if (dc_block) {
+        snddata.clipped += sound_mix_dc_block(&snddata.dc, pbuf, nr, soc);
+    }
+    snddata.mixed += (unsigned long)(nr * soc);
+}
+
+static int sound_run_sound(void)
+{
+    int nr = 0, i;
+    int delta_t = 0;
+    SWORD *bufferptr;
+    SWORD *bufs[20];
+    static int overflow_warning_count = 0;
+
+    i = sound_ready();
+    if (i) {
+        return i;
     }
 
     /* Handling of cycle based sound engines. */
@@ -988,12 +1133,8 @@ static int sound_run_sound(void)
                                              SOUND_BUFSIZE - snddata.bufptr,
                                              snddata.sound_output_channels,
                                              snddata.sound_chip_channels,
-                                             &delta_t);
-        if (volume < 100) {
-            for (i = 0; i < (nr * snddata.sound_output_channels); i++) {
-                bufferptr[i] = (volume!=0) ? (bufferptr[i]/(100 / volume)) : 0;
-            }
-        }
+                                             &delta_t, bufs);
+        sound_mix_chips(bufs, bufferptr, nr);
 
         if (delta_t) {
             if (overflow_warning_count < 25) {
@@ -1022,12 +1163,8 @@ static int sound_run_sound(void)
                                         nr,
                                         snddata.sound_output_channels,
                                         snddata.sound_chip_channels,
-                                        &delta_t);
-        if (volume < 100) {
-            for (i = 0; i < (nr * snddata.sound_output_channels); i++) {
-                    bufferptr[i] = (volume != 0) ? (bufferptr[i] / (100 / volume)) : 0;
-            }
-        }
+                                        &delta_t, bufs);
+        sound_mix_chips(bufs, bufferptr, nr);
         snddata.fclk += nr * snddata.clkstep;
     }
 
@@ -1132,15 +1269,23 @@ double sound_flush()
 
     /* adjust speed */
     if (snddata.playdev->bufferspace) {
-        space = snddata.playdev->bufferspace();
+        if (snddata.playdev->bufferfill) {
+            space = snddata.bufsize - snddata.playdev->bufferfill();
+        } else {
+            space = snddata.playdev->bufferspace();
+        }
         if (space < 0 || space > snddata.bufsize) {
             log_warning(sound_log, "fragment problems %d %d", space, snddata.bufsize);
             sound_error(translate_text(IDGS_FRAGMENT_PROBLEMS));
             return 0;
         }
-        /* we only write complete fragments, sound drivers that can tell
-         * better accuracy aren't utilized at this stage. */
-        space -= space % snddata.fragsize;
+        /* we only write complete fragments to drivers that cannot tell
+         * their fill level exactly; the others take any number of
+         * samples, so their exact fill level drives the speed
+         * adjustment. */
+        if (!snddata.playdev->bufferfill) {
+            space -= space % snddata.fragsize;
+        }
 
         used = snddata.bufsize - space;
         /* buffer emptied during vsync? Looks like underrun. */
@@ -1351,6 +1496,8 @@ void sound_init(unsigned int clock_rate, unsigned int ticks_per_frame)
     cycles_per_rfsh = ticks_per_frame;
     rfsh_per_sec = (1.0 / ((double)cycles_per_rfsh / (double)cycles_per_sec));
 
+    sound_mix_init();
+
     clk_guard_add_callback(maincpu_clk_guard, prevent_clk_overflow_callback,
                            NULL);
 
@@ -1480,14 +1627,22 @@ void sound_store(WORD addr, BYTE val, int chipno)
 {
     int i;
 
-    if (sound_run_sound())
+    if (sound_ready())
         return;
 
     if (chipno >= snddata.sound_chip_channels) {
         return;
     }
 
-    sound_machine_store(snddata.psid[chipno], addr, val);
+    /* Cycle based chips may queue the write and apply it at the right
+       cycle later on; otherwise run the sound up to now first.  */
+    if (!cycle_based
+        || !sound_machine_store_clk(snddata.psid[chipno], addr, val, maincpu_clk)) {
+        if (sound_run_sound())
+            return;
+
+        sound_machine_store(snddata.psid[chipno], addr, val);
+    }
 
     if (!snddata.playdev->dump)
         return;
@@ -84,6 +84,8 @@ typedef struct sound_device_s
     int (*resume)(void);
     /* is attenuation needed on suspend or not */
     int need_attenuation;
+    /* return number of samples queued in the buffer, exactly; optional */
+    int (*bufferfill)(void);
 } sound_device_t;
 
 static inline SWORD sound_audio_mix(int ch1, int ch2)
@@ -210,8 +212,21 @@ typedef struct sound_chip_s {
     int (*cycle_based)(void);
     int (*channels)(void);
     int chip_enabled;
+    /* Optional: take a register write together with its clock, to be
+       applied while the samples are calculated, instead of having the
+       samples calculated up to the write first.  Returns 0 if the write
+       has to be stored the usual way.  */
+    int (*store_clk)(sound_t *psid, WORD addr, BYTE val, CLOCK clk);
 } sound_chip_t;
 
 extern WORD sound_chip_register(sound_chip_t *chip);
 
+/* Set the gain of a chip in percent, 0 to 200, and its balance from -100
+   (left) to 100 (right).  Chips start at 100 in the centre.  */
+extern void sound_chip_set_mix(WORD chip_offset, int gain, int pan);
+
+/* Count samples a chip clipped mixing its own channels with sound_mix(),
+   so that they are logged with those of the final mix.  */
+extern void sound_chip_clipped(unsigned int samples);
+
 #endif
@@ -44,26 +44,14 @@
 #include "vice.h"
 
 #include <AudioToolbox/AudioToolbox.h>
-#include <libkern/OSAtomic.h>
 
 #include "lib.h"
 #include "log.h"
 #include "sound.h"
+#include "soundring.h"
 
-/* type for atomic increments */
-typedef volatile int atomic_int_t;
-
-/* the cyclic buffer containing m fragments */
-static SWORD *soundbuffer;
-
-/* silence fragment */
-static SWORD *silence;
-
-/* current read position: no. of fragment in soundbuffer */
-static unsigned int read_position;
-
-/* the next position to write: no. of fragment in soundbuffer */
-static unsigned int write_position;
+/* the ring of m fragments between VICE and the audio queue callback */
+static sound_ring_t *ring;
 
 static unsigned int frames_in_fragment;
 static unsigned int bytes_in_fragment;
@@ -72,18 +60,9 @@ static unsigned int samples_in_fragment;
 /* total number of fragments */
 static unsigned int fragment_count;
 
-/* current number of fragments in buffer */
-static atomic_int_t fragments_in_queue;
-
 /* number of interleaved channels (mono SID=1, stereo SID=2) */
 static int in_channels;
 
-/* samples left in current fragment */
-static unsigned int frames_left_in_fragment;
-
-/* bytes per input frame */
-static unsigned int in_frame_byte_size;
-
 static const int    kNumberBuffers = 3;
 
 static AudioStreamBasicDescription sStreamFormat;
@@ -113,42 +92,10 @@ static void sAudioQueueOutputCallback(void* inUserData, AudioQueueRef inAQ, Audi
     
     UInt32 num_frames = sAQBufferByteSize / sizeof(short) / sStreamFormat.mChannelsPerFrame;
     
-    SWORD *buffer;
-    if (fragments_in_queue) 
-    {
-        /* too many -> crop to available in current fragment */
-        if(num_frames > frames_left_in_fragment) {
-            num_frames = frames_left_in_fragment;
-        }
-        
-        /* calc position in sound buffer */
-        int sample_offset_in_fragment = frames_in_fragment - frames_left_in_fragment;
-        buffer = soundbuffer + samples_in_fragment * read_position + sample_offset_in_fragment * in_channels;
-        
-        /* update the samples left in the current fragment */
-        frames_left_in_fragment -= num_frames;
-        
-        /* fetch next fragment */
-        if(frames_left_in_fragment <= 0) {
-            read_position = (read_position + 1) % fragment_count;
-            OSAtomicDecrement32(&fragments_in_queue);
-            frames_left_in_fragment = frames_in_fragment;
-            
-            //printf("At read: Fragments in queue: %d\n", fragments_in_queue);
-        }
-    }
-    else
-    {
-        if(num_frames > frames_in_fragment)
-            num_frames = frames_in_fragment;
-        
-        /* output silence */
-        buffer = silence;
-    }
+    /* pads with silence if VICE is behind */
+    sound_ring_read(ring, aqBuffer, num_frames);
 
-    sCurrentBuffer = buffer;
-    
-    memcpy(aqBuffer, buffer, sAQBufferByteSize);
+    sCurrentBuffer = aqBuffer;
     
 	// tell core audio how many bytes we have just filled
 	inBuffer->mAudioDataByteSize = sAQBufferByteSize;
@@ -189,13 +136,13 @@ static void sAudioSessionInterruptionCallback(void* inClientData, UInt32 inInter
         if (err)
             fprintf(stderr, "WARNING: AudioSessionSetActive err %d\n", (int)err);
 
+        /* drop what was queued before the interruption; the emulation
+           thread may be writing meanwhile */
+        sound_ring_flush(ring);
+
         AudioQueueStart(sQueue, NULL);
 
         sAudioSessionInterrupted = false;
-        read_position = 0;
-        write_position = 0;
-        fragments_in_queue = 0;
-        frames_left_in_fragment = frames_in_fragment;
         printf("Audio session resumed\n");
     }
 }
@@ -224,10 +171,7 @@ static int audioqueue_init(const char *param, int *speed, int *fragsize, int *fr
     samples_in_fragment = frames_in_fragment * in_channels;
     bytes_in_fragment  = samples_in_fragment * sizeof(SWORD);
     
-    in_frame_byte_size = sizeof(SWORD) * in_channels;
-    
-    soundbuffer = lib_calloc(fragment_count, bytes_in_fragment);
-    silence = lib_calloc(1, bytes_in_fragment);
+    ring = sound_ring_new(fragment_count * frames_in_fragment, in_channels);
     
 	sStreamFormat.mBitsPerChannel = 16;
 	sStreamFormat.mSampleRate = *speed;
@@ -314,28 +258,10 @@ static int audioqueue_init(const char *param, int *speed, int *fragsize, int *fr
 
 static int audioqueue_write(SWORD *pbuf, size_t nr)
 {
-    int i, count;
-    
-    /* number of fragments */
-    count = nr / samples_in_fragment;
-    
-    for (i = 0; i < count; i++)
-    {
-        if (fragments_in_queue == fragment_count)
-        {
-            log_warning(LOG_DEFAULT, "sound (coreaudio): buffer overrun");
-            return 0;
-        }
-        
-        memcpy(soundbuffer + samples_in_fragment * write_position,
-               pbuf + i * samples_in_fragment,
-               bytes_in_fragment);
-        
-        write_position = (write_position + 1) % fragment_count;
-        
-        OSAtomicIncrement32(&fragments_in_queue);
-        
-        //printf("At write: Fragments in queue: %d\n", fragments_in_queue);
+    unsigned int frames = nr / in_channels;
+
+    if (sound_ring_write(ring, pbuf, frames) < frames) {
+        log_warning(LOG_DEFAULT, "sound (audioqueue): buffer overrun");
     }
 
     return 0;
@@ -343,11 +269,18 @@ static int audioqueue_write(SWORD *pbuf, size_t nr)
 
 static int audioqueue_bufferspace(void)
 {
-    return (fragment_count - fragments_in_queue) * frames_in_fragment;
+    return sound_ring_space(ring);
+}
+
+static int audioqueue_bufferfill(void)
+{
+    return sound_ring_fill(ring);
 }
 
 static void audioqueue_close(void)
 {
+    sound_ring_stats_t stats;
+
 	OSStatus err = AudioQueueFlush(sQueue);
 	if (err) fprintf(stderr, "AudioQueueFlush err %d\n", (int)err);
 
@@ -368,14 +301,23 @@ static void audioqueue_close(void)
 #endif
     
     sCurrentBuffer = NULL;
-    
-    lib_free(soundbuffer);
-    lib_free(silence);
+
+    sound_ring_get_stats(ring, &stats);
+    log_message(LOG_DEFAULT,
+                "sound (audioqueue): %u underruns (%u frames), %u overruns (%u frames), latency %u ms (max %u ms)",
+                stats.underruns, stats.underrun_frames,
+                stats.overruns, stats.overrun_frames,
+                stats.latency / 1000, stats.latency_max / 1000);
+
+    sound_ring_destroy(ring);
+    ring = NULL;
 }
 
 static int audioqueue_suspend(void)
 {
-    
+    /* The queue keeps running and plays the ring empty.  */
+    sound_ring_set_paused(ring, 1);
+
 //	OSStatus err = AudioSessionSetActive(false);
 //	if (err)
 //		fprintf(stderr, "WARNING: AudioSessionSetActive err %d\n", (int)err);
@@ -385,10 +327,7 @@ static int audioqueue_suspend(void)
 
 static int audioqueue_resume(void)
 {
-    read_position = 0;
-    write_position = 0;
-    fragments_in_queue = 0;
-    frames_left_in_fragment = frames_in_fragment;
+    sound_ring_set_paused(ring, 0);
 
 //	OSStatus err = AudioSessionSetActive(true);
 //	if (err)
@@ -408,7 +347,8 @@ static sound_device_t audioqueue_device =
     audioqueue_close,
     audioqueue_suspend,
     audioqueue_resume,
-    1
+    1,
+    audioqueue_bufferfill
 };
 
 int sound_init_audioqueue_device(void)
@@ -0,0 +1,303 @@
+/*
+ * soundring.c - Lock-free sample ring buffer for sound devices.
+ *
+ * Written by
+ *  VICE Project
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The read and write positions count frames since the last reset and
+   wrap around at 2^32; their difference is the fill level.  The frames
+   are stored in a power of 2 of slots, which may be more than the size,
+   so that the slot of a position stays the same across the wrap.  Each position
+   is only ever stored by its own side.  The producer publishes frames by
+   storing the write position after copying them (release) and the
+   consumer loads it before copying them out (acquire), and the other way
+   round for the space freed by the consumer.  The data of the two sides
+   lives in separate cache lines, so that they do not slow each other
+   down.
+
+   For the latency, the producer queues a mark with the write position
+   and the time after each write, if there is room for one; the consumer
+   takes the marks its read position has passed.  */
+
+#include "vice.h"
+
+#include <string.h>
+
+#include "lib.h"
+#include "soundring.h"
+#include "types.h"
+#include "vsyncapi.h"
+
+#if defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)
+#define RING_LOAD(p)        __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define RING_STORE(p, v)    __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#else
+/* Without atomic builtins, this is only safe on single processor hosts.  */
+#define RING_LOAD(p)        (*(volatile unsigned int *)(p))
+#define RING_STORE(p, v)    (*(volatile unsigned int *)(p) = (v))
+#endif
+
+#define RING_CACHE_LINE 64
+
+/* number of latency marks, a power of 2 */
+#define RING_MARKS 64
+
+typedef struct ring_mark_s {
+    unsigned int pos;
+    unsigned long time;
+} ring_mark_t;
+
+/* data stored by the producer */
+typedef struct ring_producer_s {
+    unsigned int pos;
+    unsigned int mark_pos;
+    unsigned int overruns;
+    unsigned int overrun_frames;
+    /* no underruns are counted while the producer is paused */
+    int paused;
+} ring_producer_t;
+
+/* data stored by the consumer */
+typedef struct ring_consumer_s {
+    unsigned int pos;
+    unsigned int mark_pos;
+    unsigned int underruns;
+    unsigned int underrun_frames;
+    unsigned int latency;
+    unsigned int latency_max;
+    /* no underruns are counted before the first frames arrived */
+    int started;
+} ring_consumer_t;
+
+struct sound_ring_s {
+    union {
+        ring_producer_t p;
+        char pad[RING_CACHE_LINE];
+    } producer;
+    union {
+        ring_consumer_t c;
+        char pad[RING_CACHE_LINE];
+    } consumer;
+
+    /* constant after sound_ring_new() */
+    SWORD *buffer;
+    unsigned int size;
+    unsigned int slots;
+    int channels;
+    signed long frequency;
+    void *block;
+
+    ring_mark_t marks[RING_MARKS];
+};
+
+sound_ring_t *sound_ring_new(unsigned int frames, int channels)
+{
+    sound_ring_t *ring;
+    void *block;
+
+    /* Allocate one cache line more to align the ring on one.  */
+    block = lib_calloc(1, sizeof(sound_ring_t) + RING_CACHE_LINE);
+    ring = (sound_ring_t *)(((size_t)block + RING_CACHE_LINE - 1)
+                            & ~(size_t)(RING_CACHE_LINE - 1));
+
+    ring->block = block;
+    ring->size = frames;
+    ring->slots = 1;
+    while (ring->slots < frames) {
+        ring->slots <<= 1;
+    }
+    ring->channels = channels;
+    ring->buffer = lib_calloc(ring->slots * channels, sizeof(SWORD));
+    ring->frequency = vsyncarch_frequency();
+
+    return ring;
+}
+
+void sound_ring_destroy(sound_ring_t *ring)
+{
+    if (ring == NULL) {
+        return;
+    }
+
+    lib_free(ring->buffer);
+    lib_free(ring->block);
+}
+
+void sound_ring_reset(sound_ring_t *ring)
+{
+    memset(&ring->producer, 0, sizeof(ring->producer));
+    memset(&ring->consumer, 0, sizeof(ring->consumer));
+}
+
+void sound_ring_set_paused(sound_ring_t *ring, int paused)
+{
+    RING_STORE(&ring->producer.p.paused, paused);
+}
+
+/* ------------------------------------------------------------------------- */
+
+unsigned int sound_ring_fill(sound_ring_t *ring)
+{
+    unsigned int read_pos, fill;
+
+    /* The read position never passes the write position, as long as the
+       write position is loaded after it.  The ring may fill in between,
+       though.  */
+    read_pos = RING_LOAD(&ring->consumer.c.pos);
+    fill = RING_LOAD(&ring->producer.p.pos) - read_pos;
+
+    return fill > ring->size ? ring->size : fill;
+}
+
+unsigned int sound_ring_space(sound_ring_t *ring)
+{
+    return ring->size - sound_ring_fill(ring);
+}
+
+unsigned int sound_ring_write(sound_ring_t *ring, const SWORD *pbuf,
+                              unsigned int frames)
+{
+    ring_producer_t *p = &ring->producer.p;
+    unsigned int space, offset, n;
+
+    space = ring->size - (p->pos - RING_LOAD(&ring->consumer.c.pos));
+    if (frames > space) {
+        RING_STORE(&p->overruns, p->overruns + 1);
+        RING_STORE(&p->overrun_frames, p->overrun_frames + frames - space);
+        frames = space;
+    }
+    if (frames == 0) {
+        return 0;
+    }
+
+    offset = p->pos & (ring->slots - 1);
+    n = ring->slots - offset;
+    if (n > frames) {
+        n = frames;
+    }
+    memcpy(ring->buffer + offset * ring->channels, pbuf,
+           n * ring->channels * sizeof(SWORD));
+    memcpy(ring->buffer, pbuf + n * ring->channels,
+           (frames - n) * ring->channels * sizeof(SWORD));
+
+    RING_STORE(&p->pos, p->pos + frames);
+
+    /* Marks are dropped rather than waited for.  */
+    if (p->mark_pos - RING_LOAD(&ring->consumer.c.mark_pos) < RING_MARKS) {
+        ring_mark_t *mark = &ring->marks[p->mark_pos % RING_MARKS];
+
+        mark->pos = p->pos;
+        mark->time = vsyncarch_gettime();
+        RING_STORE(&p->mark_pos, p->mark_pos + 1);
+    }
+
+    return frames;
+}
+
+unsigned int sound_ring_read(sound_ring_t *ring, SWORD *pbuf,
+                             unsigned int frames)
+{
+    ring_consumer_t *c = &ring->consumer.c;
+    unsigned int fill, offset, n, count;
+
+    fill = RING_LOAD(&ring->producer.p.pos) - c->pos;
+    count = frames > fill ? fill : frames;
+
+    offset = c->pos & (ring->slots - 1);
+    n = ring->slots - offset;
+    if (n > count) {
+        n = count;
+    }
+    memcpy(pbuf, ring->buffer + offset * ring->channels,
+           n * ring->channels * sizeof(SWORD));
+    memcpy(pbuf + n * ring->channels, ring->buffer,
+           (count - n) * ring->channels * sizeof(SWORD));
+
+    if (count < frames) {
+        memset(pbuf + count * ring->channels, 0,
+               (frames - count) * ring->channels * sizeof(SWORD));
+        if (c->started && !RING_LOAD(&ring->producer.p.paused)) {
+            RING_STORE(&c->underruns, c->underruns + 1);
+            RING_STORE(&c->underrun_frames,
+                       c->underrun_frames + frames - count);
+        }
+    }
+    if (count > 0) {
+        c->started = 1;
+    }
+
+    RING_STORE(&c->pos, c->pos + count);
+
+    while (c->mark_pos != RING_LOAD(&ring->producer.p.mark_pos)) {
+        ring_mark_t *mark = &ring->marks[c->mark_pos % RING_MARKS];
+        unsigned long delta;
+        unsigned int latency;
+
+        /* not read up to the end of this write yet */
+        if ((int)(c->pos - mark->pos) < 0) {
+            break;
+        }
+        delta = vsyncarch_gettime() - mark->time;
+        latency = (unsigned int)((double)delta * 1000000.0
+                                 / (double)ring->frequency);
+        RING_STORE(&c->latency, latency);
+        if (latency > c->latency_max) {
+            RING_STORE(&c->latency_max, latency);
+        }
+        RING_STORE(&c->mark_pos, c->mark_pos + 1);
+    }
+
+    return count;
+}
+
+void sound_ring_flush(sound_ring_t *ring)
+{
+    ring_consumer_t *c = &ring->consumer.c;
+
+    RING_STORE(&c->pos, RING_LOAD(&ring->producer.p.pos));
+
+    /* The dropped frames do not count for the latency.  */
+    while (c->mark_pos != RING_LOAD(&ring->producer.p.mark_pos)
+           && (int)(c->pos - ring->marks[c->mark_pos % RING_MARKS].pos) >= 0) {
+        RING_STORE(&c->mark_pos, c->mark_pos + 1);
+    }
+
+    /* Nor does the wait for the next ones.  */
+    c->started = 0;
+}
+
+void sound_ring_get_stats(sound_ring_t *ring, sound_ring_stats_t *stats)
+{
+    ring_producer_t *p = &ring->producer.p;
+    ring_consumer_t *c = &ring->consumer.c;
+
+    /* Counters of the other side may be a little behind.  */
+    stats->size = ring->size;
+    stats->fill = sound_ring_fill(ring);
+    stats->overruns = RING_LOAD(&p->overruns);
+    stats->overrun_frames = RING_LOAD(&p->overrun_frames);
+    stats->underruns = RING_LOAD(&c->underruns);
+    stats->underrun_frames = RING_LOAD(&c->underrun_frames);
+    stats->latency = RING_LOAD(&c->latency);
+    stats->latency_max = RING_LOAD(&c->latency_max);
+}
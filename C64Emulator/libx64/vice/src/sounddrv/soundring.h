@@ -0,0 +1,84 @@
+/*
+ * soundring.h - Lock-free sample ring buffer for sound devices.
+ *
+ * Written by
+ *  VICE Project
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_SOUNDRING_H
+#define VICE_SOUNDRING_H
+
+#include "types.h"
+
+/* A ring buffer of interleaved sample frames between exactly one producer,
+   the emulation thread writing through the device's write() hook, and one
+   consumer, usually the audio callback of the host.  Neither side ever
+   blocks or takes a lock.  A write that does not fit drops the frames that
+   do not fit (an overrun), a read that finds too few frames is padded with
+   silence (an underrun).  */
+
+typedef struct sound_ring_s sound_ring_t;
+
+typedef struct sound_ring_stats_s {
+    /* size of the ring and frames queued, in frames */
+    unsigned int size;
+    unsigned int fill;
+    /* writes that did not fit and the frames they dropped */
+    unsigned int overruns;
+    unsigned int overrun_frames;
+    /* reads that were padded and the frames of silence they got */
+    unsigned int underruns;
+    unsigned int underrun_frames;
+    /* time from a write to the read of its last frame, in microseconds:
+       the last one measured and the largest so far */
+    unsigned int latency;
+    unsigned int latency_max;
+} sound_ring_stats_t;
+
+extern sound_ring_t *sound_ring_new(unsigned int frames, int channels);
+extern void sound_ring_destroy(sound_ring_t *ring);
+
+/* Empty the ring and clear the statistics.  Neither side may be using the
+   ring at the same time.  */
+extern void sound_ring_reset(sound_ring_t *ring);
+
+/* producer side */
+extern unsigned int sound_ring_write(sound_ring_t *ring, const SWORD *pbuf,
+                                     unsigned int frames);
+extern unsigned int sound_ring_space(sound_ring_t *ring);
+
+/* While paused, the consumer drains the ring without counting underruns.  */
+extern void sound_ring_set_paused(sound_ring_t *ring, int paused);
+
+/* consumer side */
+extern unsigned int sound_ring_read(sound_ring_t *ring, SWORD *pbuf,
+                                    unsigned int frames);
+
+/* Drop the frames queued so far, while the producer may keep writing.  */
+extern void sound_ring_flush(sound_ring_t *ring);
+
+/* either side */
+extern unsigned int sound_ring_fill(sound_ring_t *ring);
+extern void sound_ring_get_stats(sound_ring_t *ring,
+                                 sound_ring_stats_t *stats);
+
+#endif
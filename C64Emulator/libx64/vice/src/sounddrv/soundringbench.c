@@ -0,0 +1,293 @@
+/*
+ * soundringbench.c - Sound ring buffer benchmark.
+ *
+ * Written by
+ *  VICE Project
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The benchmark runs the ring between the main thread as the producer and
+   a second thread as the consumer, twice: first paced like the emulator
+   and an audio callback, writing a frame's worth of samples every 20 ms
+   and reading a buffer every 2.9 ms, then as fast as both sides can go
+   with random sizes.  The producer writes a running sequence of frames,
+   which the consumer checks, so the benchmark fails if a frame is ever
+   lost, duplicated or torn.  A third run goes as fast as the second, but
+   the consumer flushes the ring every so often and picks up the sequence
+   again at the first frame it reads after that.  */
+
+#include "vice.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+#include "soundring.h"
+#include "types.h"
+#include "vsyncapi.h"
+
+#define BENCH_CHANNELS   2
+#define BENCH_RATE       44100
+#define BENCH_FRAGMENT   512
+#define BENCH_FRAGMENTS  8
+#define BENCH_MAX_CHUNK  2048
+
+typedef struct bench_phase_s {
+    const char *name;
+    /* frames written every `write_period' microseconds, 0 for random
+       sizes as fast as possible */
+    unsigned int write_frames;
+    unsigned int write_period;
+    unsigned int read_frames;
+    unsigned int read_period;
+    unsigned long frames;
+    /* reads between flushes of the consumer, 0 for none */
+    unsigned int flush_period;
+} bench_phase_t;
+
+static bench_phase_t phases[] = {
+    { "paced", 882, 20000, 128, 2902, BENCH_RATE * 2, 0 },
+    { "stress", 0, 0, 0, 0, 2000000, 0 },
+    { "flush", 0, 0, 0, 0, 1000000, 64 },
+    { NULL, 0, 0, 0, 0, 0, 0 }
+};
+
+static sound_ring_t *ring;
+static bench_phase_t *phase;
+
+/* set by the consumer on the first frame out of sequence */
+static volatile int broken = 0;
+
+/* set by the producer after its last write */
+static volatile int producer_done = 0;
+
+/* ------------------------------------------------------------------------- */
+
+/* The ring only needs the time from the rest of the emulator.  */
+
+unsigned long vsyncarch_gettime(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (unsigned long)tv.tv_sec * 1000000UL + (unsigned long)tv.tv_usec;
+}
+
+signed long vsyncarch_frequency(void)
+{
+    return 1000000;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static DWORD rnd_state = 0x1234567;
+
+static unsigned int bench_random(DWORD *state)
+{
+    *state = *state * 1103515245 + 12345;
+    return (unsigned int)((*state >> 8) & 0xffffff);
+}
+
+static void bench_sleep(unsigned int usec)
+{
+    struct timespec ts;
+
+    ts.tv_sec = usec / 1000000;
+    ts.tv_nsec = (long)(usec % 1000000) * 1000;
+    nanosleep(&ts, NULL);
+}
+
+static double bench_time(void)
+{
+    return (double)vsyncarch_gettime() / 1000000.0;
+}
+
+/* Frame `seq' of the sequence: never silence, and the channels differ.  */
+static void frame_make(SWORD *frame, unsigned long seq)
+{
+    frame[0] = (SWORD)(seq % 32767 + 1);
+    frame[1] = (SWORD)-frame[0];
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void *consumer_thread(void *arg)
+{
+    static SWORD buf[BENCH_MAX_CHUNK * BENCH_CHANNELS];
+    DWORD state = 0x7654321;
+    unsigned long seq = 0;
+    unsigned int reads = 0;
+    int resync = 0;
+
+    while (seq < phase->frames && !broken) {
+        unsigned int frames, count, i;
+
+        if (phase->flush_period && ++reads % phase->flush_period == 0) {
+            sound_ring_flush(ring);
+            resync = 1;
+        }
+
+        frames = phase->read_frames;
+        if (frames == 0) {
+            frames = 1 + bench_random(&state) % BENCH_MAX_CHUNK;
+        }
+
+        count = sound_ring_read(ring, buf, frames);
+
+        /* The frames after a flush are the next ones the producer wrote;
+           the ring is shorter than the period of the sequence.  */
+        if (resync && count > 0) {
+            seq += ((unsigned long)(buf[0] - 1) + 32767 - seq % 32767) % 32767;
+            resync = 0;
+        }
+
+        /* The last frames were flushed.  */
+        if (count == 0 && producer_done && sound_ring_fill(ring) == 0) {
+            break;
+        }
+
+        for (i = 0; i < frames; i++) {
+            SWORD expected[BENCH_CHANNELS];
+
+            if (i >= count) {
+                expected[0] = expected[1] = 0;
+            } else {
+                frame_make(expected, seq + i);
+            }
+            if (buf[i * BENCH_CHANNELS] != expected[0]
+                || buf[i * BENCH_CHANNELS + 1] != expected[1]) {
+                printf("frame %lu out of sequence: %d %d, expected %d %d\n",
+                       seq + i, buf[i * BENCH_CHANNELS],
+                       buf[i * BENCH_CHANNELS + 1], expected[0], expected[1]);
+                broken = 1;
+                break;
+            }
+        }
+        seq += count;
+
+        if (phase->read_period) {
+            bench_sleep(phase->read_period);
+        }
+    }
+
+    return arg;
+}
+
+static int run_phase(void)
+{
+    static SWORD buf[BENCH_MAX_CHUNK * BENCH_CHANNELS];
+    sound_ring_stats_t stats;
+    pthread_t consumer;
+    unsigned long seq = 0;
+    double start, elapsed;
+
+    sound_ring_reset(ring);
+    broken = 0;
+    producer_done = 0;
+
+    start = bench_time();
+
+    if (pthread_create(&consumer, NULL, consumer_thread, NULL)) {
+        printf("cannot create the consumer thread\n");
+        return -1;
+    }
+
+    while (seq < phase->frames && !broken) {
+        unsigned int frames, written, i;
+
+        frames = phase->write_frames;
+        if (frames == 0) {
+            frames = 1 + bench_random(&rnd_state) % BENCH_MAX_CHUNK;
+        }
+        if (frames > phase->frames - seq) {
+            frames = (unsigned int)(phase->frames - seq);
+        }
+
+        for (i = 0; i < frames; i++) {
+            frame_make(buf + i * BENCH_CHANNELS, seq + i);
+        }
+
+        /* The frames that did not fit are written again next time, like
+           sound_flush() keeps them in its buffer.  */
+        written = sound_ring_write(ring, buf, frames);
+        seq += written;
+
+        if (phase->write_period) {
+            bench_sleep(phase->write_period);
+        }
+    }
+
+    producer_done = 1;
+    pthread_join(consumer, NULL);
+
+    elapsed = bench_time() - start;
+
+    sound_ring_get_stats(ring, &stats);
+
+    printf("%-6s: %lu frames in %.2f s (%.1f ns/frame), "
+           "%u/%u overruns, %u/%u underruns, latency %.1f ms (max %.1f ms)%s\n",
+           phase->name, phase->frames, elapsed,
+           elapsed * 1e9 / (double)phase->frames,
+           stats.overruns, stats.overrun_frames,
+           stats.underruns, stats.underrun_frames,
+           stats.latency / 1000.0, stats.latency_max / 1000.0,
+           broken ? " (!)" : "");
+
+    return broken ? -1 : 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void usage(void)
+{
+    printf("Usage: soundringbench [stress frames]\n");
+}
+
+int main(int argc, char **argv)
+{
+    int result = 0;
+
+    if (argc > 1 && argv[1][0] == '-') {
+        usage();
+        return 1;
+    }
+    if (argc > 1) {
+        phases[1].frames = strtoul(argv[1], NULL, 0);
+    }
+
+    ring = sound_ring_new(BENCH_FRAGMENT * BENCH_FRAGMENTS, BENCH_CHANNELS);
+
+    for (phase = phases; phase->name; phase++) {
+        if (run_phase() < 0) {
+            result = 1;
+        }
+    }
+
+    sound_ring_destroy(ring);
+
+    return result;
+}
@@ -0,0 +1,252 @@
+/*
+ * soundmix.c - Mixing stage of the sound chips.
+ *
+ * Written by
+ *  VICE Project
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* Every chip calculates its samples into a buffer of its own, interleaved
+   like the output.  The mixer multiplies each sample with the gain of its
+   chip for its channel, which includes the volume and the balance, adds
+   them up and clips the sum to 16 bits, all in one pass over the output.
+   As the channels alternate in the buffers, the gains of a chip alternate
+   in the lanes of the SIMD kernels.  */
+
+#include "vice.h"
+
+#include "sound.h"
+#include "soundmix.h"
+#include "types.h"
+
+/* SSE2 and AVX2 kernels, chosen at run time by the features of the host
+   CPU.  They need the target attribute of GCC or Clang.  */
+#if (defined(__i386__) || defined(__x86_64__)) \
+    && (defined(__clang__) || __GNUC__ >= 5)
+#define SOUND_MIX_USE_SIMD 1
+#include <immintrin.h>
+#else
+#define SOUND_MIX_USE_SIMD 0
+#endif
+
+#define SOUND_MIX_ROUND (1 << (SOUND_MIX_SHIFT - 1))
+
+/* time constant of the DC blocker, 2^n samples */
+#define SOUND_MIX_DC_SHIFT 10
+
+/* mix the samples `i' to `n' - 1 */
+static unsigned int sound_mix_tail(SWORD *out, const sound_mix_source_t *src,
+                                   int sources, int i, int n, int soc)
+{
+    unsigned int clipped = 0;
+    int j;
+
+    for (; i < n; i++) {
+        int ch = soc > 1 ? i & 1 : 0;
+        SDWORD sum = SOUND_MIX_ROUND;
+
+        for (j = 0; j < sources; j++) {
+            sum += (SDWORD)src[j].buf[i] * src[j].gain[ch];
+        }
+        sum >>= SOUND_MIX_SHIFT;
+
+        if (sum > 32767) {
+            sum = 32767;
+            clipped++;
+        } else if (sum < -32768) {
+            sum = -32768;
+            clipped++;
+        }
+        out[i] = (SWORD)sum;
+    }
+    return clipped;
+}
+
+static unsigned int sound_mix_c(SWORD *out, const sound_mix_source_t *src,
+                                int sources, int n, int soc)
+{
+    return sound_mix_tail(out, src, sources, 0, n, soc);
+}
+
+#if SOUND_MIX_USE_SIMD
+
+/* The products of the 16-bit samples and gains are put together from
+   their low and high halves into 32-bit lanes.  packs does the clipping,
+   the comparisons count it.  */
+__attribute__((target("sse2")))
+static unsigned int sound_mix_sse2(SWORD *out, const sound_mix_source_t *src,
+                                   int sources, int n, int soc)
+{
+    __m128i gain[SOUND_MIX_SOURCES_MAX];
+    __m128i round = _mm_set1_epi32(SOUND_MIX_ROUND);
+    __m128i max = _mm_set1_epi32(32767);
+    __m128i min = _mm_set1_epi32(-32768);
+    __m128i count = _mm_setzero_si128();
+    unsigned int counts[4];
+    int i, j;
+
+    for (j = 0; j < sources; j++) {
+        int g1 = src[j].gain[soc > 1 ? 1 : 0];
+
+        gain[j] = _mm_set_epi16((short)g1, (short)src[j].gain[0],
+                                (short)g1, (short)src[j].gain[0],
+                                (short)g1, (short)src[j].gain[0],
+                                (short)g1, (short)src[j].gain[0]);
+    }
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m128i lo = round, hi = round;
+
+        for (j = 0; j < sources; j++) {
+            __m128i s = _mm_loadu_si128((const __m128i *)&src[j].buf[i]);
+            __m128i pl = _mm_mullo_epi16(s, gain[j]);
+            __m128i ph = _mm_mulhi_epi16(s, gain[j]);
+
+            lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(pl, ph));
+            hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(pl, ph));
+        }
+        lo = _mm_srai_epi32(lo, SOUND_MIX_SHIFT);
+        hi = _mm_srai_epi32(hi, SOUND_MIX_SHIFT);
+
+        count = _mm_sub_epi32(count, _mm_or_si128(_mm_cmpgt_epi32(lo, max),
+                                                  _mm_cmplt_epi32(lo, min)));
+        count = _mm_sub_epi32(count, _mm_or_si128(_mm_cmpgt_epi32(hi, max),
+                                                  _mm_cmplt_epi32(hi, min)));
+
+        _mm_storeu_si128((__m128i *)&out[i], _mm_packs_epi32(lo, hi));
+    }
+
+    _mm_storeu_si128((__m128i *)counts, count);
+
+    return counts[0] + counts[1] + counts[2] + counts[3]
+           + sound_mix_tail(out, src, sources, i, n, soc);
+}
+
+/* unpack and packs both work within 128-bit lanes, so the samples come
+   out in order again */
+__attribute__((target("avx2")))
+static unsigned int sound_mix_avx2(SWORD *out, const sound_mix_source_t *src,
+                                   int sources, int n, int soc)
+{
+    __m256i gain[SOUND_MIX_SOURCES_MAX];
+    __m256i round = _mm256_set1_epi32(SOUND_MIX_ROUND);
+    __m256i max = _mm256_set1_epi32(32767);
+    __m256i min = _mm256_set1_epi32(-32768);
+    __m256i count = _mm256_setzero_si256();
+    unsigned int counts[8];
+    int i, j;
+
+    for (j = 0; j < sources; j++) {
+        int g0 = src[j].gain[0];
+        int g1 = src[j].gain[soc > 1 ? 1 : 0];
+
+        gain[j] = _mm256_set1_epi32((int)(((DWORD)g1 << 16) | (DWORD)g0));
+    }
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m256i lo = round, hi = round;
+
+        for (j = 0; j < sources; j++) {
+            __m256i s = _mm256_loadu_si256((const __m256i *)&src[j].buf[i]);
+            __m256i pl = _mm256_mullo_epi16(s, gain[j]);
+            __m256i ph = _mm256_mulhi_epi16(s, gain[j]);
+
+            lo = _mm256_add_epi32(lo, _mm256_unpacklo_epi16(pl, ph));
+            hi = _mm256_add_epi32(hi, _mm256_unpackhi_epi16(pl, ph));
+        }
+        lo = _mm256_srai_epi32(lo, SOUND_MIX_SHIFT);
+        hi = _mm256_srai_epi32(hi, SOUND_MIX_SHIFT);
+
+        count = _mm256_sub_epi32(count,
+                    _mm256_or_si256(_mm256_cmpgt_epi32(lo, max),
+                                    _mm256_cmpgt_epi32(min, lo)));
+        count = _mm256_sub_epi32(count,
+                    _mm256_or_si256(_mm256_cmpgt_epi32(hi, max),
+                                    _mm256_cmpgt_epi32(min, hi)));
+
+        _mm256_storeu_si256((__m256i *)&out[i], _mm256_packs_epi32(lo, hi));
+    }
+
+    _mm256_storeu_si256((__m256i *)counts, count);
+
+    return counts[0] + counts[1] + counts[2] + counts[3]
+           + counts[4] + counts[5] + counts[6] + counts[7]
+           + sound_mix_tail(out, src, sources, i, n, soc);
+}
+
+#endif
+
+static unsigned int (*sound_mix_kernel)(SWORD *out,
+                                        const sound_mix_source_t *src,
+                                        int sources, int n, int soc)
+    = sound_mix_c;
+
+/* pick the fastest kernel the host CPU supports */
+void sound_mix_init(void)
+{
+#if SOUND_MIX_USE_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        sound_mix_kernel = sound_mix_sse2;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        sound_mix_kernel = sound_mix_avx2;
+    }
+#endif
+}
+
+unsigned int sound_mix(SWORD *out, const sound_mix_source_t *src,
+                       int sources, int nr, int soc)
+{
+    return sound_mix_kernel(out, src, sources, nr * soc, soc);
+}
+
+/* The level follows the samples slowly and is taken off them.  It is kept
+   with 14 more bits, the most that fit with the difference to a sample.  */
+unsigned int sound_mix_dc_block(sound_mix_dc_t *dc, SWORD *buf, int nr,
+                                int soc)
+{
+    unsigned int clipped = 0;
+    int i, ch;
+
+    for (ch = 0; ch < soc; ch++) {
+        SDWORD level = dc->level[ch];
+        SWORD *p = buf + ch;
+
+        for (i = 0; i < nr; i++, p += soc) {
+            SDWORD x = *p;
+
+            level += ((x << 14) - level) >> SOUND_MIX_DC_SHIFT;
+            x -= level >> 14;
+
+            if (x > 32767) {
+                x = 32767;
+                clipped++;
+            } else if (x < -32768) {
+                x = -32768;
+                clipped++;
+            }
+            *p = (SWORD)x;
+        }
+        dc->level[ch] = level;
+    }
+    return clipped;
+}
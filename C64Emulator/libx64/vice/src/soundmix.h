@@ -0,0 +1,72 @@
+/*
+ * soundmix.h - Mixing stage of the sound chips.
+ *
+ * Written by
+ *  VICE Project
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_SOUNDMIX_H
+#define VICE_SOUNDMIX_H
+
+#include "sound.h"
+#include "types.h"
+
+/* Gains are fixed point numbers with SOUND_MIX_UNITY as 1.0, at most
+   SOUND_MIX_GAIN_MAX.  A product of a sample and a gain takes 27 bits,
+   so the sum of SOUND_MIX_SOURCES_MAX sources at full scale and that gain
+   stays within 32 bits, rounding included.  */
+#define SOUND_MIX_SHIFT     10
+#define SOUND_MIX_UNITY     (1 << SOUND_MIX_SHIFT)
+#define SOUND_MIX_GAIN_MAX  (2 * SOUND_MIX_UNITY)
+#define SOUND_MIX_SOURCES_MAX 20
+
+#if SOUND_MIX_SOURCES_MAX * 32768 * SOUND_MIX_GAIN_MAX \
+    + (1 << (SOUND_MIX_SHIFT - 1)) > 0x7fffffff
+#error The sum of the sources can overflow 32 bits!
+#endif
+
+/* The samples of one chip, interleaved like the output, and its gain for
+   each output channel.  */
+typedef struct sound_mix_source_s {
+    const SWORD *buf;
+    int gain[SOUND_CHANNELS_MAX];
+} sound_mix_source_t;
+
+/* State of the DC blocker of each output channel.  */
+typedef struct sound_mix_dc_s {
+    SDWORD level[SOUND_CHANNELS_MAX];
+} sound_mix_dc_t;
+
+extern void sound_mix_init(void);
+
+/* Write the sum of the sources to `out', `nr' frames of `soc' channels,
+   clipped to 16 bits.  `out' may be the buffer of one of the sources.
+   Returns the number of samples clipped.  */
+extern unsigned int sound_mix(SWORD *out, const sound_mix_source_t *src,
+                              int sources, int nr, int soc);
+
+/* Remove the DC offset from the samples in `buf' with a high pass filter
+   at a few Hz.  Returns the number of samples clipped.  */
+extern unsigned int sound_mix_dc_block(sound_mix_dc_t *dc, SWORD *buf,
+                                       int nr, int soc);
+
+#endif
@@ -0,0 +1,189 @@
+/*
+ * soundmixcheck.c - Check of the mixing stage of the sound chips.
+ *
+ * Written by
+ *  VICE Project
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* Check that sound_mix() returns the exactly rounded and clipped sum of
+   its sources, worked out here with 64 bits.
+
+   soundmixcheck [rounds]
+
+   Every round mixes SOUND_MIX_SOURCES_MAX sources, and fewer, in mono
+   and stereo, at lengths that are no multiple of the SIMD vectors.  The
+   samples are the full scale extremes of one sign, of both signs, or
+   random; the gains are SOUND_MIX_GAIN_MAX, unity or random.  The scalar
+   kernel is checked before sound_mix_init(), the kernel it picks for the
+   host after it.  The program exits with status 1 on the first
+   difference.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "soundmix.h"
+#include "types.h"
+
+#define CHECK_FRAMES 203
+
+static SWORD bufs[SOUND_MIX_SOURCES_MAX][CHECK_FRAMES * 2];
+static SWORD out[CHECK_FRAMES * 2];
+static SWORD expected[CHECK_FRAMES * 2];
+
+/* fixed generator, so that a failure can be reproduced */
+static unsigned int seed = 1;
+
+static int random_int(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return (int)(seed >> 8);
+}
+
+static SWORD random_sample(int range)
+{
+    switch (range) {
+      case 0:
+        return 32767;
+      case 1:
+        return -32768;
+      case 2:
+        return (random_int() & 1) ? 32767 : -32768;
+      default:
+        return (SWORD)random_int();
+    }
+}
+
+static int random_gain(int kind)
+{
+    switch (kind) {
+      case 0:
+        return SOUND_MIX_GAIN_MAX;
+      case 1:
+        return SOUND_MIX_UNITY;
+      default:
+        return random_int() % (SOUND_MIX_GAIN_MAX + 1);
+    }
+}
+
+static unsigned int mix_reference(const sound_mix_source_t *src,
+                                  int sources, int n, int soc)
+{
+    unsigned int clipped = 0;
+    int i, j;
+
+    for (i = 0; i < n; i++) {
+        int ch = soc > 1 ? i & 1 : 0;
+        long long sum = 1 << (SOUND_MIX_SHIFT - 1);
+
+        for (j = 0; j < sources; j++) {
+            sum += (long long)src[j].buf[i] * src[j].gain[ch];
+        }
+        sum >>= SOUND_MIX_SHIFT;
+
+        if (sum > 32767) {
+            sum = 32767;
+            clipped++;
+        } else if (sum < -32768) {
+            sum = -32768;
+            clipped++;
+        }
+        expected[i] = (SWORD)sum;
+    }
+    return clipped;
+}
+
+static int check_kernel(const char *name, int rounds)
+{
+    sound_mix_source_t src[SOUND_MIX_SOURCES_MAX];
+    unsigned long checked = 0;
+    int round, range, kind, sources, soc, nr, i, j;
+
+    for (round = 0; round < rounds; round++) {
+        for (range = 0; range < 4; range++) {
+            for (kind = 0; kind < 3; kind++) {
+                for (sources = SOUND_MIX_SOURCES_MAX; sources > 0;
+                     sources -= 7) {
+                    for (soc = 1; soc <= 2; soc++) {
+                        for (j = 0; j < sources; j++) {
+                            for (i = 0; i < CHECK_FRAMES * 2; i++) {
+                                bufs[j][i] = random_sample(range);
+                            }
+                            src[j].buf = bufs[j];
+                            src[j].gain[0] = random_gain(kind);
+                            src[j].gain[1] = random_gain(kind);
+                        }
+
+                        for (nr = CHECK_FRAMES - 16; nr <= CHECK_FRAMES;
+                             nr++) {
+                            unsigned int want, got;
+
+                            want = mix_reference(src, sources, nr * soc, soc);
+                            got = sound_mix(out, src, sources, nr, soc);
+
+                            for (i = 0; i < nr * soc; i++) {
+                                if (out[i] != expected[i]) {
+                                    printf("%s: round %d, range %d, gains %d, "
+                                           "%d sources, %d channels, "
+                                           "%d frames: sample %d is %d "
+                                           "instead of %d\n",
+                                           name, round, range, kind, sources,
+                                           soc, nr, i, out[i], expected[i]);
+                                    return -1;
+                                }
+                            }
+                            if (got != want) {
+                                printf("%s: round %d, range %d, gains %d, "
+                                       "%d sources, %d channels, %d frames: "
+                                       "%u samples clipped instead of %u\n",
+                                       name, round, range, kind, sources,
+                                       soc, nr, got, want);
+                                return -1;
+                            }
+                            checked++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    printf("%s: %lu mixes, all equal to the exact sum.\n", name, checked);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 4;
+
+    if (check_kernel("scalar", rounds) < 0) {
+        return 1;
+    }
+
+    sound_mix_init();
+
+    if (check_kernel("host", rounds) < 0) {
+        return 1;
+    }
+    return 0;
+}
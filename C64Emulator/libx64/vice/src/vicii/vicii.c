@@ -271,6 +271,16 @@ void vicii_handle_pending_alarms_external_write(void)
         vicii_handle_pending_alarms(maincpu_rmw_flag + 1);
 }
 
+/* Return the clock from which on `vicii_handle_pending_alarms()' has
+   something to do.  */
+CLOCK vicii_pending_alarms_clk(void)
+{
+    if (!vicii.initialized)
+        return (CLOCK)~0L;
+
+    return vicii.fetch_clk < vicii.draw_clk ? vicii.fetch_clk : vicii.draw_clk;
+}
+
 /* return pixel aspect ratio for current video mode
  * based on http://codebase64.com/doku.php?id=base:pixel_aspect_ratio
  */
@@ -44,15 +44,29 @@
 #ifdef HAVE_ZLIB
 #include <zlib.h>
 #endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_UTIME_H
+#include <utime.h>
+#endif
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#endif
 
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
 #endif
 
 #include "archdep.h"
+#include "cmdline.h"
+#include "crc32.h"
 #include "ioutil.h"
 #include "lib.h"
 #include "log.h"
+#include "resources.h"
+#include "translate.h"
+#include "types.h"
 #include "util.h"
 #include "zfile.h"
 #include "zipcode.h"
@@ -68,6 +82,19 @@
 #define ZDEBUG(a)
 #endif
 
+/* With zlib and `fmemopen()', gzip compressed files are uncompressed into
+   a memory buffer instead of a temporary file.  */
+#if defined(HAVE_ZLIB) && defined(HAVE_FMEMOPEN)
+#define ZFILE_MEMORY_GZIP
+#endif
+
+/* Converted archives, zipcode and lynx images can be kept in a cache
+   directory and are mapped into memory from there.  */
+#if defined(HAVE_FMEMOPEN) && defined(HAVE_SYS_STAT_H) \
+    && defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#define ZFILE_CACHE
+#endif
+
 /* We could add more here...  */
 enum compression_type {
     COMPR_NONE,
@@ -83,6 +110,10 @@ enum compression_type {
    opened.  */
 struct zfile_s {
     char *tmp_name;              /* Name of the temporary file.  */
+    char *mem;                   /* Uncompressed data held in memory.  */
+    size_t mem_size;             /* Length of the data in `mem'.  */
+    void *map;                   /* Mapped cache entry holding `mem'.  */
+    size_t map_size;             /* Length of the mapping.  */
     char *orig_name;             /* Name of the original file.  */
     int write_mode;              /* Non-zero if the file is open for writing.*/
     FILE *stream;                /* Associated stdio-style stream.  */
@@ -100,8 +131,88 @@ static log_t zlog = LOG_ERR;
 
 /* ------------------------------------------------------------------------- */
 
+/* Resources.  */
+
+static char *zfile_cache_dir = NULL;
+static int zfile_cache_size;
+
+static int set_zfile_cache_dir(const char *val, void *param)
+{
+    util_string_set(&zfile_cache_dir, val);
+    return 0;
+}
+
+static int set_zfile_cache_size(int val, void *param)
+{
+    if (val < 0)
+        return -1;
+
+    zfile_cache_size = val;
+    return 0;
+}
+
+static const resource_string_t resources_string[] = {
+    { "ZFileCacheDir", "", RES_EVENT_NO, NULL,
+      &zfile_cache_dir, set_zfile_cache_dir, NULL },
+    { NULL }
+};
+
+static const resource_int_t resources_int[] = {
+    { "ZFileCacheSize", 65536, RES_EVENT_NO, NULL,
+      &zfile_cache_size, set_zfile_cache_size, NULL },
+    { NULL }
+};
+
+int zfile_resources_init(void)
+{
+    if (resources_register_string(resources_string) < 0)
+        return -1;
+
+    return resources_register_int(resources_int);
+}
+
+void zfile_resources_shutdown(void)
+{
+    lib_free(zfile_cache_dir);
+    zfile_cache_dir = NULL;
+}
+
+static const cmdline_option_t cmdline_options[] = {
+    { "-zfilecachedir", SET_RESOURCE, 1,
+      NULL, NULL, "ZFileCacheDir", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<path>"), T_("Keep converted archives, zipcode and lynx images in this directory (empty: no cache)") },
+    { "-zfilecachesize", SET_RESOURCE, 1,
+      NULL, NULL, "ZFileCacheSize", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<kilobytes>"), T_("Size limit of the converted image cache") },
+    { NULL }
+};
+
+int zfile_cmdline_options_init(void)
+{
+    return cmdline_register_options(cmdline_options);
+}
+
+/* ------------------------------------------------------------------------- */
+
 static int zinit_done = 0;
 
+/* Free the uncompressed data `mem', which lies in the mapping `map' if that
+   is not NULL.  */
+static void zfile_mem_free(char *mem, void *map, size_t map_size)
+{
+#ifdef ZFILE_CACHE
+    if (map != NULL) {
+        munmap(map, map_size);
+        return;
+    }
+#endif
+    lib_free(mem);
+}
+
 static void zfile_list_destroy(void)
 {
     zfile_t *p;
@@ -111,6 +222,7 @@ static void zfile_list_destroy(void)
 
         lib_free(p->orig_name);
         lib_free(p->tmp_name);
+        zfile_mem_free(p->mem, p->map, p->map_size);
         next = p->next;
         lib_free(p);
         p = next;
@@ -132,8 +244,11 @@ static int zinit(void)
 }
 
 /* Add one zfile to the list.  `orig_name' is automatically expanded to the
-   complete path.  */
+   complete path.  The list takes over the `mem' buffer, if any, and the
+   mapping `map' it lies in.  */
 static void zfile_list_add(const char *tmp_name,
+                           char *mem, size_t mem_size,
+                           void *map, size_t map_size,
                            const char *orig_name,
                            enum compression_type type,
                            int write_mode,
@@ -146,6 +261,10 @@ static void zfile_list_add(const char *tmp_name,
 
     /* The new zfile becomes first on the list.  */
     new_zfile->tmp_name = tmp_name ? lib_stralloc(tmp_name) : NULL;
+    new_zfile->mem = mem;
+    new_zfile->mem_size = mem_size;
+    new_zfile->map = map;
+    new_zfile->map_size = map_size;
     new_zfile->write_mode = write_mode;
     new_zfile->stream = stream;
     new_zfile->fd = fd;
@@ -174,7 +293,8 @@ void zfile_shutdown(void)
 static char *try_uncompress_with_gzip(const char *name)
 {
 #ifdef HAVE_ZLIB
-    FILE *fdsrc, *fddest;
+    gzFile fdsrc;
+    FILE *fddest;
     char *tmp_name = NULL;
     int len;
 
@@ -246,6 +366,51 @@ static char *try_uncompress_with_gzip(const char *name)
 #endif
 }
 
+#ifdef ZFILE_MEMORY_GZIP
+/* If `name' has a gzip-like extension, try to uncompress it into a memory
+   buffer using zlib.  If this succeeds, return the buffer and store the
+   length of the data in `size'; return NULL otherwise.  */
+static char *try_uncompress_with_gzip_mem(const char *name, size_t *size)
+{
+    gzFile fdsrc;
+    char *buf;
+    size_t len = 0, buf_size = 0x10000;
+    int n;
+
+    if (!archdep_file_is_gzip(name))
+        return NULL;
+
+    fdsrc = gzopen(name, MODE_READ);
+    if (fdsrc == NULL)
+        return NULL;
+
+    buf = lib_malloc(buf_size);
+
+    while ((n = gzread(fdsrc, (void *)(buf + len),
+                       (unsigned int)(buf_size - len))) > 0) {
+        len += (size_t)n;
+        if (len == buf_size) {
+            buf_size *= 2;
+            buf = lib_realloc(buf, buf_size);
+        }
+    }
+
+    gzclose(fdsrc);
+
+    /* `fmemopen()' cannot open an empty buffer; leave that case to the
+       temporary file.  */
+    if (n < 0 || len == 0) {
+        ZDEBUG(("try_uncompress_with_gzip_mem: failed"));
+        lib_free(buf);
+        return NULL;
+    }
+
+    ZDEBUG(("try_uncompress_with_gzip_mem: OK, %u bytes", (unsigned int)len));
+    *size = len;
+    return buf;
+}
+#endif
+
 /* If `name' has a bzip-like extension, try to uncompress it into a temporary
    file using bzip.  If this succeeds, return the name of the temporary file;
    return NULL otherwise.  */
@@ -516,43 +681,54 @@ static char *try_uncompress_archive(const char *name, int write_mode,
 
 #define C1541_NAME     "c1541"
 
-/* If this file looks like a zipcode, try to extract is using c1541. We have
-   to figure this out by reading the contents of the file */
-static char *try_uncompress_zipcode(const char *name, int write_mode)
+/* Return non-zero if this file looks like a zipcode.  We have to figure
+   this out by reading the contents of the file */
+static int is_zipcode_image(const char *name)
 {
     char *tmp_name = NULL;
     int i, count, sector, sectors = 0;
     FILE *fd;
     char tmp[256];
-    char *argv[5];
-    int exit_status;
 
     /* The 2nd char has to be '!'?  */
     util_fname_split(name, NULL, &tmp_name);
     if (tmp_name == NULL)
-        return NULL;
+        return 0;
     if (strlen(tmp_name) < 3 || tmp_name[1] != '!') {
         lib_free(tmp_name);
-        return NULL;
+        return 0;
     }
     lib_free(tmp_name);
 
     /* Can we read this file?  */
     fd = fopen(name, MODE_READ);
     if (fd == NULL)
-        return NULL;
+        return 0;
     /* Read first track to see if this is zipcode.  */
     fseek(fd, 4, SEEK_SET);
     for (count = 1; count < 21; count++) {
         i = zipcode_read_sector(fd, 1, &sector, tmp);
         if (i || sector < 0 || sector > 20 || (sectors & (1 << sector))) {
             fclose(fd);
-            return NULL;
+            return 0;
         }
         sectors |= 1 << sector;
     }
     fclose(fd);
 
+    return 1;
+}
+
+/* If this file looks like a zipcode, try to extract is using c1541.  */
+static char *try_uncompress_zipcode(const char *name, int write_mode)
+{
+    char *tmp_name = NULL;
+    char *argv[5];
+    int exit_status;
+
+    if (!is_zipcode_image(name))
+        return NULL;
+
     /* it is a zipcode. We cannot support write_mode */
     if (write_mode)
         return "";
@@ -583,34 +759,31 @@ static char *try_uncompress_zipcode(const char *name, int write_mode)
     return tmp_name;
 }
 
-/* If the file looks like a lynx image, try to extract it using c1541. We have
-   to figure this out by reading the contsnts of the file */
-static char *try_uncompress_lynx(const char *name, int write_mode)
+/* Return non-zero if the file looks like a lynx image.  We have to figure
+   this out by reading the contsnts of the file */
+static int is_lynx_image(const char *name)
 {
-    char *tmp_name;
     size_t i;
     int count;
     FILE *fd;
     char tmp[256];
-    char *argv[20];
-    int exit_status;
 
     /* can we read this file? */
     fd = fopen(name, MODE_READ);
     if (fd == NULL)
-        return NULL;
+        return 0;
     /* is this lynx -image? */
     i = fread(tmp, 1, 2, fd);
     if (i != 2 || tmp[0] != 1 || tmp[1] != 8) {
         fclose(fd);
-        return NULL;
+        return 0;
     }
     count = 0;
     while (1) {
         i = fread(tmp, 1, 1, fd);
         if (i != 1) {
             fclose(fd);
-            return NULL;
+            return 0;
         }
         if (tmp[0])
             count = 0;
@@ -622,14 +795,14 @@ static char *try_uncompress_lynx(const char *name, int write_mode)
     i = fread(tmp, 1, 1, fd);
     if (i != 1 || tmp[0] != 13) {
         fclose(fd);
-        return NULL;
+        return 0;
     }
     count = 0;
     while (1) {
         i = fread(&tmp[count], 1, 1, fd);
         if (i != 1 || count == 254) {
             fclose(fd);
-            return NULL;
+            return 0;
         }
         if (tmp[count++] == 13)
             break;
@@ -637,12 +810,25 @@ static char *try_uncompress_lynx(const char *name, int write_mode)
     tmp[count] = 0;
     if (!atoi(tmp)) {
         fclose(fd);
-        return NULL;
+        return 0;
     }
     /* XXX: this is not a full check, but perhaps enough? */
 
     fclose(fd);
 
+    return 1;
+}
+
+/* If the file looks like a lynx image, try to extract it using c1541.  */
+static char *try_uncompress_lynx(const char *name, int write_mode)
+{
+    char *tmp_name;
+    char *argv[20];
+    int exit_status;
+
+    if (!is_lynx_image(name))
+        return NULL;
+
     /* it is a lynx image. We cannot support write_mode */
     if (write_mode)
         return "";
@@ -708,15 +894,395 @@ static const valid_archives_t valid_archives[] = {
     { NULL }
 };
 
-/* Try to uncompress file `name' using the algorithms we know of.  If this is
-   not possible, return `COMPR_NONE'.  Otherwise, uncompress the file into a
-   temporary file, return the type of algorithm used and the name of the
-   temporary file in `tmp_name'.  If `write_mode' is non-zero and the
-   returned `tmp_name' has zero length, then the file cannot be accessed in
-   write mode.  */
-static enum compression_type try_uncompress(const char *name,
-                                            char **tmp_name,
-                                            int write_mode)
+/* ------------------------------------------------------------------------- */
+
+/* Conversion cache.
+
+   Archives, zipcode and lynx images are converted by external programs
+   every time they are opened.  If `ZFileCacheDir' is set, the result of a
+   conversion is kept in that directory, so that opening the same image
+   again only maps the cached copy into memory.  Each entry starts with a
+   header holding the key (the full path, modification time, length and
+   CRC32 of the source and the kind of conversion) and the CRC32 of the
+   converted data; entries that do not match are dropped.  The least
+   recently used entries are removed when the cache grows beyond
+   `ZFileCacheSize' kilobytes.
+
+   Header layout (little endian):
+     0  magic             16  converted length
+     6  version           20  converted CRC32
+     7  conversion        24  source mtime (64 bits)
+     8  source length     32  path length
+    12  source CRC32      36  path  */
+
+#ifdef ZFILE_CACHE
+
+#define ZCACHE_MAGIC        "VICEZC"
+#define ZCACHE_VERSION      2
+#define ZCACHE_HEADER_SIZE  36
+#define ZCACHE_EXTENSION    ".vzc"
+
+struct zcache_key_s {
+    char *path;                  /* Full path of the source.  */
+    time_t mtime;                /* Modification time of the source.  */
+    DWORD crc;                   /* CRC32 of the source data.  */
+    DWORD length;                /* Length of the source data.  */
+    enum compression_type type;  /* Conversion used.  */
+};
+typedef struct zcache_key_s zcache_key_t;
+
+struct zcache_entry_s {
+    char *name;
+    unsigned long size;
+    time_t mtime;
+};
+typedef struct zcache_entry_s zcache_entry_t;
+
+/* Return the conversion `name' would be run through if it is one that is
+   cached, `COMPR_NONE' otherwise or if the cache is disabled.  This follows
+   the order of `try_uncompress()'.  */
+static enum compression_type zcache_conversion_type(const char *name)
+{
+    size_t l = strlen(name), len;
+    int i;
+
+    if (zfile_cache_dir == NULL || *zfile_cache_dir == '\0')
+        return COMPR_NONE;
+
+    for (i = 0; valid_archives[i].program; i++) {
+        len = strlen(valid_archives[i].extension);
+        if (l > len
+            && strcasecmp(name + l - len, valid_archives[i].extension) == 0)
+            return COMPR_ARCHIVE;
+    }
+
+    if (archdep_file_is_gzip(name)
+        || (l >= 5 && strcasecmp(name + l - 4, ".bz2") == 0))
+        return COMPR_NONE;
+
+    if (is_zipcode_image(name))
+        return COMPR_ZIPCODE;
+
+    if (is_lynx_image(name))
+        return COMPR_LYNX;
+
+    return COMPR_NONE;
+}
+
+/* Compute the cache key for converting `name' with `type'.  A zipcode image
+   is made of the four files `1!name' to `4!name'; its mtime is that of the
+   newest part.  Return -1 if the source cannot be read.  The key must be
+   freed with `zcache_key_free()' on success.  */
+static int zcache_key(zcache_key_t *key, const char *name,
+                      enum compression_type type)
+{
+    char *part, *base;
+    char *buf = NULL;
+    size_t len = 0, size;
+    struct stat st;
+    time_t mtime = 0;
+    FILE *fd;
+    int i, parts;
+
+    part = lib_stralloc(name);
+    base = part + strlen(part);
+    while (base > part && !strchr(FSDEV_DIR_SEP_STR, base[-1]))
+        base--;
+
+    parts = (type == COMPR_ZIPCODE) ? 4 : 1;
+    for (i = 0; i < parts; i++) {
+        if (type == COMPR_ZIPCODE)
+            *base = '1' + i;
+
+        fd = fopen(part, MODE_READ);
+        if (fd == NULL) {
+            lib_free(buf);
+            lib_free(part);
+            return -1;
+        }
+        if (fstat(fileno(fd), &st) < 0) {
+            fclose(fd);
+            lib_free(buf);
+            lib_free(part);
+            return -1;
+        }
+        if (st.st_mtime > mtime)
+            mtime = st.st_mtime;
+        size = (size_t)st.st_size;
+        buf = lib_realloc(buf, len + size + 1);
+        if (fread(buf + len, 1, size, fd) != size) {
+            fclose(fd);
+            lib_free(buf);
+            lib_free(part);
+            return -1;
+        }
+        fclose(fd);
+        len += size;
+    }
+
+    key->crc = (DWORD)crc32_buf(buf, (unsigned int)len);
+    key->length = (DWORD)len;
+    key->mtime = mtime;
+    key->type = type;
+    archdep_expand_path(&key->path, name);
+
+    lib_free(buf);
+    lib_free(part);
+    return 0;
+}
+
+static void zcache_key_free(zcache_key_t *key)
+{
+    lib_free(key->path);
+    key->path = NULL;
+}
+
+/* The entry is named after the path and data of the source, so that
+   different images with the same contents do not share an entry.  */
+static char *zcache_entry_name(const zcache_key_t *key)
+{
+    char tmp[32];
+
+    sprintf(tmp, "%08x%08x%02x" ZCACHE_EXTENSION,
+            (unsigned int)crc32_buf(key->path, (unsigned int)strlen(key->path)),
+            (unsigned int)key->crc, (unsigned int)key->type);
+
+    return util_concat(zfile_cache_dir, FSDEV_DIR_SEP_STR, tmp, NULL);
+}
+
+/* Fill in the header of the entry for `key', holding `len' bytes of
+   converted data with CRC32 `crc'.  `hdr' must have room for
+   `ZCACHE_HEADER_SIZE' bytes plus the path.  */
+static void zcache_header_fill(BYTE *hdr, const zcache_key_t *key,
+                               size_t len, DWORD crc)
+{
+    size_t path_len = strlen(key->path);
+
+    memcpy(hdr, ZCACHE_MAGIC, 6);
+    hdr[6] = ZCACHE_VERSION;
+    hdr[7] = (BYTE)key->type;
+    util_dword_to_le_buf(&hdr[8], key->length);
+    util_dword_to_le_buf(&hdr[12], key->crc);
+    util_dword_to_le_buf(&hdr[16], (DWORD)len);
+    util_dword_to_le_buf(&hdr[20], crc);
+    util_dword_to_le_buf(&hdr[24], (DWORD)((unsigned long long)key->mtime
+                                           & 0xffffffff));
+    util_dword_to_le_buf(&hdr[28], (DWORD)((unsigned long long)key->mtime
+                                           >> 32));
+    util_dword_to_le_buf(&hdr[32], (DWORD)path_len);
+    memcpy(&hdr[ZCACHE_HEADER_SIZE], key->path, path_len);
+}
+
+/* Look up the conversion described by `key'.  If `data' is not NULL, map
+   the entry into memory and return the converted data in `data', its
+   length in `size' and the mapping in `map' and `map_size'.  Return 0 on a
+   hit, -1 otherwise.  */
+static int zcache_lookup(const zcache_key_t *key, char **data, size_t *size,
+                         void **map, size_t *map_size)
+{
+    char *entry_name;
+    FILE *fd;
+    struct stat st;
+    BYTE *hdr, *p = NULL;
+    size_t len = 0, hdr_len, path_len;
+    int valid = 0;
+
+    entry_name = zcache_entry_name(key);
+
+    fd = fopen(entry_name, MODE_READ);
+    if (fd == NULL) {
+        lib_free(entry_name);
+        return -1;
+    }
+
+    path_len = strlen(key->path);
+    hdr_len = ZCACHE_HEADER_SIZE + path_len;
+
+    if (fstat(fileno(fd), &st) == 0 && (size_t)st.st_size > hdr_len) {
+        len = (size_t)st.st_size;
+        p = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fileno(fd), 0);
+        if (p == MAP_FAILED)
+            p = NULL;
+    }
+
+    fclose(fd);
+
+    if (p != NULL) {
+        /* Everything but the CRC32 of the converted data must match.  */
+        hdr = lib_malloc(hdr_len);
+        zcache_header_fill(hdr, key, len - hdr_len,
+                           util_le_buf_to_dword(&p[20]));
+        if (memcmp(hdr, p, hdr_len) == 0
+            && (data == NULL
+                || (DWORD)crc32_buf((char *)p + hdr_len,
+                                    (unsigned int)(len - hdr_len))
+                   == util_le_buf_to_dword(&p[20])))
+            valid = 1;
+        lib_free(hdr);
+    }
+
+    if (!valid) {
+        if (p != NULL)
+            munmap(p, len);
+        log_warning(zlog, "Removing invalid cache entry `%s'.", entry_name);
+        ioutil_remove(entry_name);
+        lib_free(entry_name);
+        return -1;
+    }
+
+#ifdef HAVE_UTIME_H
+    /* Mark the entry as recently used.  */
+    utime(entry_name, NULL);
+#endif
+
+    ZDEBUG(("zcache_lookup: hit `%s'", entry_name));
+    lib_free(entry_name);
+
+    if (data != NULL) {
+        *data = (char *)p + hdr_len;
+        *size = len - hdr_len;
+        *map = p;
+        *map_size = len;
+    } else {
+        munmap(p, len);
+    }
+    return 0;
+}
+
+static int zcache_compare_entries(const void *a, const void *b)
+{
+    const zcache_entry_t *ea = (const zcache_entry_t *)a;
+    const zcache_entry_t *eb = (const zcache_entry_t *)b;
+
+    if (ea->mtime != eb->mtime)
+        return ea->mtime < eb->mtime ? -1 : 1;
+    return strcmp(ea->name, eb->name);
+}
+
+/* Remove the least recently used entries until the cache fits into
+   `ZFileCacheSize'.  */
+static void zcache_trim(void)
+{
+    ioutil_dir_t *dir;
+    zcache_entry_t *entries;
+    const char *file;
+    char *path;
+    struct stat st;
+    unsigned long total = 0, limit;
+    size_t l, len = strlen(ZCACHE_EXTENSION);
+    int i, count = 0;
+
+    dir = ioutil_opendir(zfile_cache_dir);
+    if (dir == NULL)
+        return;
+
+    entries = lib_malloc(sizeof(zcache_entry_t) * (dir->file_amount + 1));
+
+    while ((file = ioutil_readdir(dir)) != NULL) {
+        l = strlen(file);
+        if (l <= len || strcmp(file + l - len, ZCACHE_EXTENSION) != 0)
+            continue;
+        path = util_concat(zfile_cache_dir, FSDEV_DIR_SEP_STR, file, NULL);
+        if (stat(path, &st) < 0 || !S_ISREG(st.st_mode)) {
+            lib_free(path);
+            continue;
+        }
+        entries[count].name = path;
+        entries[count].size = (unsigned long)st.st_size;
+        entries[count].mtime = st.st_mtime;
+        total += entries[count].size;
+        count++;
+    }
+    ioutil_closedir(dir);
+
+    qsort(entries, count, sizeof(zcache_entry_t), zcache_compare_entries);
+
+    limit = (unsigned long)zfile_cache_size * 1024;
+    for (i = 0; i < count; i++) {
+        if (total > limit) {
+            ZDEBUG(("zcache_trim: removing `%s'", entries[i].name));
+            if (ioutil_remove(entries[i].name) == 0)
+                total -= entries[i].size;
+        }
+        lib_free(entries[i].name);
+    }
+
+    lib_free(entries);
+}
+
+/* Store the converted file `tmp_name' in the cache under `key'.  */
+static void zcache_store(const zcache_key_t *key, const char *tmp_name)
+{
+    char *entry_name, *new_name;
+    char *buf;
+    BYTE *hdr;
+    FILE *fd;
+    size_t len, hdr_len;
+
+    fd = fopen(tmp_name, MODE_READ);
+    if (fd == NULL)
+        return;
+
+    len = util_file_length(fd);
+    hdr_len = ZCACHE_HEADER_SIZE + strlen(key->path);
+    if (len == 0 || len + hdr_len > (size_t)zfile_cache_size * 1024) {
+        fclose(fd);
+        return;
+    }
+
+    buf = lib_malloc(len);
+    if (fread(buf, 1, len, fd) != len) {
+        fclose(fd);
+        lib_free(buf);
+        return;
+    }
+    fclose(fd);
+
+    hdr = lib_malloc(hdr_len);
+    zcache_header_fill(hdr, key, len,
+                       (DWORD)crc32_buf(buf, (unsigned int)len));
+
+    ioutil_mkdir(zfile_cache_dir, 0700);
+
+    /* Write to a new file first, so that an interrupted write never leaves
+       a partial entry behind under the real name.  */
+    entry_name = zcache_entry_name(key);
+    new_name = util_concat(entry_name, ".new", NULL);
+
+    fd = fopen(new_name, MODE_WRITE);
+    if (fd == NULL) {
+        log_warning(zlog, "Cannot write cache entry `%s'.", new_name);
+    } else {
+        int ok;
+
+        ok = fwrite(hdr, hdr_len, 1, fd) == 1
+             && fwrite(buf, 1, len, fd) == len;
+        if (fclose(fd) != 0)
+            ok = 0;
+
+        if (!ok || ioutil_rename(new_name, entry_name) < 0) {
+            log_warning(zlog, "Cannot write cache entry `%s'.", entry_name);
+            ioutil_remove(new_name);
+        } else {
+            ZDEBUG(("zcache_store: stored `%s'", entry_name));
+            zcache_trim();
+        }
+    }
+
+    lib_free(new_name);
+    lib_free(entry_name);
+    lib_free(hdr);
+    lib_free(buf);
+}
+
+#endif
+
+/* Uncompress file `name' like `try_uncompress()', without the cache.  */
+static enum compression_type try_uncompress_convert(const char *name,
+                                                    char **tmp_name,
+                                                    int write_mode,
+                                                    char **mem,
+                                                    size_t *mem_size)
 {
     int i;
 
@@ -733,6 +1299,13 @@ static enum compression_type try_uncompress(const char *name,
     }
 
     /* need this order or .tar.gz is misunderstood */
+#ifdef ZFILE_MEMORY_GZIP
+    if (mem != NULL
+        && (*mem = try_uncompress_with_gzip_mem(name, mem_size)) != NULL) {
+        *tmp_name = NULL;
+        return COMPR_GZIP;
+    }
+#endif
     if ((*tmp_name = try_uncompress_with_gzip(name)) != NULL)
         return COMPR_GZIP;
 
@@ -751,6 +1324,55 @@ static enum compression_type try_uncompress(const char *name,
     return COMPR_NONE;
 }
 
+/* Try to uncompress file `name' using the algorithms we know of.  If this is
+   not possible, return `COMPR_NONE'.  Otherwise, uncompress the file into a
+   temporary file, return the type of algorithm used and the name of the
+   temporary file in `tmp_name'.  If `write_mode' is non-zero and the
+   returned `tmp_name' has zero length, then the file cannot be accessed in
+   write mode.  If `mem' is not NULL, gzip files and cached conversions may
+   instead be returned in a buffer in `mem' and `mem_size', with `tmp_name'
+   NULL; a cached conversion lies in the mapping returned in `map' and
+   `map_size'.  */
+static enum compression_type try_uncompress(const char *name,
+                                            char **tmp_name,
+                                            int write_mode,
+                                            char **mem, size_t *mem_size,
+                                            void **map, size_t *map_size)
+{
+#ifdef ZFILE_CACHE
+    zcache_key_t key;
+    enum compression_type type;
+
+    type = zcache_conversion_type(name);
+    if (type == COMPR_NONE || zcache_key(&key, name, type) < 0)
+        return try_uncompress_convert(name, tmp_name, write_mode,
+                                      mem, mem_size);
+
+    /* A cached conversion is read-only, like a fresh one.  */
+    if (write_mode) {
+        if (zcache_lookup(&key, NULL, NULL, NULL, NULL) == 0) {
+            zcache_key_free(&key);
+            *tmp_name = "";
+            return type;
+        }
+    } else if (mem != NULL
+               && zcache_lookup(&key, mem, mem_size, map, map_size) == 0) {
+        zcache_key_free(&key);
+        *tmp_name = NULL;
+        return type;
+    }
+
+    type = try_uncompress_convert(name, tmp_name, write_mode, mem, mem_size);
+    if (type == key.type && *tmp_name != NULL && **tmp_name != '\0')
+        zcache_store(&key, *tmp_name);
+
+    zcache_key_free(&key);
+    return type;
+#else
+    return try_uncompress_convert(name, tmp_name, write_mode, mem, mem_size);
+#endif
+}
+
 /* ------------------------------------------------------------------------- */
 
 /* Compression.  */
@@ -760,14 +1382,14 @@ static int compress_with_gzip(const char *src, const char *dest)
 {
 #ifdef HAVE_ZLIB
     FILE *fdsrc;
-    FILE *fddest;
+    gzFile fddest;
     size_t len;
 
-    fdsrc = fopen(dest, MODE_READ);
+    fdsrc = fopen(src, MODE_READ);
     if (fdsrc == NULL)
         return -1;
 
-    fddest = gzopen(src, MODE_WRITE"9");
+    fddest = gzopen(dest, MODE_WRITE"9");
     if (fddest == NULL) {
         fclose(fdsrc);
         return -1;
@@ -775,13 +1397,18 @@ static int compress_with_gzip(const char *src, const char *dest)
 
     do {
         char buf[256];
-        len = fread((void *)buf, 256, 1, fdsrc);
-        if (len > 0)
-            gzwrite(fddest, (void *)buf, (unsigned int)len);
+        len = fread((void *)buf, 1, 256, fdsrc);
+        if (len > 0
+            && gzwrite(fddest, (void *)buf, (unsigned int)len) != (int)len) {
+            gzclose(fddest);
+            fclose(fdsrc);
+            return -1;
+        }
     } while (len > 0);
 
-    gzclose(fddest);
     fclose(fdsrc);
+    if (gzclose(fddest) != Z_OK)
+        return -1;
 
     archdep_file_set_gzip(dest);
 
@@ -820,6 +1447,33 @@ static int compress_with_gzip(const char *src, const char *dest)
 #endif
 }
 
+#ifdef ZFILE_MEMORY_GZIP
+/* Compress `size' bytes at `mem' into `dest' using zlib.  */
+static int compress_mem_with_gzip(const char *mem, size_t size,
+                                  const char *dest)
+{
+    gzFile fddest;
+
+    fddest = gzopen(dest, MODE_WRITE"9");
+    if (fddest == NULL)
+        return -1;
+
+    if (gzwrite(fddest, (void *)mem, (unsigned int)size) != (int)size) {
+        gzclose(fddest);
+        return -1;
+    }
+
+    if (gzclose(fddest) != Z_OK)
+        return -1;
+
+    archdep_file_set_gzip(dest);
+
+    ZDEBUG(("compress_mem_with_gzip: OK."));
+
+    return 0;
+}
+#endif
+
 /* Compress `src' into `dest' using bzip.  */
 static int compress_with_bzip(const char *src, const char *dest)
 {
@@ -853,9 +1507,10 @@ static int compress_with_bzip(const char *src, const char *dest)
     }
 }
 
-/* Compress `src' into `dest' using algorithm `type'.  */
-static int zfile_compress(const char *src, const char *dest,
-                          enum compression_type type)
+/* Compress `src' into `dest' using algorithm `type'.  If `mem' is not
+   NULL, compress the `mem_size' bytes in it instead of `src'.  */
+static int zfile_compress(const char *src, const char *mem, size_t mem_size,
+                          const char *dest, enum compression_type type)
 {
     char *dest_backup_name;
     int retval;
@@ -921,6 +1576,12 @@ static int zfile_compress(const char *src, const char *dest,
 
     switch (type) {
       case COMPR_GZIP:
+#ifdef ZFILE_MEMORY_GZIP
+        if (mem != NULL) {
+            retval = compress_mem_with_gzip(mem, mem_size, dest);
+            break;
+        }
+#endif
         retval = compress_with_gzip(src, dest);
         break;
       case COMPR_BZIP:
@@ -971,6 +1632,10 @@ static int zfile_compress(const char *src, const char *dest,
 FILE *zfile_fopen(const char *name, const char *mode)
 {
     char *tmp_name;
+    char *mem = NULL;
+    size_t mem_size = 0;
+    void *map = NULL;
+    size_t map_size = 0;
     FILE *stream;
     enum compression_type type;
     int write_mode = 0;
@@ -989,14 +1654,37 @@ FILE *zfile_fopen(const char *name, const char *mode)
     if (write_mode && ioutil_access(name, IOUTIL_ACCESS_W_OK) < 0)
         return NULL;
 
-    type = try_uncompress(name, &tmp_name, write_mode);
+    /* A memory stream cannot grow, so it is only used if the uncompressed
+       file is not truncated or appended to.  */
+    if (strchr(mode, 'w') == NULL && strchr(mode, 'a') == NULL)
+        type = try_uncompress(name, &tmp_name, write_mode, &mem, &mem_size,
+                              &map, &map_size);
+    else
+        type = try_uncompress(name, &tmp_name, write_mode, NULL, NULL,
+                              NULL, NULL);
+
     if (type == COMPR_NONE) {
         stream = fopen(name, mode);
         if (stream == NULL)
             return NULL;
-        zfile_list_add(NULL, name, type, write_mode, stream, NULL);
+        zfile_list_add(NULL, NULL, 0, NULL, 0, name, type, write_mode, stream,
+                       NULL);
         return stream;
-    } else if (*tmp_name == '\0') {
+    }
+#ifdef HAVE_FMEMOPEN
+    if (mem != NULL) {
+        /* Open the uncompressed data in memory.  */
+        stream = fmemopen(mem, mem_size, mode);
+        if (stream == NULL) {
+            zfile_mem_free(mem, map, map_size);
+            return NULL;
+        }
+        zfile_list_add(NULL, mem, mem_size, map, map_size, name, type,
+                       write_mode, stream, NULL);
+        return stream;
+    }
+#endif
+    if (*tmp_name == '\0') {
         errno = EACCES;
         return NULL;
     }
@@ -1006,7 +1694,8 @@ FILE *zfile_fopen(const char *name, const char *mode)
     if (stream == NULL)
         return NULL;
 
-    zfile_list_add(tmp_name, name, type, write_mode, stream, NULL);
+    zfile_list_add(tmp_name, NULL, 0, NULL, 0, name, type, write_mode, stream,
+                   NULL);
 
     /* now we don't need the archdep_tmpnam allocation any more */
     lib_free(tmp_name);
@@ -1048,7 +1737,8 @@ static int handle_close(zfile_t *ptr)
         /* Recompress into the original file.  */
         if (ptr->orig_name
             && ptr->write_mode
-            && zfile_compress(ptr->tmp_name, ptr->orig_name, ptr->type))
+            && zfile_compress(ptr->tmp_name, NULL, 0, ptr->orig_name,
+                              ptr->type))
             return -1;
 
         /* Remove temporary file.  */
@@ -1057,6 +1747,14 @@ static int handle_close(zfile_t *ptr)
                 ptr->tmp_name, strerror(errno));
     }
 
+    /* Recompress the data held in memory into the original file.  */
+    if (ptr->mem
+        && ptr->orig_name
+        && ptr->write_mode
+        && zfile_compress(NULL, ptr->mem, ptr->mem_size, ptr->orig_name,
+                          ptr->type))
+        return -1;
+
     handle_close_action(ptr);
 
     /* Remove item from list.  */
@@ -1072,6 +1770,8 @@ static int handle_close(zfile_t *ptr)
         lib_free(ptr->orig_name);
     if (ptr->tmp_name)
         lib_free(ptr->tmp_name);
+    if (ptr->mem)
+        zfile_mem_free(ptr->mem, ptr->map, ptr->map_size);
     if (ptr->request_string)
         lib_free(ptr->request_string);
 
@@ -1110,6 +1810,21 @@ int zfile_fclose(FILE *stream)
     return fclose(stream);
 }
 
+/* Return non-zero if `stream' is the uncompressed copy of a compressed
+   file, so that changes only reach the original file on `zfile_fclose()'. */
+int zfile_is_compressed(FILE *stream)
+{
+    zfile_t *ptr;
+
+    for (ptr = zfile_list; ptr != NULL; ptr = ptr->next) {
+        if (ptr->stream == stream) {
+            return ptr->type != COMPR_NONE;
+        }
+    }
+
+    return 0;
+}
+
 int zfile_close_action(const char *filename, zfile_action_t action,
                        const char *request_str)
 {